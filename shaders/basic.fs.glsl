@@ -2,16 +2,15 @@
 
 #define NUM_MATERIALS	1
 
-layout (location = 0) out vec3 gPosition;
-layout (location = 1) out vec3 gNormal;
-layout (location = 2) out vec4 gAlbedoSpec;
-layout (location = 3) out vec4 gMetallicRoughness;
+layout (location = 0) out vec2 gNormal;
+layout (location = 1) out vec4 gAlbedo;
+layout (location = 2) out vec4 gMaterial;
 
-in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
 in mat3 TBN;
 in float MaterialID;
+flat in int MaterialIndex;
 
 struct Material {
 	vec4 baseColor;
@@ -27,10 +26,70 @@ struct Material {
 
 uniform Material materials[NUM_MATERIALS];
 uniform Material material;
-uniform samplerCube depthMap;
+
+// Packed materials, see MaterialAtlas
+struct MaterialData {
+	vec4 baseColor;
+	vec4 factors;	// x: metallic, y: roughness
+	ivec4 layers;	// albedo, normal, metallic-roughness layer or -1
+};
+
+layout (std140) uniform Materials {
+	MaterialData materialData[256];
+};
+
+uniform bool useMaterialArrays;
+uniform sampler2DArray albedoArray;
+uniform sampler2DArray normalArray;
+uniform sampler2DArray metallicRoughnessArray;
+
+vec2 OctWrap(vec2 v)
+{
+	return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Octahedral normal encoding, mapped to [0, 1] for a RG16 target
+vec2 EncodeNormal(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	n.xy = n.z >= 0.0 ? n.xy : OctWrap(n.xy);
+
+	return n.xy * 0.5 + 0.5;
+}
+
+void PackedMaterial()
+{
+	MaterialData m = materialData[MaterialIndex];
+	vec3 normal = normalize(Normal);
+
+	if (m.layers.y >= 0) {
+		normal = texture(normalArray, vec3(TexCoords, m.layers.y)).rgb * 2.0 - 1.0;
+		normal = normalize(TBN * normal);
+	}
+	gNormal = EncodeNormal(normal);
+
+	gAlbedo.rgb = m.baseColor.rgb;
+	if (m.layers.x >= 0) {
+		gAlbedo.rgb *= texture(albedoArray, vec3(TexCoords, m.layers.x)).rgb;
+	}
+	gAlbedo.a = 0.0;
+
+	// r: ambient occlusion, g: roughness, b: metallic
+	gMaterial = vec4(1.0, m.factors.y, m.factors.x, 0.0);
+	if (m.layers.z >= 0) {
+		vec3 metallicRoughness = texture(metallicRoughnessArray, vec3(TexCoords, m.layers.z)).rgb;
+		gMaterial.b *= metallicRoughness.b;
+		gMaterial.g *= metallicRoughness.g;
+	}
+}
 
 void main()
 {
+	if (useMaterialArrays) {
+		PackedMaterial();
+		return ;
+	}
+
 	vec3 normal = normalize(Normal);
 
 	normal = texture(material.normal, TexCoords).rgb;
@@ -40,23 +99,23 @@ void main()
 	vec4 tex = texture(material.albedo, TexCoords);
 //	vec4 tex = texture(materials[int(MaterialID)].diffuse, TexCoords);
 
-	gPosition = FragPos;
-	gNormal = normal;
+	gNormal = EncodeNormal(normal);
 	if (material.hasAlbedo) {
-		gAlbedoSpec.rgb = texture(material.albedo, TexCoords).rgb * material.baseColor.rgb;
+		gAlbedo.rgb = texture(material.albedo, TexCoords).rgb * material.baseColor.rgb;
 	}
 	else {
-		gAlbedoSpec.rgb = material.baseColor.rgb;
+		gAlbedo.rgb = material.baseColor.rgb;
 	}
-	gAlbedoSpec.a = 0.0;
+	gAlbedo.a = 0.0;
 
-	gMetallicRoughness = vec4(0.0);
+	// r: ambient occlusion, g: roughness, b: metallic
+	gMaterial = vec4(1.0, 0.0, 0.0, 0.0);
 	if (material.hasMetallicRoughness) {
-		gMetallicRoughness.b = texture(material.metallicRoughness, TexCoords).b * material.metallicFactor;
-		gMetallicRoughness.g = texture(material.metallicRoughness, TexCoords).g * material.roughnessFactor;
+		gMaterial.b = texture(material.metallicRoughness, TexCoords).b * material.metallicFactor;
+		gMaterial.g = texture(material.metallicRoughness, TexCoords).g * material.roughnessFactor;
 	}
 	else {
-		gMetallicRoughness.b = material.metallicFactor;
-		gMetallicRoughness.g = material.roughnessFactor;
+		gMaterial.b = material.metallicFactor;
+		gMaterial.g = material.roughnessFactor;
 	}
 }
@@ -4,30 +4,41 @@ layout (location = 0) in vec3 in_position;
 layout (location = 1) in vec3 in_normal;
 layout (location = 2) in vec2 tex_coords;
 layout (location = 3) in vec4 in_tangent;
+// Per instance, see InstanceBuffer
 layout (location = 4) in float in_material;
+layout (location = 5) in mat4 in_model;
 
 uniform mat4 projectionMatrix;
 uniform mat4 viewMatrix;
 uniform mat4 viewProjectionMatrix;
-uniform mat4 modelMatrix;
 uniform vec3 viewPos;
 
-out vec3 FragPos;
+// Decodes quantized positions, (1, 0) for float positions
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
 out vec3 Normal;
 out vec2 TexCoords;
 out mat3 TBN;
 out float MaterialID;
+// Index in the Materials block when the material textures are packed in arrays
+flat out int MaterialIndex;
+
+// Must match depth.vs exactly for the GL_EQUAL depth test after the depth pre-pass
+invariant gl_Position;
 
 void main()
 {
-	gl_Position = viewProjectionMatrix * modelMatrix * vec4(in_position, 1.0);
-	FragPos = vec3(modelMatrix * vec4(in_position, 1.0));
+	vec3 position = in_position * positionScale + positionOffset;
+
+	gl_Position = viewProjectionMatrix * in_model * vec4(position, 1.0);
 	TexCoords = tex_coords;
-	Normal = mat3(transpose(inverse(modelMatrix))) * in_normal;
+	Normal = mat3(transpose(inverse(in_model))) * in_normal;
 	MaterialID = in_material;
+	MaterialIndex = int(in_material);
 
-	vec3 T = normalize(vec3(modelMatrix * in_tangent));
-	vec3 N = normalize(vec3(modelMatrix * vec4(in_normal, 0.0)));
+	vec3 T = normalize(vec3(in_model * in_tangent));
+	vec3 N = normalize(vec3(in_model * vec4(in_normal, 0.0)));
 	vec3 B = normalize(cross(N, T)) * in_tangent.w;
 	TBN = mat3(T, B, N);
 }
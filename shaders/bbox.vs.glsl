@@ -0,0 +1,13 @@
+#version 330 core
+
+// Unit cube
+layout (location = 0) in vec3 in_position;
+
+uniform mat4 viewProjectionMatrix;
+uniform vec3 boxMin;
+uniform vec3 boxMax;
+
+void main()
+{
+	gl_Position = viewProjectionMatrix * vec4(mix(boxMin, boxMax, in_position), 1.0);
+}
@@ -0,0 +1,19 @@
+#version 330 core
+
+layout (location = 0) in vec3 in_position;
+// Per instance, see InstanceBuffer
+layout (location = 5) in mat4 in_model;
+
+uniform mat4 viewProjectionMatrix;
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+// Must match basic.vs exactly for the GL_EQUAL depth test of the G-buffer pass
+invariant gl_Position;
+
+void main()
+{
+	vec3 position = in_position * positionScale + positionOffset;
+
+	gl_Position = viewProjectionMatrix * in_model * vec4(position, 1.0);
+}
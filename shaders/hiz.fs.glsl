@@ -0,0 +1,27 @@
+#version 330 core
+
+uniform sampler2D source;
+uniform ivec2 sourceSize;
+
+out float maxDepth;
+
+// Farthest depth of the source texels covered by this texel
+void main()
+{
+	ivec2 base = ivec2(gl_FragCoord.xy) * 2;
+	ivec2 last = sourceSize - 1;
+
+	// With an odd source size the last texel also covers the leftover row/column
+	int extraX = base.x + 2 == last.x ? 1 : 0;
+	int extraY = base.y + 2 == last.y ? 1 : 0;
+
+	float depth = 0.0;
+
+	for (int y = 0; y <= 1 + extraY; y++) {
+		for (int x = 0; x <= 1 + extraX; x++) {
+			depth = max(depth, texelFetch(source, min(base + ivec2(x, y), last), 0).r);
+		}
+	}
+
+	maxDepth = depth;
+}
@@ -1,14 +1,6 @@
 #version 330 core
-#define MAX_NUM_POINT_LIGHTS		16
 #define MAX_NUM_DIRECTIONAL_LIGHTS	1
 
-struct PointLight {
-	vec3 position;
-	vec3 color;
-	float intensity;
-	float radius;
-};
-
 struct DirectionalLight {
 	vec3 direction;
 	vec3 color;
@@ -18,28 +10,89 @@ struct DirectionalLight {
 out vec4 frag_color;
 
 uniform vec3 viewPos;
-uniform sampler2D gPosition;
+uniform sampler2D gDepth;
 uniform sampler2D gNormal;
-uniform sampler2D gAlbedoSpec;
-uniform sampler2D gSSAO;
-uniform sampler2D gMetallicRoughness;
+uniform sampler2D gAlbedo;
+uniform sampler2D gSSAO;			// low resolution occlusion (r) and view depth (g)
+uniform int ssaoEnabled;
+uniform sampler2D gMaterial;
+uniform mat4 invViewProjectionMatrix;
+
+// Fraction of the G-buffer covered by the rendered frame (dynamic resolution)
+uniform float renderScale;
 uniform samplerCube depthMap;
 
 uniform float exposure;
-uniform PointLight pointLight[MAX_NUM_POINT_LIGHTS];
-uniform int pointLightCount;
+uniform mat4 viewMatrix;
+
+// Clustered point lights, see engine::LightClusters
+uniform samplerBuffer clusterLights;	// 2 texels per light: position + radius, radiance
+uniform usamplerBuffer clusterGrid;		// 1 texel per cluster: offset, count
+uniform usamplerBuffer clusterIndices;	// light indices of every cluster
+uniform vec3 clusterDims;
+uniform vec4 clusterParams;				// viewport width, height, camera near, far
+
+// The shadow cube map belongs to this light
+uniform vec3 shadowLightPos;
+uniform int hasShadowLight;
 
 uniform DirectionalLight directionalLights[MAX_NUM_DIRECTIONAL_LIGHTS];
 uniform int directionalLightCount;
 
 in vec2 TexCoords;
 
-float CalcShadow(vec3 lightPos, vec3 fragPos)
+#define SHADOW_OFF		0
+#define SHADOW_HARDWARE	1
+#define SHADOW_POISSON	2
+#define SHADOW_PCF		3
+
+uniform samplerCubeShadow depthMapShadow;
+uniform int shadowQuality;
+uniform float shadowFarPlane;
+
+const float shadowBias = 2.3;
+
+const vec2 poissonDisk[8] = vec2[](
+	vec2(-0.613392,  0.617481),
+	vec2( 0.170019, -0.040254),
+	vec2(-0.299417,  0.791925),
+	vec2( 0.645680,  0.493210),
+	vec2(-0.651784,  0.717887),
+	vec2( 0.421003,  0.027070),
+	vec2(-0.817194, -0.271096),
+	vec2( 0.977050, -0.108615)
+);
+
+// One hardware comparison, the sampler averages the 4 nearest texels
+float CalcShadowHardware(vec3 fragToLight, float currentDepth)
+{
+	float ref = (currentDepth - shadowBias) / shadowFarPlane;
+
+	return 1.0 - texture(depthMapShadow, vec4(fragToLight, ref));
+}
+
+// A few hardware comparisons spread on a disk facing the light
+float CalcShadowPoisson(vec3 fragToLight, float currentDepth)
+{
+	float ref = (currentDepth - shadowBias) / shadowFarPlane;
+	float radius = 1.0 + currentDepth / shadowFarPlane * 50.0;
+
+	vec3 dir = normalize(fragToLight);
+	vec3 up = abs(dir.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+	vec3 tangent = normalize(cross(up, dir));
+	vec3 bitangent = cross(dir, tangent);
+
+	float lit = 0.0;
+	for (int i = 0; i < 8; i++) {
+		vec3 offset = (tangent * poissonDisk[i].x + bitangent * poissonDisk[i].y) * radius;
+		lit += texture(depthMapShadow, vec4(fragToLight + offset, ref));
+	}
+
+	return 1.0 - lit / 8.0;
+}
+
+float CalcShadowPcf(vec3 fragToLight, float currentDepth)
 {
-	float far_plane = 10000.0;
-	vec3 fragToLight = fragPos - lightPos;
-	float currentDepth = length(fragToLight);
-	float bias = 2.3;
 	float shadow = 0.0;
 
 	// PCF 
@@ -48,8 +101,8 @@ float CalcShadow(vec3 lightPos, vec3 fragPos)
 	for (float x = -off; x < off; x += off / (samples * 0.5)) {
 		for (float y = -off; y < off; y += off / (samples * 0.5)) {
 			for (float z = -off; z < off; z += off / (samples * 0.5)) {
-				float closestDepth = (texture(depthMap, fragToLight + vec3(x, y, z))).r * far_plane;
-				shadow += (currentDepth - bias > closestDepth) ? 1.0 : 0.0;
+				float closestDepth = (texture(depthMap, fragToLight + vec3(x, y, z))).r * shadowFarPlane;
+				shadow += (currentDepth - shadowBias > closestDepth) ? 1.0 : 0.0;
 			}
 		}
 	}
@@ -58,6 +111,24 @@ float CalcShadow(vec3 lightPos, vec3 fragPos)
 	return shadow;
 }
 
+float CalcShadow(vec3 lightPos, vec3 fragPos)
+{
+	vec3 fragToLight = fragPos - lightPos;
+	float currentDepth = length(fragToLight);
+
+	if (shadowQuality == SHADOW_HARDWARE) {
+		return CalcShadowHardware(fragToLight, currentDepth);
+	}
+	else if (shadowQuality == SHADOW_POISSON) {
+		return CalcShadowPoisson(fragToLight, currentDepth);
+	}
+	else if (shadowQuality == SHADOW_PCF) {
+		return CalcShadowPcf(fragToLight, currentDepth);
+	}
+
+	return 0.0;
+}
+
 const float PI = 3.14159265359;
 
 // Normal Distribution Function
@@ -98,28 +169,104 @@ vec3 FresnelSchlick(float cosTheta, vec3 F0)
 	return F0 + (1.0 - F0) * pow(1 - cosTheta, 5.0);
 }
 
-vec3 CalcPbr()
+vec3 DecodeNormal(vec2 f)
+{
+	f = f * 2.0 - 1.0;
+
+	vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+
+	return normalize(n);
+}
+
+vec3 ReconstructPosition(vec2 uv, float depth)
+{
+	vec4 ndc = vec4(uv * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+	vec4 world = invViewProjectionMatrix * ndc;
+
+	return world.xyz / world.w;
+}
+
+// Depth aware upsample of the low resolution occlusion
+float SampleSSAO(float viewDepth)
+{
+	if (ssaoEnabled == 0) {
+		return 1.0;
+	}
+
+	ivec2 size = textureSize(gSSAO, 0);
+	ivec2 maxTexel = ivec2(vec2(size) * renderScale) - 1;
+	vec2 coord = TexCoords * renderScale * vec2(size) - 0.5;
+	ivec2 base = ivec2(floor(coord));
+	vec2 f = fract(coord);
+
+	float occlusion = 0.0;
+	float weight = 0.0;
+	for (int i = 0; i < 4; i++) {
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		vec2 s = texelFetch(gSSAO, clamp(base + offset, ivec2(0), maxTexel), 0).rg;
+
+		float bilinear = (offset.x == 1 ? f.x : 1.0 - f.x) * (offset.y == 1 ? f.y : 1.0 - f.y);
+		float w = bilinear / (0.001 + abs(viewDepth - s.g) / viewDepth);
+
+		occlusion += s.r * w;
+		weight += w;
+	}
+
+	return weight > 0.0 ? occlusion / weight : 1.0;
+}
+
+uvec2 GetCluster(vec3 fragPos)
 {
-	vec3 fragPos = texture(gPosition, TexCoords).rgb;
-	vec3 fragColor = texture(gAlbedoSpec, TexCoords).rgb;
+	float depth = -(viewMatrix * vec4(fragPos, 1.0)).z;
+	float near = clusterParams.z;
+	float far = clusterParams.w;
+
+	ivec2 tile = ivec2(gl_FragCoord.xy / clusterParams.xy * clusterDims.xy);
+	int slice = int(log(max(depth, near) / near) / log(far / near) * clusterDims.z);
+
+	ivec3 dims = ivec3(clusterDims);
+	ivec3 cluster = clamp(ivec3(tile, slice), ivec3(0), dims - 1);
+
+	int index = cluster.x + cluster.y * dims.x + cluster.z * dims.x * dims.y;
+
+	return texelFetch(clusterGrid, index).rg;
+}
 
-	vec3 N = texture(gNormal, TexCoords).rgb;
+vec3 CalcPbr(float depth)
+{
+	vec2 uv = TexCoords * renderScale;
+	vec3 fragPos = ReconstructPosition(TexCoords, depth);
+	vec3 fragColor = texture(gAlbedo, uv).rgb;
+
+	vec3 N = DecodeNormal(texture(gNormal, uv).rg);
 	vec3 V = normalize(viewPos - fragPos).rgb;
 
-	float metallicFactor = texture(gMetallicRoughness, TexCoords).b;
-	float roughnessFactor = texture(gMetallicRoughness, TexCoords).g;
+	vec3 material = texture(gMaterial, uv).rgb;
+	float occlusion = material.r * SampleSSAO(-(viewMatrix * vec4(fragPos, 1.0)).z);
+	float roughnessFactor = material.g;
+	float metallicFactor = material.b;
 
 	vec3 F0 = vec3(0.04);
 	F0 = mix(F0, fragColor, metallicFactor);
 
 	vec3 Lo = vec3(0.0);
-	for (int i = 0; i < pointLightCount; i++) {
-		vec3 L = normalize(pointLight[i].position - fragPos);
+	uvec2 cluster = GetCluster(fragPos);
+	for (uint c = 0u; c < cluster.y; c++) {
+		int lightIndex = int(texelFetch(clusterIndices, int(cluster.x + c)).r);
+		vec4 lightPosRadius = texelFetch(clusterLights, lightIndex * 2);
+		vec3 lightRadiance = texelFetch(clusterLights, lightIndex * 2 + 1).rgb;
+
+		vec3 L = normalize(lightPosRadius.xyz - fragPos);
 		vec3 H = normalize(V + L);
 
-		float dist = length(pointLight[i].position - fragPos);
-		float attenuation = 1.0 / (dist * dist);
-		vec3 radiance = pointLight[i].color * pointLight[i].intensity * attenuation;
+		// Inverse square falloff, smoothly windowed to reach 0 at the light radius
+		float dist = length(lightPosRadius.xyz - fragPos);
+		float window = clamp(1.0 - pow(dist / lightPosRadius.w, 4.0), 0.0, 1.0);
+		float attenuation = window * window / (dist * dist);
+		vec3 radiance = lightRadiance * attenuation;
 
 		// DFG
 
@@ -139,10 +286,9 @@ vec3 CalcPbr()
 		Lo += ((kd * fragColor / PI + specular) * radiance * NdotL);
 	}
 
-	//float shadow = CalcShadow(pointLight[0].position, fragPos);
-	float shadow = 0.0;
+	float shadow = hasShadowLight != 0 ? CalcShadow(shadowLightPos, fragPos) : 0.0;
 
-	vec3 ambient = vec3(0.03) * fragColor;
+	vec3 ambient = vec3(0.03) * fragColor * occlusion;
 	vec3 color = ambient + Lo;
 
 	color = color * (1.0 - shadow);
@@ -155,7 +301,15 @@ vec3 CalcPbr()
 
 void main()
 {
-	vec3 color = CalcPbr();
+	float depth = texture(gDepth, TexCoords * renderScale).r;
+
+	// Nothing was drawn here, the skybox will cover it
+	if (depth == 1.0) {
+		frag_color = vec4(0.0, 0.0, 0.0, 1.0);
+		return ;
+	}
+
+	vec3 color = CalcPbr(depth);
 
 	color = vec3(1.0) - exp(-color * exposure);
 
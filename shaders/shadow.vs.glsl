@@ -3,8 +3,10 @@
 layout (location = 0) in vec3 in_position;
 
 uniform mat4 modelMatrix;
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
 
 void main()
 {
-	gl_Position = modelMatrix * vec4(in_position, 1.0);
+	gl_Position = modelMatrix * vec4(in_position * positionScale + positionOffset, 1.0);
 }
@@ -0,0 +1,16 @@
+#version 330 core
+
+layout (location = 0) in vec3 in_position;
+
+uniform mat4 modelMatrix;
+uniform mat4 shadowMatrix;
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+out vec4 FragPos;
+
+void main()
+{
+	FragPos = modelMatrix * vec4(in_position * positionScale + positionOffset, 1.0);
+	gl_Position = shadowMatrix * FragPos;
+}
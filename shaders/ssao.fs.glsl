@@ -1,50 +1,81 @@
 #version 330 core
 
-out float frag_color;
+#define MAX_KERNEL_SIZE 64
+
+out vec2 frag_color;
 
 in vec2 TexCoords;
 
-uniform sampler2D gPosition;
+uniform sampler2D gDepth;
 uniform sampler2D gNormal;
 uniform sampler2D texNoise;
 
 uniform mat4 projectionMatrix;
-uniform vec3 samples[64];
+uniform mat4 invProjectionMatrix;
+uniform mat4 viewMatrix;
+uniform vec3 samples[MAX_KERNEL_SIZE];
+uniform int kernelSize;
+
+// Size of the SSAO target divided by the size of the noise texture
+uniform vec3 noiseScale;
+
+uniform float radius;
+uniform float bias;
 
-const float noiseSize = 4.0;
-const vec2 screenSize = vec2(1920.0, 1080.0);
-const vec2 noiseScale = vec2(screenSize.x / noiseSize, screenSize.y / noiseSize);
+// Fraction of the G-buffer and of this target covered by the rendered frame
+uniform float uvScale;
+
+vec3 DecodeNormal(vec2 f)
+{
+	f = f * 2.0 - 1.0;
 
-const int kernelSize = 64;
-const float radius = 0.5;
-const float bias = 0.025;
+	vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+
+	return normalize(n);
+}
+
+// View space position from the depth buffer
+vec3 ViewPosition(vec2 uv)
+{
+	float depth = texture(gDepth, clamp(uv, 0.0, 1.0) * uvScale).r;
+	vec4 view = invProjectionMatrix * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+
+	return view.xyz / view.w;
+}
 
 void main()
 {
-//	vec3 fragPos = texture(gPosition, TexCoords).xyz;
-//	vec3 normal = normalize(texture(gNormal, TexCoords).xyz);
-//	vec3 randVec = normalize(texture(texNoise, TexCoords * noiseScale).xyz);
-//
-//	vec3 tangent = normalize(randVec - normal * dot(randVec, normal));
-//	vec3 bitangent = cross(normal, tangent);
-//	mat3 TBN = mat3(tangent, bitangent, normal);
-//
-//	float occlusion = 0.0;
-//	for (int i = 0; i < kernelSize; i++) {
-//		vec3 _sample = TBN * samples[i];
-//		_sample = fragPos + _sample * radius;
-//
-//		vec4 off = vec4(_sample, 1.0);
-//		off = projectionMatrix * off;
-//		off.xyz /= off.w;
-//		off.xyz = off.xyz * 0.5 + 0.5;
-//
-//		float sampleDepth = texture(gPosition, off.xy).z;
-//		float rangeCheck = smoothstep(0.0, 1.0, radius / abs(fragPos.z - sampleDepth));
-//		occlusion += (sampleDepth >= _sample.z + bias ? 1.0 : 0.0) * rangeCheck;
-//	}
-//
-//	occlusion = 1.0 - (occlusion / kernelSize);
-//	frag_color = occlusion;
-	frag_color = 1.0f;
+	if (texture(gDepth, TexCoords * uvScale).r == 1.0) {
+		frag_color = vec2(1.0, 0.0);
+		return ;
+	}
+
+	vec3 fragPos = ViewPosition(TexCoords);
+	vec3 normal = normalize(mat3(viewMatrix) * DecodeNormal(texture(gNormal, TexCoords * uvScale).rg));
+	vec3 randVec = normalize(texture(texNoise, TexCoords * uvScale * noiseScale.xy).xyz);
+
+	vec3 tangent = normalize(randVec - normal * dot(randVec, normal));
+	vec3 bitangent = cross(normal, tangent);
+	mat3 TBN = mat3(tangent, bitangent, normal);
+
+	float occlusion = 0.0;
+	for (int i = 0; i < kernelSize; i++) {
+		vec3 _sample = TBN * samples[i];
+		_sample = fragPos + _sample * radius;
+
+		vec4 off = vec4(_sample, 1.0);
+		off = projectionMatrix * off;
+		off.xyz /= off.w;
+		off.xyz = off.xyz * 0.5 + 0.5;
+
+		float sampleDepth = ViewPosition(off.xy).z;
+		float rangeCheck = smoothstep(0.0, 1.0, radius / abs(fragPos.z - sampleDepth));
+		occlusion += (sampleDepth >= _sample.z + bias ? 1.0 : 0.0) * rangeCheck;
+	}
+
+	occlusion = 1.0 - (occlusion / float(kernelSize));
+	frag_color = vec2(occlusion, -fragPos.z);
 }
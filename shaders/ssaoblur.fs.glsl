@@ -1,20 +1,37 @@
 #version 330 core
 
-out float frag_color;
+out vec2 frag_color;
 
 in vec2 TexCoords;
 
+// r: occlusion, g: linear view depth
 uniform sampler2D ssaoInput;
 
+// Fraction of the target covered by the rendered frame
+uniform float uvScale;
+
+// Relative depth difference after which a sample is ignored
+const float depthThreshold = 0.05;
+
 void main()
 {
 	vec2 texelSize = 1.0 / vec2(textureSize(ssaoInput, 0));
+	vec2 uv = TexCoords * uvScale;
+	vec2 maxUv = vec2(uvScale) - texelSize * 0.5;
+	vec2 center = texture(ssaoInput, uv).rg;
+
 	float result = 0.0;
+	float weight = 0.0;
 	for (int x = -2; x < 2; x++) {
 		for (int y = -2; y < 2; y++) {
 			vec2 offset = vec2(float(x), float(y)) * texelSize;
-			result += texture(ssaoInput, TexCoords + offset).r;
+			vec2 s = texture(ssaoInput, min(uv + offset, maxUv)).rg;
+
+			// Bilateral weight, do not blur across depth discontinuities
+			float w = abs(s.g - center.g) <= depthThreshold * center.g ? 1.0 : 0.0;
+			result += s.r * w;
+			weight += w;
 		}
 	}
-	frag_color = result / (4.0 * 4.0);
+	frag_color = vec2(weight > 0.0 ? result / weight : center.r, center.g);
 }
@@ -3,6 +3,7 @@
 out vec4 frag_color;
 
 in vec2 TexCoords;
+in vec4 VertexColor;
 
 uniform sampler2D tex;
 uniform vec4 color;
@@ -11,7 +12,8 @@ void main()
 {
 	vec4 sampled = vec4(1.0, 1.0, 1.0, texture(tex, TexCoords).r);
 	if (color.a > 0.0) {
-		frag_color = color * sampled;
+		// Glyphs carry their color in the vertices
+		frag_color = color * VertexColor * sampled;
 	}
 	else {
 		frag_color = texture(tex, TexCoords);
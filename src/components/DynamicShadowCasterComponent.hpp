@@ -0,0 +1,12 @@
+#pragma once
+
+#include "ecs/Component.hpp"
+
+///
+/// Tag for entities that move every frame (ie. the player).
+/// Their shadows are composited on top of the cached static shadow map
+/// instead of invalidating it.
+///
+struct DynamicShadowCasterComponent : ecs::IComponentBase
+{
+};
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "ecs/Component.hpp"
+
+///
+/// Tag for a text entity displaying the GPU pass timings
+///
+struct GpuProfilerHudComponent : ecs::IComponentBase
+{
+	/// Display the GLStats counters instead, only built with gl_stats
+	bool GLCalls = false;
+};
@@ -14,6 +14,10 @@ struct PlayerCameraComponent : ecs::IComponentBase
 	float exposure;
 	bool useInput = true;
 
+	/// Lay down the depth of the scene before the G-buffer pass so that only
+	/// visible fragments are shaded. Pays off with a lot of overdraw.
+	bool depthPrepass = false;
+
 	static PlayerCameraComponent New(float fov, float near, float far);
 };
 
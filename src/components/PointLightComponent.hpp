@@ -9,4 +9,7 @@ struct PointLightComponent : ecs::IComponentBase
 	glm::vec3 Color = { 1.0f, 1.0f, 0.8f };
 
 	float Intensity = 1000.0f;
+
+	/// Distance after which the light has no effect, 0 derives it from the intensity
+	float Radius = 0.0f;
 };
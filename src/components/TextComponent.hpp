@@ -1,16 +1,26 @@
 #pragma once
 
+#include <algorithm>
 #include <string>
+#include <string_view>
+#include <fmt/format.h>
 #include "ecs/Component.hpp"
 #include "ui/Anchor.hpp"
+#include "ui/TextLayout.hpp"
 
 struct TextComponent : ecs::IComponentBase
 {
+	/// Longest text Format() can produce
+	static constexpr size_t MaxFormattedLength = 256;
+
 	std::string Text = "";
 	float Scale = 1.0f;
 	glm::vec3 Color;
 	anchor::Anchor Anchor;
 
+	/// Glyph quads of the text, laid out again by TextRendererSystem when it changed
+	TextLayout Layout;
+
 	static TextComponent New(std::string text, float scale = 1.0f, glm::vec3 color = { 1.0f, 1.0f, 1.0f }, anchor::Anchor anchor = anchor::Anchor::BottomLeft)
 	{
 		TextComponent textComponent;
@@ -21,4 +31,22 @@ struct TextComponent : ecs::IComponentBase
 
 		return textComponent;
 	}
+
+	///
+	/// Replace the text with a formatted string, written in a fixed buffer.
+	/// Text keeps its storage and is only touched when the result differs,
+	/// so updating a text every frame does not allocate.
+	///
+	template <typename... Args>
+	void Format(fmt::format_string<Args...> format, Args &&...args)
+	{
+		char buffer[MaxFormattedLength];
+
+		auto const result = fmt::format_to_n(buffer, sizeof(buffer), format, std::forward<Args>(args)...);
+		auto const formatted = std::string_view(buffer, std::min(result.size, sizeof(buffer)));
+
+		if (formatted != Text) {
+			Text.assign(formatted.data(), formatted.size());
+		}
+	}
 };
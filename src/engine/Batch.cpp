@@ -1,5 +1,6 @@
 #include "Batch.hpp"
 #include "Engine.hpp"
+#include "GLStats.hpp"
 
 namespace engine {
 
@@ -27,7 +28,7 @@ void Batch::AddMesh(
 void Batch::Build()
 {
 	glGenVertexArrays(1, &_vao);
-	glBindVertexArray(_vao);
+	GLState::Instance().BindVertexArray(_vao);
 
 	glEnableVertexAttribArray(0);
 	glEnableVertexAttribArray(1);
@@ -48,21 +49,25 @@ void Batch::Build()
 
 	if (_positions.size() > 0) {
 		glBufferSubData(GL_ARRAY_BUFFER, offset, _positions.size() * sizeof(GLfloat), _positions.data());
+		GL_STATS(Upload(_positions.size() * sizeof(GLfloat)));
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), reinterpret_cast<void*>(offset));
 		offset += _positions.size() * sizeof(GLfloat);
 	}
 	if (_normals.size() > 0) {
 		glBufferSubData(GL_ARRAY_BUFFER, offset, _normals.size() * sizeof(GLfloat), _normals.data());
+		GL_STATS(Upload(_normals.size() * sizeof(GLfloat)));
 		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), reinterpret_cast<void*>(offset));
 		offset += _normals.size() * sizeof(GLfloat);
 	}
 	if (_uvs.size() > 0) {
 		glBufferSubData(GL_ARRAY_BUFFER, offset, _uvs.size() * sizeof(GLfloat), _uvs.data());
+		GL_STATS(Upload(_uvs.size() * sizeof(GLfloat)));
 		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), reinterpret_cast<void*>(offset));
 		offset += _uvs.size() * sizeof(GLfloat);
 	}
 	if (_tangents.size() > 0) {
 		glBufferSubData(GL_ARRAY_BUFFER, offset, _tangents.size() * sizeof(GLfloat), _tangents.data());
+		GL_STATS(Upload(_tangents.size() * sizeof(GLfloat)));
 		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), reinterpret_cast<void*>(offset));
 		offset += _tangents.size() * sizeof(GLfloat);
 	}
@@ -80,15 +85,16 @@ void Batch::Build()
 	glGenBuffers(1, &_ibo);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * _indices.size(), _indices.data(), GL_STATIC_DRAW);
+	GL_STATS(Upload(sizeof(GLuint) * _indices.size()));
 
-	glBindVertexArray(0);
+	GLState::Instance().BindVertexArray(0);
 }
 
 void Batch::Draw() const
 {
-	glBindVertexArray(_vao);
+	GLState::Instance().BindVertexArray(_vao);
 	glDrawElements(GL_TRIANGLES, _indices.size(), GL_UNSIGNED_INT, nullptr);
-	glBindVertexArray(0);
+	GL_STATS(Draw(GL_TRIANGLES, _indices.size()));
 }
 
 }
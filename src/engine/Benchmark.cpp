@@ -0,0 +1,183 @@
+#include "Benchmark.hpp"
+#include "GpuProfiler.hpp"
+#include "Logger.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+
+namespace engine
+{
+
+namespace
+{
+
+std::string Quote(std::string const &value)
+{
+	std::string quoted = "\"";
+
+	for (char c : value) {
+		if (c == '"' || c == '\\') { quoted += '\\'; }
+		quoted += c;
+	}
+
+	return quoted + "\"";
+}
+
+std::string ToJson(Benchmark::Summary const &s)
+{
+	return fmt::format("{{ \"count\": {}, \"mean\": {:.4f}, \"min\": {:.4f}, \"p50\": {:.4f}, \"p90\": {:.4f}, "
+		"\"p95\": {:.4f}, \"p99\": {:.4f}, \"max\": {:.4f} }}",
+		s.Count, s.Mean, s.Min, s.P50, s.P90, s.P95, s.P99, s.Max);
+}
+
+}
+
+auto Benchmark::Summarize(std::vector<float> values) -> Summary
+{
+	Summary summary;
+
+	if (values.empty()) { return summary; }
+
+	std::sort(values.begin(), values.end());
+
+	// Nearest rank
+	auto percentile = [&] (float p) {
+		size_t rank = static_cast<size_t>(std::ceil(p / 100.0f * values.size()));
+		return values[std::clamp(rank, static_cast<size_t>(1), values.size()) - 1];
+	};
+
+	summary.Count = values.size();
+	summary.Mean = std::accumulate(values.begin(), values.end(), 0.0f) / values.size();
+	summary.Min = values.front();
+	summary.P50 = percentile(50.0f);
+	summary.P90 = percentile(90.0f);
+	summary.P95 = percentile(95.0f);
+	summary.P99 = percentile(99.0f);
+	summary.Max = values.back();
+
+	return summary;
+}
+
+void Benchmark::BeginFrame()
+{
+	_frameStart = std::chrono::steady_clock::now();
+}
+
+void Benchmark::EndFrame(std::vector<ecs::SystemTiming> const &systems)
+{
+	std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - _frameStart;
+
+	_frameMs.push_back(elapsed.count());
+
+	for (auto const &system : systems) {
+		_systemMs[system.Name].push_back(system.Ms);
+	}
+
+	CollectGpu();
+#ifdef ENGINE_GL_STATS
+	CollectGLStats();
+#endif
+}
+
+#ifdef ENGINE_GL_STATS
+void Benchmark::CollectGLStats()
+{
+	for (auto const &pass : GLStats::Instance().GetPasses()) {
+		auto const &counts = pass.Counts;
+		auto &series = _glStats[pass.Name];
+
+		series["drawCalls"].push_back(counts.DrawCalls);
+		series["instances"].push_back(counts.Instances);
+		series["primitives"].push_back(counts.Primitives);
+		series["bufferUploads"].push_back(counts.BufferUploads);
+		series["bytesUploaded"].push_back(counts.BytesUploaded);
+		series["textureBinds"].push_back(counts.TextureBinds);
+		series["programBinds"].push_back(counts.ProgramBinds);
+		series["framebufferBinds"].push_back(counts.FramebufferBinds);
+	}
+}
+#endif
+
+void Benchmark::CollectGpu()
+{
+	for (auto const &pass : GpuProfiler::Instance().GetStats()) {
+		auto &collected = _gpuSamples[pass.Name];
+
+		// Samples older than the history window are lost, this only happens
+		// if a pass is measured many times in a frame
+		size_t first = std::max(collected, pass.Samples > GpuProfiler::Window ? pass.Samples - GpuProfiler::Window : 0);
+
+		for (size_t sample = first; sample < pass.Samples; sample++) {
+			_gpuMs[pass.Name].push_back(pass.History[sample % GpuProfiler::Window]);
+		}
+
+		collected = pass.Samples;
+	}
+}
+
+bool Benchmark::WriteReport(std::string const &path, std::map<std::string, std::string> const &parameters)
+{
+	// Results of the last frames are still in flight, take what is there
+	CollectGpu();
+
+	std::ofstream file(path);
+
+	if (!file.is_open()) {
+		Logger::Error("Benchmark: could not write {}\n", path);
+		return false;
+	}
+
+	auto writeObject = [&] (std::map<std::string, std::vector<float>> const &series) {
+		size_t i = 0;
+
+		for (auto const &[name, values] : series) {
+			file << "    " << Quote(name) << ": " << ToJson(Summarize(values)) << (++i < series.size() ? ",\n" : "\n");
+		}
+	};
+
+	file << "{\n";
+
+	file << "  \"parameters\": {\n";
+	size_t i = 0;
+	for (auto const &[name, value] : parameters) {
+		file << "    " << Quote(name) << ": " << value << (++i < parameters.size() ? ",\n" : "\n");
+	}
+	file << "  },\n";
+
+	file << "  \"frameMs\": " << ToJson(Summarize(_frameMs)) << ",\n";
+
+	file << "  \"systemCpuMs\": {\n";
+	writeObject(_systemMs);
+	file << "  },\n";
+
+	file << "  \"gpuPassMs\": {\n";
+	writeObject(_gpuMs);
+#ifdef ENGINE_GL_STATS
+	file << "  },\n";
+
+	// Frames in which a pass did not run have no sample
+	file << "  \"glStats\": {\n";
+	size_t pass = 0;
+	for (auto const &[name, series] : _glStats) {
+		size_t counter = 0;
+
+		file << "    " << Quote(name) << ": {\n";
+		for (auto const &[counterName, values] : series) {
+			file << "      " << Quote(counterName) << ": " << ToJson(Summarize(values)) << (++counter < series.size() ? ",\n" : "\n");
+		}
+		file << "    }" << (++pass < _glStats.size() ? ",\n" : "\n");
+	}
+#endif
+	file << "  }\n";
+
+	file << "}\n";
+
+	auto frame = Summarize(_frameMs);
+	Logger::Info("Benchmark: {} frames, p50 {:.2f} ms, p99 {:.2f} ms, report written to {}\n",
+		frame.Count, frame.P50, frame.P99, path);
+
+	return true;
+}
+
+}
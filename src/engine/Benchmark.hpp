@@ -0,0 +1,66 @@
+#pragma once
+
+#include "ecs/SystemManager.hpp"
+#include "GLStats.hpp"
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace engine
+{
+
+///
+/// Collects the timings of a benchmark run and writes them as JSON:
+///   - wall clock time of every frame, as percentiles
+///   - CPU time of every ECS system, per frame
+///   - GPU time of every GpuProfiler pass, every sample read back
+///   - GL calls of every pass, per frame (only built with gl_stats)
+///
+class Benchmark
+{
+public:
+	struct Summary
+	{
+		float Mean = 0.0f;
+		float Min = 0.0f;
+		float P50 = 0.0f;
+		float P90 = 0.0f;
+		float P95 = 0.0f;
+		float P99 = 0.0f;
+		float Max = 0.0f;
+		size_t Count = 0;
+	};
+
+private:
+	std::chrono::steady_clock::time_point _frameStart;
+
+	std::vector<float> _frameMs;
+	// Ordered by name so that reports can be diffed
+	std::map<std::string, std::vector<float>> _systemMs;
+	std::map<std::string, std::vector<float>> _gpuMs;
+	// Samples of each GPU pass already collected
+	std::map<std::string, size_t> _gpuSamples;
+#ifdef ENGINE_GL_STATS
+	// Pass, then counter
+	std::map<std::string, std::map<std::string, std::vector<float>>> _glStats;
+
+	void CollectGLStats();
+#endif
+
+	void CollectGpu();
+
+public:
+	static Summary Summarize(std::vector<float> values);
+
+	void BeginFrame();
+	void EndFrame(std::vector<ecs::SystemTiming> const &systems);
+
+	///
+	/// Write the report, `parameters` are copied as is in the
+	/// "parameters" object (values must already be valid JSON)
+	///
+	bool WriteReport(std::string const &path, std::map<std::string, std::string> const &parameters);
+};
+
+}
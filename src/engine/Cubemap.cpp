@@ -1,5 +1,7 @@
 #include "Cubemap.hpp"
 #include "stb_image.h"
+#include "GLState.hpp"
+#include "GLStats.hpp"
 #include <array>
 #include <glm/glm.hpp>
 
@@ -21,7 +23,7 @@ void Cubemap::setupTexture()
 	};
 
 	glGenTextures(1, &_texture);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, _texture);
+	engine::GLState::Instance().BindTexture(GL_TEXTURE_CUBE_MAP, _texture);
 
 	stbi_set_flip_vertically_on_load(false);
 	for (size_t i = 0; i < 6; i++) {
@@ -39,7 +41,7 @@ void Cubemap::setupTexture()
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	engine::GLState::Instance().BindTexture(GL_TEXTURE_CUBE_MAP, 0);
 }
 
 void Cubemap::setupMesh()
@@ -91,30 +93,30 @@ void Cubemap::setupMesh()
 	glGenVertexArrays(1, &_vao);
 	glGenBuffers(1, &_vbo);
 
-	glBindVertexArray(_vao);
+	engine::GLState::Instance().BindVertexArray(_vao);
 	glBindBuffer(GL_ARRAY_BUFFER, _vbo);
 
 	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);
+	GL_STATS(Upload(sizeof(verts)));
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 3, (void*)0);
 
-	glBindVertexArray(0);
+	engine::GLState::Instance().BindVertexArray(0);
 }
 
 Cubemap::~Cubemap()
 {
-	glDeleteTextures(1, &_texture);
-	glDeleteVertexArrays(1, &_vao);
+	engine::GLState::Instance().DeleteTexture(_texture);
+	engine::GLState::Instance().DeleteVertexArray(_vao);
 	glDeleteBuffers(1, &_vbo);
 }
 
 void Cubemap::draw()
 {
-	glDepthMask(GL_FALSE);
-	glBindVertexArray(_vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, _texture);
+	engine::GLState::Instance().DepthMask(GL_FALSE);
+	engine::GLState::Instance().BindVertexArray(_vao);
+	engine::GLState::Instance().BindTexture(GL_TEXTURE0, GL_TEXTURE_CUBE_MAP, _texture);
 	glDrawArrays(GL_TRIANGLES, 0, 36);
-	glBindVertexArray(0);
-	glDepthMask(GL_TRUE);
+	GL_STATS(Draw(GL_TRIANGLES, 36));
+	engine::GLState::Instance().DepthMask(GL_TRUE);
 }
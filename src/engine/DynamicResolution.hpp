@@ -0,0 +1,81 @@
+#pragma once
+
+#include "GpuProfiler.hpp"
+#include "utils/Settings.hpp"
+#include <algorithm>
+#include <cmath>
+
+///
+/// Chooses the fraction of the display resolution the scene is rendered at
+/// so that the frame time stays close to `targetFrameTime` (in milliseconds).
+///
+/// The measured time is the GPU frame time when the GpuProfiler is running
+/// (resolution mostly affects the GPU) and the CPU frame time otherwise.
+/// It is smoothed and the scale only moves by small steps after a cooldown,
+/// to avoid oscillating between two resolutions.
+///
+class DynamicResolution
+{
+private:
+	float _scale = 1.0f;
+	float _smoothedMs = 0.0f;
+	int _cooldown = 0;
+
+	// Frames to wait after a change before adjusting again
+	static constexpr int Cooldown = 15;
+	// Maximum change of the scale at each adjustment
+	static constexpr float MaxStep = 0.05f;
+	// Scale values are rounded to this step so targets are not resized every frame
+	static constexpr float Granularity = 0.05f;
+	static constexpr float Smoothing = 0.1f;
+
+public:
+	///
+	/// Feed the duration of the last frame and return the scale to render at.
+	/// Returns 1.0 when dynamic resolution is disabled.
+	///
+	float Update(float deltaTime)
+	{
+		auto &settings = Settings::instance();
+
+		if (!std::any_cast<int>(settings.get("dynamicResolution"))) {
+			_scale = 1.0f;
+			return _scale;
+		}
+
+		auto targetMs = std::any_cast<float>(settings.get("targetFrameTime"));
+		auto minScale = std::clamp(std::any_cast<float>(settings.get("minRenderScale")), 0.1f, 1.0f);
+
+		// The time measured for one frame, only the passes that ran count
+		auto const &profiler = engine::GpuProfiler::Instance();
+		float frameMs = profiler.IsEnabled() && profiler.GetLastFrameMs() > 0.0f
+			? profiler.GetLastFrameMs()
+			: deltaTime * 1000.0f;
+
+		_smoothedMs = _smoothedMs == 0.0f ? frameMs : _smoothedMs + (frameMs - _smoothedMs) * Smoothing;
+
+		if (_cooldown > 0) {
+			_cooldown--;
+			return _scale;
+		}
+
+		// The cost is roughly proportional to the number of pixels, so to the square of the scale
+		float wanted = _scale * std::sqrt(targetMs / std::max(_smoothedMs, 0.001f));
+		float scale = std::clamp(wanted, _scale - MaxStep, _scale + MaxStep);
+
+		scale = std::round(scale / Granularity) * Granularity;
+		scale = std::clamp(scale, minScale, 1.0f);
+
+		// Dead zone around the target
+		bool outside = _smoothedMs > targetMs * 1.05f || _smoothedMs < targetMs * 0.85f;
+
+		if (outside && scale != _scale) {
+			_scale = scale;
+			_cooldown = Cooldown;
+		}
+
+		return _scale;
+	}
+
+	float GetScale() const { return _scale; }
+};
@@ -1,5 +1,12 @@
 #include "Engine.hpp"
 #include "Time.hpp"
+#include "GpuProfiler.hpp"
+#include "RenderTargetPool.hpp"
+#include "GLState.hpp"
+#include "GLStats.hpp"
+#include "ShaderManager.hpp"
+#include "Benchmark.hpp"
+#include "InputReplay.hpp"
 #include "utils/Settings.hpp"
 #include "stb_image.h"
 #include "components/SelectedComponent.hpp"
@@ -16,7 +23,16 @@ unsigned int Engine::_nextMaterialId = 0;
 
 Engine::Engine()
 {
-	_display = std::make_unique<lazy::graphics::Display>("3D Engine", 1920, 1080);
+	// From config.ini or the command line, both read before the engine is created
+	bool headless = std::any_cast<int>(Settings::instance().get("headless"));
+	auto width = std::any_cast<int>(Settings::instance().get("windowWidth"));
+	auto height = std::any_cast<int>(Settings::instance().get("windowHeight"));
+
+	if (headless) {
+		Logger::Info("Headless rendering at {}x{}\n", width, height);
+	}
+
+	_display = std::make_unique<lazy::graphics::Display>("3D Engine", width, height, headless);
 	_display->enableCap(GL_DEPTH_TEST);
 	_display->enableCap(GL_CULL_FACE);
 	_display->enableCap(GL_BLEND);
@@ -24,15 +40,21 @@ Engine::Engine()
 	_display->showCursor(false);
 	glEnable(GL_DEBUG_OUTPUT);
 
+	// The display enabled its capabilities without it, they are issued again
+	GLState::Instance().Init();
+
+	// Before any shader is linked
+	ShaderManager::instance().Init();
+
 	lazy::maths::transform t = { glm::vec3(32, 64, 32), glm::quat(), glm::vec3(1), nullptr };
 	_camera = std::make_unique<lazy::graphics::Camera>(*_display, t);
 	_camera->setProjection(glm::radians(80.0f), 0.1f, 1000.0f);
 
 	_ui = std::make_unique<UI>(_display->getWidth(), _display->getHeight());
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glDepthFunc(GL_LEQUAL);
+	GLState::Instance().Enable(GL_BLEND);
+	GLState::Instance().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::Instance().DepthFunc(GL_LEQUAL);
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
 	_ecs = ecs::ECSEngine::Get().CreateInstance();
@@ -84,14 +106,50 @@ Engine::~Engine() = default;
 
 int Engine::Run()
 {
-	Settings::instance().load("config.ini");
+	auto &settings = Settings::instance();
+
+	// Benchmark mode (--bench): a fixed number of frames, timed, with a fixed
+	// delta time and replayed input so that every run does the same work
+	auto const benchFrames = std::any_cast<int>(settings.get("benchFrames"));
+	auto const fixedDeltaTime = std::any_cast<float>(settings.get("fixedDeltaTime"));
+	auto const replayFile = std::any_cast<std::string>(settings.get("replayFile"));
+	auto const recordFile = std::any_cast<std::string>(settings.get("recordFile"));
+
+	InputReplay replay;
+	Benchmark benchmark;
+
+	if (!replayFile.empty()) {
+		if (!replay.Load(replayFile)) { return 1; }
+		Logger::Info("Replaying {} input events from {}\n", replay.GetEventCount(), replayFile);
+	}
+
+	if (!replayFile.empty() || benchFrames > 0) {
+		InputReplay::DetachLiveInput(_display->getWindow());
+	}
+	else if (!recordFile.empty()) {
+		replay.StartRecording(_display->getWindow());
+	}
 
 	_Scene = std::make_unique<PlayScene>();
 	_Scene->OnSetup();
 	_Scene->OnPlay();
-	while (!_display->isClosed())
+
+	ShaderManager::instance().ReleasePrewarmed();
+
+	Logger::Info("Shaders: {} programs linked, {} loaded from binaries\n",
+		ShaderManager::instance().GetLinkCount(), ShaderManager::instance().GetBinaryLoadCount());
+
+	int frame = 0;
+
+	while (!_display->isClosed() && (benchFrames <= 0 || frame < benchFrames))
 	{
-		float deltaTime = Time::instance().getDeltaTime();
+		benchmark.BeginFrame();
+
+		float deltaTime = fixedDeltaTime > 0.0f ? fixedDeltaTime : Time::instance().getDeltaTime();
+
+		GpuProfiler::Instance().BeginFrame();
+		RenderTargetPool::Instance().BeginFrame();
+		GLState::Instance().BeginFrame();
 
 		Update();
 		_Scene->OnUpdate(deltaTime);
@@ -104,10 +162,38 @@ int Engine::Run()
 		_ui->render();
 
 		_display->update();
+		replay.Apply();
 		_display->updateInputs();
+		replay.EndFrame();
+		GL_STATS(EndFrame());
+
+		if (benchFrames > 0) {
+			benchmark.EndFrame(_Scene->ECS().SystemManager->GetTimings());
+		}
+		frame++;
 	}
 	_Scene->OnStop();
 
+	if (!recordFile.empty() && replayFile.empty() && benchFrames <= 0) {
+		replay.StopRecording(_display->getWindow());
+		replay.Save(recordFile);
+	}
+
+	if (benchFrames > 0) {
+		std::map<std::string, std::string> parameters = {
+			{ "frames", std::to_string(frame) },
+			{ "fixedDeltaTime", fmt::format("{}", fixedDeltaTime) },
+			{ "seed", std::to_string(std::any_cast<unsigned int>(settings.get("seed"))) },
+			{ "width", std::to_string(_display->getWidth()) },
+			{ "height", std::to_string(_display->getHeight()) },
+			{ "headless", _display->isHeadless() ? "true" : "false" },
+		};
+
+		if (!benchmark.WriteReport(std::any_cast<std::string>(settings.get("benchReport")), parameters)) {
+			return 1;
+		}
+	}
+
 	return 0;
 }
 
@@ -7,6 +7,7 @@
 #include "EngineObject.hpp"
 #include "Mesh.hpp"
 #include "Batch.hpp"
+#include "GLState.hpp"
 #include <unordered_map>
 #include "TextureManager.hpp"
 #include <fmt/format.h>
@@ -48,6 +49,7 @@ private:
 
 	std::unordered_map<std::string, MaterialContainer> _materials;
 	std::unordered_map<std::string, PbrMaterial> _pbrMaterials;
+	size_t _pbrMaterialsVersion = 0;
 
 	static unsigned int _nextId;
 	static unsigned int _nextMaterialId;
@@ -150,8 +152,14 @@ public:
 		}
 
 		_pbrMaterials[material.Name] = material;
+		_pbrMaterialsVersion++;
 	}
 
+	std::unordered_map<std::string, PbrMaterial> const &GetPbrMaterials() const { return _pbrMaterials; }
+
+	/// Incremented every time a material is added
+	size_t GetPbrMaterialsVersion() const { return _pbrMaterialsVersion; }
+
 	void BindPbrMaterial(std::string const &name)
 	{
 		if (name.size() == 0) {
@@ -166,25 +174,20 @@ public:
 		auto const &material = _pbrMaterials[name];
 
 		if (material.Albedo.has_value()) {
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, TextureManager::instance().get(material.Albedo.value()));
+			GLState::Instance().BindTexture(GL_TEXTURE0, GL_TEXTURE_2D, TextureManager::instance().get(material.Albedo.value()));
 		}
 		if (material.Normal.has_value()) {
-			glActiveTexture(GL_TEXTURE2);
-			glBindTexture(GL_TEXTURE_2D, TextureManager::instance().get(material.Normal.value()));
+			GLState::Instance().BindTexture(GL_TEXTURE2, GL_TEXTURE_2D, TextureManager::instance().get(material.Normal.value()));
 		}
 	}
 
 	void UnbindPbrMaterial()
 	{
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		GLState::Instance().BindTexture(GL_TEXTURE0, GL_TEXTURE_2D, 0);
 
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		GLState::Instance().BindTexture(GL_TEXTURE1, GL_TEXTURE_2D, 0);
 
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		GLState::Instance().BindTexture(GL_TEXTURE2, GL_TEXTURE_2D, 0);
 	}
 
 	std::optional<PbrMaterial const *> GetPbrMaterial(std::string const &name)
@@ -220,29 +223,23 @@ public:
 		auto const &material = _materials[name].second;
 
 		if (material.diffuse > 0) {
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, material.diffuse);
+			GLState::Instance().BindTexture(GL_TEXTURE0, GL_TEXTURE_2D, material.diffuse);
 		}
 		if (material.specular > 0) {
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, material.specular);
+			GLState::Instance().BindTexture(GL_TEXTURE1, GL_TEXTURE_2D, material.specular);
 		}
 		if (material.normal > 0) {
-			glActiveTexture(GL_TEXTURE2);
-			glBindTexture(GL_TEXTURE_2D, material.normal);
+			GLState::Instance().BindTexture(GL_TEXTURE2, GL_TEXTURE_2D, material.normal);
 		}
 	}
 
 	void UnbindMaterial()
 	{
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		GLState::Instance().BindTexture(GL_TEXTURE0, GL_TEXTURE_2D, 0);
 
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		GLState::Instance().BindTexture(GL_TEXTURE1, GL_TEXTURE_2D, 0);
 
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		GLState::Instance().BindTexture(GL_TEXTURE2, GL_TEXTURE_2D, 0);
 	}
 
 	unsigned int GetMaterialId(std::string const &name)
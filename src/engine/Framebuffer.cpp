@@ -1,10 +1,14 @@
 #include "Framebuffer.hpp"
 #include "Engine.hpp"
+#include "RenderTargetPool.hpp"
 
 namespace engine {
 
 Framebuffer::Framebuffer(Framebuffer_Type type)
 {
+	_width = Engine::Instance().GetDisplay()->getWidth();
+	_height = Engine::Instance().GetDisplay()->getHeight();
+
 	glGenFramebuffers(1, &_id);
 
 	switch (type) {
@@ -25,17 +29,19 @@ Framebuffer::Framebuffer(Framebuffer_Type type)
 
 Framebuffer::~Framebuffer()
 {
-	if (_id > 0) { glDeleteFramebuffers(1, &_id); }
+	if (_texture) { RenderTargetPool::Instance().Release(_texture); }
+	if (_depth) { RenderTargetPool::Instance().Release(_depth); }
+	if (_id > 0) { GLState::Instance().DeleteFramebuffer(_id); }
 }
 
 void Framebuffer::Bind()
 {
-	glBindFramebuffer(_bindType, _id);
+	GLState::Instance().BindFramebuffer(_bindType, _id);
 }
 
 void Framebuffer::Unbind()
 {
-	glBindFramebuffer(_bindType, 0);
+	GLState::Instance().BindFramebuffer(_bindType, 0);
 }
 
 bool Framebuffer::IsComplete()
@@ -49,36 +55,40 @@ bool Framebuffer::IsComplete()
 	return complete; 
 }
 
-void Framebuffer::AttachColorBuffer()
+void Framebuffer::AttachTarget(GLuint &texture, GLenum internalFormat)
 {
-	int width = Engine::Instance().GetDisplay()->getWidth();
-	int height = Engine::Instance().GetDisplay()->getHeight();
+	auto &pool = RenderTargetPool::Instance();
+
+	if (texture) { pool.Release(texture); }
 
-	glGenTextures(1, &_texture);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, _texture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	texture = pool.Acquire({ _width, _height, internalFormat });
 
 	Bind();
-	glFramebufferTexture2D(_bindType, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _texture, 0);
+	glFramebufferTexture2D(_bindType, RenderTargetPool::GetAttachment(internalFormat), GL_TEXTURE_2D, texture, 0);
 	Unbind();
 }
 
+void Framebuffer::AttachColorBuffer()
+{
+	AttachTarget(_texture, ColorFormat);
+}
+
 void Framebuffer::AttachDepthBuffer()
 {
-	int width = Engine::Instance().GetDisplay()->getWidth();
-	int height = Engine::Instance().GetDisplay()->getHeight();
+	AttachTarget(_depth, DepthFormat);
+}
+
+void Framebuffer::Resize(int width, int height)
+{
+	// Minimized window, keep the targets of the last size
+	if (width <= 0 || height <= 0) { return ; }
+	if (width == _width && height == _height) { return ; }
 
-	glGenRenderbuffers(1, &_depth);
-	glBindRenderbuffer(GL_RENDERBUFFER, _depth);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
-	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	_width = width;
+	_height = height;
 
-	Bind();
-	glFramebufferRenderbuffer(_bindType, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, _depth);
-	Unbind();
+	if (_texture) { AttachTarget(_texture, ColorFormat); }
+	if (_depth) { AttachTarget(_depth, DepthFormat); }
 }
 
 }
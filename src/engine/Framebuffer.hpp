@@ -10,14 +10,27 @@ enum class Framebuffer_Type {
 	RW,
 };
 
+///
+/// Framebuffer with an optional color and depth target, both taken from the
+/// RenderTargetPool at the display size. Resize() swaps them for targets of
+/// another size.
+///
 class Framebuffer
 {
 private:
 	GLuint _id;
 	GLuint _bindType;
 
-	GLuint _texture;
-	GLuint _depth;
+	GLuint _texture = 0;
+	GLuint _depth = 0;
+
+	int _width;
+	int _height;
+
+	static constexpr GLenum ColorFormat = GL_RGB8;
+	static constexpr GLenum DepthFormat = GL_DEPTH24_STENCIL8;
+
+	void AttachTarget(GLuint &texture, GLenum internalFormat);
 
 public:
 	Framebuffer() = delete;
@@ -35,7 +48,12 @@ public:
 	void AttachColorBuffer();
 	void AttachDepthBuffer();
 
+	/// Does nothing if the size did not change
+	void Resize(int width, int height);
+
 	GLuint GetColorTexture() { return _texture; }
+	GLuint GetDepthTexture() const { return _depth; }
+	GLuint GetId() const { return _id; }
 };
 
 }
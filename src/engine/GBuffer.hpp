@@ -2,107 +2,124 @@
 
 #include "lazy.hpp"
 #include "Engine.hpp"
-
+#include "RenderTargetPool.hpp"
+
+///
+/// Packed G-buffer, 16 bytes per pixel:
+///   - normal:   RG16, octahedral encoded world space normal
+///   - albedo:   SRGB8_ALPHA8 base color
+///   - material: RGBA8, r = ambient occlusion, g = roughness, b = metallic
+///   - depth:    DEPTH24_STENCIL8 texture, world position is reconstructed
+///               from it in the lighting pass
+///
+/// The targets come from the RenderTargetPool and follow the display size.
+///
 class GBuffer
 {
 private:
-	GLuint _gBuffer;
-	GLuint _gPosition;
-	GLuint _gNormal;
-	GLuint _gAlbedoSpec;
-	GLuint _gDepth;
-	GLuint _gMetallicRoughness;
-
-	void Init()
+	GLuint _gBuffer = 0;
+	GLuint _gNormal = 0;
+	GLuint _gAlbedo = 0;
+	GLuint _gMaterial = 0;
+	GLuint _gDepth = 0;
+
+	int _width = 0;
+	int _height = 0;
+
+	void ReleaseTargets()
+	{
+		auto &pool = engine::RenderTargetPool::Instance();
+
+		for (auto texture : { _gNormal, _gAlbedo, _gMaterial, _gDepth }) {
+			if (texture) { pool.Release(texture); }
+		}
+		_gNormal = _gAlbedo = _gMaterial = _gDepth = 0;
+	}
+
+public:
+	static constexpr GLenum NormalFormat = GL_RG16;
+	static constexpr GLenum AlbedoFormat = GL_SRGB8_ALPHA8;
+	static constexpr GLenum MaterialFormat = GL_RGBA8;
+	// Same format as the default framebuffer so the depth can be blitted to it
+	static constexpr GLenum DepthFormat = GL_DEPTH24_STENCIL8;
+
+	GBuffer()
 	{
 		auto display = engine::Engine::Instance().GetDisplay();
-		auto [ width, height ] = std::tuple(display->getWidth(), display->getHeight());
 
 		glGenFramebuffers(1, &_gBuffer);
-		glBindFramebuffer(GL_FRAMEBUFFER, _gBuffer);
-
-		glGenTextures(1, &_gPosition);
-		glBindTexture(GL_TEXTURE_2D, _gPosition);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _gPosition, 0);
-
-		glGenTextures(1, &_gNormal);
-		glBindTexture(GL_TEXTURE_2D, _gNormal);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, _gNormal, 0);
-
-		glGenTextures(1, &_gAlbedoSpec);
-		glBindTexture(GL_TEXTURE_2D, _gAlbedoSpec);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, _gAlbedoSpec, 0);
-
-		glGenTextures(1, &_gMetallicRoughness);
-		glBindTexture(GL_TEXTURE_2D, _gMetallicRoughness);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, _gMetallicRoughness, 0);
-
-		glBindTexture(GL_TEXTURE_2D, 0);
-
-		glGenRenderbuffers(1, &_gDepth);
-		glBindRenderbuffer(GL_RENDERBUFFER, _gDepth);
-		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, width, height);
-		glBindRenderbuffer(GL_RENDERBUFFER, 0);
-		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _gDepth);
+		Resize(display->getWidth(), display->getHeight());
+	}
+
+	~GBuffer()
+	{
+		ReleaseTargets();
+		if (_gBuffer) { engine::GLState::Instance().DeleteFramebuffer(_gBuffer); }
+	}
+
+	GBuffer(GBuffer const &) = delete;
+	void operator=(GBuffer const &) = delete;
+
+	///
+	/// Take targets of a new size from the pool, the old ones go back to it.
+	/// Does nothing if the size did not change, or is empty (minimized window).
+	///
+	void Resize(int width, int height)
+	{
+		if (width <= 0 || height <= 0) { return ; }
+		if (width == _width && height == _height) { return ; }
+
+		auto &pool = engine::RenderTargetPool::Instance();
+
+		ReleaseTargets();
+
+		_width = width;
+		_height = height;
+
+		_gNormal = pool.Acquire({ width, height, NormalFormat });
+		_gAlbedo = pool.Acquire({ width, height, AlbedoFormat });
+		_gMaterial = pool.Acquire({ width, height, MaterialFormat });
+		_gDepth = pool.Acquire({ width, height, DepthFormat });
+
+		engine::GLState::Instance().BindFramebuffer(GL_FRAMEBUFFER, _gBuffer);
+
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _gNormal, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, _gAlbedo, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, _gMaterial, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, _gDepth, 0);
 
 		GLuint st = glCheckFramebufferStatus(GL_FRAMEBUFFER);
 		assert(st == GL_FRAMEBUFFER_COMPLETE);
 
-		std::array<GLuint, 4> attachments = {
+		std::array<GLuint, 3> attachments = {
 			GL_COLOR_ATTACHMENT0,
 			GL_COLOR_ATTACHMENT1,
 			GL_COLOR_ATTACHMENT2,
-			GL_COLOR_ATTACHMENT3,
 		};
 		glDrawBuffers(attachments.size(), attachments.data());
 
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	}
-
-public:
-	GBuffer()
-	{
-		Init();
-	}
-
-	~GBuffer()
-	{
-		if (_gBuffer) { glDeleteFramebuffers(1, &_gBuffer); }
-		if (_gPosition) { glDeleteTextures(1, &_gPosition); }
-		if (_gNormal) { glDeleteTextures(1, &_gNormal); }
-		if (_gAlbedoSpec) { glDeleteTextures(1, &_gAlbedoSpec); }
-		if (_gDepth) { glDeleteTextures(1, &_gDepth); }
-		if (_gMetallicRoughness) { glDeleteTextures(1, &_gMetallicRoughness); }
+		engine::GLState::Instance().BindFramebuffer(GL_FRAMEBUFFER, 0);
 	}
 
 	void Bind()
 	{
-		glBindFramebuffer(GL_FRAMEBUFFER, _gBuffer);
+		engine::GLState::Instance().BindFramebuffer(GL_FRAMEBUFFER, _gBuffer);
+		// Encode the albedo written by the shaders to sRGB
+		engine::GLState::Instance().Enable(GL_FRAMEBUFFER_SRGB);
 	}
 
 	void Unbind()
 	{
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		engine::GLState::Instance().Disable(GL_FRAMEBUFFER_SRGB);
+		engine::GLState::Instance().BindFramebuffer(GL_FRAMEBUFFER, 0);
 	}
 
+	int GetWidth() const { return _width; }
+	int GetHeight() const { return _height; }
+
 	GLuint GetFramebufferId() const { return _gBuffer; }
-	GLuint GetPositionTex() const { return _gPosition; }
 	GLuint GetNormalTex() const { return _gNormal; }
-	GLuint GetAlbedoSpecTex() const { return _gAlbedoSpec; }
+	GLuint GetAlbedoTex() const { return _gAlbedo; }
+	GLuint GetMaterialTex() const { return _gMaterial; }
 	GLuint GetDepthTex() const { return _gDepth; }
-	GLuint GetMetallicRoughnessTex() const { return _gMetallicRoughness; }
 };
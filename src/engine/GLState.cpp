@@ -0,0 +1,213 @@
+#include "GLState.hpp"
+#include "GLStats.hpp"
+#include <cassert>
+
+namespace engine
+{
+
+void GLState::Init()
+{
+	Invalidate();
+	lazy::graphics::setStateBinder(this);
+}
+
+void GLState::UseProgram(GLuint program)
+{
+	if (Change(_program, program)) {
+		GL_STATS(ProgramBind());
+		glUseProgram(program);
+	}
+}
+
+void GLState::BindVertexArray(GLuint vertexArray)
+{
+	if (Change(_vertexArray, vertexArray)) {
+		glBindVertexArray(vertexArray);
+	}
+}
+
+void GLState::DeleteVertexArray(GLuint vertexArray)
+{
+	if (vertexArray == 0) { return ; }
+
+	if (_vertexArray == vertexArray) { _vertexArray = 0; }
+	glDeleteVertexArrays(1, &vertexArray);
+}
+
+void GLState::BindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	if (target == GL_FRAMEBUFFER) {
+		if (_drawFramebuffer == framebuffer && _readFramebuffer == framebuffer) {
+			_frame.Skipped++;
+			return ;
+		}
+		_drawFramebuffer = framebuffer;
+		_readFramebuffer = framebuffer;
+		_frame.Issued++;
+		GL_STATS(FramebufferBind());
+		glBindFramebuffer(target, framebuffer);
+		return ;
+	}
+
+	auto &current = target == GL_READ_FRAMEBUFFER ? _readFramebuffer : _drawFramebuffer;
+
+	if (Change(current, framebuffer)) {
+		GL_STATS(FramebufferBind());
+		glBindFramebuffer(target, framebuffer);
+	}
+}
+
+void GLState::DeleteFramebuffer(GLuint framebuffer)
+{
+	if (framebuffer == 0) { return ; }
+
+	if (_drawFramebuffer == framebuffer) { _drawFramebuffer = 0; }
+	if (_readFramebuffer == framebuffer) { _readFramebuffer = 0; }
+	glDeleteFramebuffers(1, &framebuffer);
+}
+
+void GLState::ActiveTexture(GLenum unit)
+{
+	assert(unit >= GL_TEXTURE0 && unit < GL_TEXTURE0 + MaxTextureUnits);
+
+	if (Change(_activeTexture, unit)) {
+		glActiveTexture(unit);
+	}
+}
+
+void GLState::BindTexture(GLenum target, GLuint texture)
+{
+	// Which unit is active is unknown, so is what is bound to it
+	if (!_activeTexture.has_value()) {
+		ActiveTexture(GL_TEXTURE0);
+	}
+
+	auto &unit = _textures[_activeTexture.value() - GL_TEXTURE0];
+	auto bound = unit.find(target);
+
+	if (bound != unit.end() && bound->second == texture) {
+		_frame.Skipped++;
+		return ;
+	}
+
+	unit[target] = texture;
+	_frame.Issued++;
+	GL_STATS(TextureBind());
+	glBindTexture(target, texture);
+}
+
+void GLState::BindTexture(GLenum unit, GLenum target, GLuint texture)
+{
+	assert(unit >= GL_TEXTURE0 && unit < GL_TEXTURE0 + MaxTextureUnits);
+
+	auto const &bound = _textures[unit - GL_TEXTURE0];
+	auto current = bound.find(target);
+
+	// Leave the active unit alone when there is nothing to bind
+	if (current != bound.end() && current->second == texture) {
+		_frame.Skipped++;
+		return ;
+	}
+
+	ActiveTexture(unit);
+	BindTexture(target, texture);
+}
+
+void GLState::DeleteTexture(GLuint texture)
+{
+	if (texture == 0) { return ; }
+
+	for (auto &unit : _textures) {
+		for (auto &[target, bound] : unit) {
+			if (bound == texture) { bound = 0; }
+		}
+	}
+	glDeleteTextures(1, &texture);
+}
+
+void GLState::SetEnabled(GLenum capability, bool enabled)
+{
+	auto current = _capabilities.find(capability);
+
+	if (current != _capabilities.end() && current->second == enabled) {
+		_frame.Skipped++;
+		return ;
+	}
+
+	_capabilities[capability] = enabled;
+	_frame.Issued++;
+
+	if (enabled) { glEnable(capability); }
+	else { glDisable(capability); }
+}
+
+void GLState::Enable(GLenum capability)
+{
+	SetEnabled(capability, true);
+}
+
+void GLState::Disable(GLenum capability)
+{
+	SetEnabled(capability, false);
+}
+
+void GLState::BlendFunc(GLenum source, GLenum destination)
+{
+	if (Change(_blendFunc, std::pair(source, destination))) {
+		glBlendFunc(source, destination);
+	}
+}
+
+void GLState::DepthMask(GLboolean mask)
+{
+	if (Change(_depthMask, mask)) {
+		glDepthMask(mask);
+	}
+}
+
+void GLState::DepthFunc(GLenum func)
+{
+	if (Change(_depthFunc, func)) {
+		glDepthFunc(func);
+	}
+}
+
+void GLState::CullFace(GLenum mode)
+{
+	if (Change(_cullFace, mode)) {
+		glCullFace(mode);
+	}
+}
+
+void GLState::ColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
+{
+	if (Change(_colorMask, std::array<GLboolean, 4>{ red, green, blue, alpha })) {
+		glColorMask(red, green, blue, alpha);
+	}
+}
+
+void GLState::Invalidate()
+{
+	_program.reset();
+	_vertexArray.reset();
+	_drawFramebuffer.reset();
+	_readFramebuffer.reset();
+	_activeTexture.reset();
+	for (auto &unit : _textures) {
+		unit.clear();
+	}
+	_capabilities.clear();
+	_blendFunc.reset();
+	_depthMask.reset();
+	_depthFunc.reset();
+	_cullFace.reset();
+	_colorMask.reset();
+}
+
+void GLState::BeginFrame()
+{
+	_lastFrame = _frame;
+	_frame = {};
+}
+
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "lazy.hpp"
+#include <array>
+#include <optional>
+#include <unordered_map>
+
+namespace engine
+{
+
+///
+/// Shadow of the GL state the renderer changes the most: the program, the
+/// vertex array, the framebuffers, the texture bound to each unit, and the
+/// blend, depth, cull and colour mask state. Calls that would not change anything are
+/// skipped.
+///
+/// The cache only stays right if every change goes through it, including
+/// the binds done to create objects and the deletions (GL binds 0 in place
+/// of a deleted object that was bound). Invalidate() forgets everything,
+/// e.g. after code that calls GL directly.
+///
+/// LazyGL shaders and meshes bind through it once Init() is called.
+///
+class GLState : public lazy::graphics::StateBinder
+{
+public:
+	static constexpr size_t MaxTextureUnits = 32;
+
+	struct Stats
+	{
+		/// Calls forwarded to GL
+		size_t Issued = 0;
+		/// Calls that matched the current state
+		size_t Skipped = 0;
+	};
+
+private:
+	std::optional<GLuint> _program;
+	std::optional<GLuint> _vertexArray;
+	std::optional<GLuint> _drawFramebuffer;
+	std::optional<GLuint> _readFramebuffer;
+
+	std::optional<GLenum> _activeTexture;
+	/// Texture bound to each target of each unit
+	std::array<std::unordered_map<GLenum, GLuint>, MaxTextureUnits> _textures;
+
+	std::unordered_map<GLenum, bool> _capabilities;
+	std::optional<std::pair<GLenum, GLenum>> _blendFunc;
+	std::optional<GLboolean> _depthMask;
+	std::optional<GLenum> _depthFunc;
+	std::optional<GLenum> _cullFace;
+	std::optional<std::array<GLboolean, 4>> _colorMask;
+
+	Stats _frame;
+	Stats _lastFrame;
+
+	GLState() = default;
+
+	/// Record the new value and count the call, false if it is already set
+	template <typename T>
+	bool Change(std::optional<T> &current, T const &value)
+	{
+		if (current == value) {
+			_frame.Skipped++;
+			return false;
+		}
+
+		current = value;
+		_frame.Issued++;
+
+		return true;
+	}
+
+public:
+	GLState(GLState const &) = delete;
+	void operator=(GLState const &) = delete;
+
+	/// Never destroyed, the destructors of the other singletons delete through it
+	static GLState &Instance()
+	{
+		static GLState *state = new GLState();
+		return *state;
+	}
+
+	/// Route the binds of LazyGL through the cache
+	void Init();
+
+	void UseProgram(GLuint program);
+
+	void BindVertexArray(GLuint vertexArray);
+	void DeleteVertexArray(GLuint vertexArray);
+
+	/// GL_FRAMEBUFFER binds both the draw and the read framebuffer
+	void BindFramebuffer(GLenum target, GLuint framebuffer);
+	void DeleteFramebuffer(GLuint framebuffer);
+
+	/// GL_TEXTURE0 + i
+	void ActiveTexture(GLenum unit);
+	/// Bind to the active unit
+	void BindTexture(GLenum target, GLuint texture);
+	void BindTexture(GLenum unit, GLenum target, GLuint texture);
+	void DeleteTexture(GLuint texture);
+
+	void Enable(GLenum capability);
+	void Disable(GLenum capability);
+	void SetEnabled(GLenum capability, bool enabled);
+
+	void BlendFunc(GLenum source, GLenum destination);
+	void DepthMask(GLboolean mask);
+	void DepthFunc(GLenum func);
+	void CullFace(GLenum mode);
+	void ColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha);
+
+	/// Forget the whole state, the next call of each kind is issued
+	void Invalidate();
+
+	/// Start counting the calls of a new frame
+	void BeginFrame();
+
+	/// Counters of the last complete frame
+	Stats const &GetStats() const { return _lastFrame; }
+
+	void useProgram(GLuint program) override { UseProgram(program); }
+	void bindVertexArray(GLuint vao) override { BindVertexArray(vao); }
+	void deleteVertexArray(GLuint vao) override { DeleteVertexArray(vao); }
+};
+
+}
@@ -0,0 +1,148 @@
+#include "GLStats.hpp"
+
+#ifdef ENGINE_GL_STATS
+
+#include "Logger.hpp"
+
+namespace engine
+{
+
+namespace
+{
+
+size_t GetPrimitives(GLenum mode, GLsizei count)
+{
+	switch (mode) {
+	case GL_POINTS: return count;
+	case GL_LINES: return count / 2;
+	case GL_LINE_STRIP: return count > 1 ? count - 1 : 0;
+	case GL_LINE_LOOP: return count > 1 ? count : 0;
+	case GL_TRIANGLES: return count / 3;
+	case GL_TRIANGLE_STRIP:
+	case GL_TRIANGLE_FAN: return count > 2 ? count - 2 : 0;
+	default: return 0;
+	}
+}
+
+}
+
+auto GLStats::Counters::operator+=(Counters const &other) -> Counters &
+{
+	DrawCalls += other.DrawCalls;
+	Instances += other.Instances;
+	Primitives += other.Primitives;
+	BufferUploads += other.BufferUploads;
+	BytesUploaded += other.BytesUploaded;
+	TextureBinds += other.TextureBinds;
+	ProgramBinds += other.ProgramBinds;
+	FramebufferBinds += other.FramebufferBinds;
+
+	return *this;
+}
+
+size_t GLStats::GetPassIndex(char const *name)
+{
+	auto it = _passIndices.find(name);
+
+	if (it != _passIndices.end()) {
+		return it->second;
+	}
+
+	_frame.push_back({ name, {} });
+	_passIndices[name] = _frame.size() - 1;
+
+	return _frame.size() - 1;
+}
+
+auto GLStats::Current() -> Counters &
+{
+	if (!_active) {
+		return _frame[GetPassIndex(OtherPass)].Counts;
+	}
+
+	return _frame[_active.value()].Counts;
+}
+
+void GLStats::EndFrame()
+{
+	if (_active) { EndPass(); }
+
+	_lastFrame = std::move(_frame);
+	_frame.clear();
+	_passIndices.clear();
+}
+
+void GLStats::BeginPass(char const *name)
+{
+	// Counted in the outer pass, as the GpuProfiler does
+	if (_active) { return ; }
+
+	_active = GetPassIndex(name);
+}
+
+void GLStats::EndPass()
+{
+	_active.reset();
+}
+
+void GLStats::Draw(GLenum mode, GLsizei count, GLsizei instances)
+{
+	auto &counters = Current();
+
+	counters.DrawCalls++;
+	counters.Instances += instances;
+	counters.Primitives += GetPrimitives(mode, count) * instances;
+}
+
+void GLStats::Upload(size_t bytes)
+{
+	auto &counters = Current();
+
+	counters.BufferUploads++;
+	counters.BytesUploaded += bytes;
+}
+
+void GLStats::TextureBind()
+{
+	Current().TextureBinds++;
+}
+
+void GLStats::ProgramBind()
+{
+	Current().ProgramBinds++;
+}
+
+void GLStats::FramebufferBind()
+{
+	Current().FramebufferBinds++;
+}
+
+auto GLStats::GetTotal() const -> Counters
+{
+	Counters total;
+
+	for (auto const &pass : _lastFrame) {
+		total += pass.Counts;
+	}
+
+	return total;
+}
+
+std::string GLStats::GetSummary() const
+{
+	auto total = GetTotal();
+
+	std::string summary = fmt::format("GL {} draws {} prims {:.1f}KB up, binds tex {} prog {} fb {}",
+		total.DrawCalls, total.Primitives, total.BytesUploaded / 1024.0f,
+		total.TextureBinds, total.ProgramBinds, total.FramebufferBinds);
+
+	for (auto const &pass : _lastFrame) {
+		summary += fmt::format(" | {} {}/{}", pass.Name, pass.Counts.DrawCalls, pass.Counts.Primitives);
+	}
+
+	return summary;
+}
+
+}
+
+#endif
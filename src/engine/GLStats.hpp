@@ -0,0 +1,100 @@
+#pragma once
+
+#include "config.h"
+
+#ifdef ENGINE_GL_STATS
+
+#include "lazy.hpp"
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace engine
+{
+
+///
+/// Counts the GL calls of every GpuProfiler pass of a frame: draws and the
+/// primitives they submit, buffer uploads and their size, and the texture,
+/// program and framebuffer binds that reached GL (the ones GLState skipped
+/// are not counted). Calls made outside of a pass are counted in OtherPass.
+///
+/// Only built with the gl_stats option, the GL_STATS() calls compile to
+/// nothing otherwise.
+///
+class GLStats
+{
+public:
+	static constexpr char const *OtherPass = "Other";
+
+	struct Counters
+	{
+		size_t DrawCalls = 0;
+		size_t Instances = 0;
+		size_t Primitives = 0;
+		size_t BufferUploads = 0;
+		size_t BytesUploaded = 0;
+		size_t TextureBinds = 0;
+		size_t ProgramBinds = 0;
+		size_t FramebufferBinds = 0;
+
+		Counters &operator+=(Counters const &other);
+	};
+
+	struct PassStats
+	{
+		std::string Name;
+		Counters Counts;
+	};
+
+private:
+	std::vector<PassStats> _frame;
+	std::vector<PassStats> _lastFrame;
+	std::unordered_map<std::string, size_t> _passIndices;
+	std::optional<size_t> _active;
+
+	GLStats() = default;
+
+	Counters &Current();
+	size_t GetPassIndex(char const *name);
+
+public:
+	GLStats(GLStats const &) = delete;
+	void operator=(GLStats const &) = delete;
+
+	static GLStats &Instance()
+	{
+		static GLStats stats;
+		return stats;
+	}
+
+	/// Keep the counters of the frame that is done and start a new one
+	void EndFrame();
+
+	/// Passes cannot be nested, like the GpuProfiler ones
+	void BeginPass(char const *name);
+	void EndPass();
+
+	void Draw(GLenum mode, GLsizei count, GLsizei instances = 1);
+	void Upload(size_t bytes);
+	void TextureBind();
+	void ProgramBind();
+	void FramebufferBind();
+
+	/// Passes of the last complete frame, in the order they first ran
+	std::vector<PassStats> const &GetPasses() const { return _lastFrame; }
+	Counters GetTotal() const;
+
+	/// Totals of the last frame and draws/primitives of each pass, for the HUD
+	std::string GetSummary() const;
+};
+
+}
+
+#define GL_STATS(call) engine::GLStats::Instance().call
+
+#else
+
+#define GL_STATS(call) ((void)0)
+
+#endif
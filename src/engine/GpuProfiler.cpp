@@ -0,0 +1,184 @@
+#include "GpuProfiler.hpp"
+#include "Logger.hpp"
+#include "GLStats.hpp"
+#include "utils/Settings.hpp"
+#include <algorithm>
+
+namespace engine
+{
+
+// Log the statistics every LogInterval collected frames
+static constexpr size_t LogInterval = 600;
+
+GpuProfiler::GpuProfiler()
+{
+	// Timer queries are core since 3.3, llvmpipe exposes them as well
+	_supported = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+
+	if (!_supported) {
+		Logger::Warn("GL_TIME_ELAPSED queries are not supported, GPU profiling is disabled\n");
+	}
+}
+
+GpuProfiler::~GpuProfiler()
+{
+	for (auto &frame : _frames) {
+		if (!frame.Pool.empty()) {
+			glDeleteQueries(frame.Pool.size(), frame.Pool.data());
+		}
+	}
+}
+
+size_t GpuProfiler::GetPassIndex(char const *name)
+{
+	auto it = _passIndices.find(name);
+
+	if (it != _passIndices.end()) {
+		return it->second;
+	}
+
+	PassStats stats;
+	stats.Name = name;
+
+	_passes.push_back(stats);
+	_passIndices[name] = _passes.size() - 1;
+
+	return _passes.size() - 1;
+}
+
+void GpuProfiler::Record(PassStats &pass, float ms)
+{
+	pass.History[pass.Samples % Window] = ms;
+	pass.Samples++;
+	pass.LastMs = ms;
+
+	size_t count = std::min(pass.Samples, Window);
+	auto begin = pass.History.begin();
+	auto end = pass.History.begin() + count;
+
+	float total = 0.0f;
+	for (auto it = begin; it != end; it++) {
+		total += *it;
+	}
+
+	pass.AverageMs = total / count;
+	pass.MinMs = *std::min_element(begin, end);
+	pass.MaxMs = *std::max_element(begin, end);
+}
+
+void GpuProfiler::Collect(Frame &frame)
+{
+	float frameMs = 0.0f;
+	bool complete = true;
+
+	for (auto const &query : frame.Queries) {
+		GLint available = GL_FALSE;
+
+		glGetQueryObjectiv(query.Id, GL_QUERY_RESULT_AVAILABLE, &available);
+
+		// Never stall: a result that is still not there is dropped
+		if (!available) {
+			_droppedQueries++;
+			complete = false;
+			continue ;
+		}
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(query.Id, GL_QUERY_RESULT, &elapsed);
+
+		float ms = static_cast<float>(elapsed) / 1000000.0f;
+
+		Record(_passes[query.Pass], ms);
+		frameMs += ms;
+	}
+
+	if (!frame.Queries.empty()) {
+		// Passes that no longer run do not count, a frame missing a result is left out
+		if (complete) {
+			Record(_frameStats, frameMs);
+		}
+
+		_collectedFrames++;
+
+		if (_collectedFrames % LogInterval == 0) {
+			Log();
+		}
+	}
+
+	frame.Queries.clear();
+}
+
+void GpuProfiler::BeginFrame()
+{
+	_enabled = _supported && std::any_cast<int>(Settings::instance().get("gpuProfiler"));
+
+	if (_active) {
+		Logger::Warn("GpuProfiler: pass still active at the end of the frame\n");
+		End();
+	}
+
+	_frameIndex++;
+
+	// The queries of this slot were issued FrameLatency frames ago
+	Collect(_frames[_frameIndex % _frames.size()]);
+}
+
+void GpuProfiler::Begin(char const *name)
+{
+	// Counted even when the timings are off
+	GL_STATS(BeginPass(name));
+
+	if (!_enabled) { return ; }
+
+	if (_active) {
+		Logger::Warn("GpuProfiler: {} started while another pass is active\n", name);
+		return ;
+	}
+
+	Frame &frame = _frames[_frameIndex % _frames.size()];
+
+	if (frame.Queries.size() == frame.Pool.size()) {
+		GLuint id;
+		glGenQueries(1, &id);
+		frame.Pool.push_back(id);
+	}
+
+	Query query = { GetPassIndex(name), frame.Pool[frame.Queries.size()] };
+	frame.Queries.push_back(query);
+
+	glBeginQuery(GL_TIME_ELAPSED, query.Id);
+	_active = true;
+}
+
+void GpuProfiler::End()
+{
+	GL_STATS(EndPass());
+
+	if (!_active) { return ; }
+
+	glEndQuery(GL_TIME_ELAPSED);
+	_active = false;
+}
+
+std::string GpuProfiler::GetSummary() const
+{
+	std::string summary = fmt::format("GPU {:.2f}ms", GetFrameMs());
+
+	for (auto const &pass : _passes) {
+		summary += fmt::format(" | {} {:.2f}", pass.Name, pass.AverageMs);
+	}
+
+	return summary;
+}
+
+void GpuProfiler::Log() const
+{
+	Logger::Info("GPU frame: {:.3f}ms average ({} dropped queries)\n", GetFrameMs(), _droppedQueries);
+
+	for (auto const &pass : _passes) {
+		Logger::Info("  {:<12} avg {:.3f}ms min {:.3f}ms max {:.3f}ms last {:.3f}ms\n",
+			pass.Name, pass.AverageMs, pass.MinMs, pass.MaxMs, pass.LastMs);
+	}
+}
+
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "lazy.hpp"
+#include <string>
+#include <vector>
+#include <array>
+#include <unordered_map>
+
+namespace engine
+{
+
+///
+/// Measures the GPU time of render passes with GL_TIME_ELAPSED queries.
+///
+/// Results are read back FrameLatency frames after being issued, without
+/// ever waiting on the GPU. Each pass keeps rolling statistics over the last
+/// Window frames in which it was measured.
+///
+/// Passes cannot be nested (only one GL_TIME_ELAPSED query may be active).
+///
+class GpuProfiler
+{
+public:
+	static constexpr size_t FrameLatency = 3;
+	static constexpr size_t Window = 120;
+
+	struct PassStats
+	{
+		std::string Name;
+
+		float LastMs = 0.0f;
+		float AverageMs = 0.0f;
+		float MinMs = 0.0f;
+		float MaxMs = 0.0f;
+
+		/// Times of the last Window frames, in milliseconds
+		std::array<float, Window> History{};
+		size_t Samples = 0;
+	};
+
+	///
+	/// RAII helper timing the enclosing scope
+	///
+	class Scope
+	{
+	public:
+		Scope(char const *name) { GpuProfiler::Instance().Begin(name); }
+		~Scope() { GpuProfiler::Instance().End(); }
+
+		Scope(Scope const &) = delete;
+		void operator=(Scope const &) = delete;
+	};
+
+private:
+	struct Query
+	{
+		size_t Pass;
+		GLuint Id;
+	};
+
+	struct Frame
+	{
+		std::vector<GLuint> Pool;
+		std::vector<Query> Queries;
+	};
+
+	std::array<Frame, FrameLatency> _frames;
+	size_t _frameIndex = 0;
+
+	std::vector<PassStats> _passes;
+	std::unordered_map<std::string, size_t> _passIndices;
+	/// Sum of the passes measured in each frame
+	PassStats _frameStats;
+
+	bool _supported = false;
+	bool _enabled = false;
+	bool _active = false;
+
+	size_t _collectedFrames = 0;
+	size_t _droppedQueries = 0;
+
+	GpuProfiler();
+	~GpuProfiler();
+
+	size_t GetPassIndex(char const *name);
+	void Collect(Frame &frame);
+	void Record(PassStats &pass, float ms);
+
+public:
+	GpuProfiler(GpuProfiler const &) = delete;
+	void operator=(GpuProfiler const &) = delete;
+
+	static GpuProfiler &Instance()
+	{
+		static GpuProfiler profiler;
+		return profiler;
+	}
+
+	/// Read back the queries of an old frame and start a new one
+	void BeginFrame();
+
+	void Begin(char const *name);
+	void End();
+
+	bool IsEnabled() const { return _enabled; }
+
+	std::vector<PassStats> const &GetStats() const { return _passes; }
+
+	/// Average over the last Window frames of the time of the passes that ran
+	float GetFrameMs() const { return _frameStats.AverageMs; }
+	/// Time of the passes of the last frame read back, 0 before the first one
+	float GetLastFrameMs() const { return _frameStats.LastMs; }
+
+	/// One line summary of every pass, for the HUD
+	std::string GetSummary() const;
+
+	void Log() const;
+};
+
+}
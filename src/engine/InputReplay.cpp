@@ -0,0 +1,121 @@
+#include "InputReplay.hpp"
+#include "Logger.hpp"
+#include "inputs/Input.hpp"
+#include "inputs/Keyboard.hpp"
+#include <fstream>
+#include <sstream>
+
+namespace engine
+{
+
+InputReplay *InputReplay::s_recording = nullptr;
+GLFWkeyfun InputReplay::s_previousCallback = nullptr;
+
+bool InputReplay::Load(std::string const &path)
+{
+	std::ifstream file(path);
+
+	if (!file.is_open()) {
+		Logger::Error("InputReplay: could not open {}\n", path);
+		return false;
+	}
+
+	_events.clear();
+	_next = 0;
+	_frame = 0;
+
+	std::string line;
+	size_t lineNumber = 0;
+
+	while (std::getline(file, line)) {
+		lineNumber++;
+
+		if (line.empty() || line[0] == '#') { continue ; }
+
+		std::istringstream stream(line);
+		Event event;
+		std::string action;
+
+		if (!(stream >> event.Frame >> event.Key >> action) || (action != "press" && action != "release")) {
+			Logger::Error("InputReplay: {}:{}: expected <frame> <key> <press|release>\n", path, lineNumber);
+			return false;
+		}
+
+		event.Action = action == "press" ? GLFW_PRESS : GLFW_RELEASE;
+
+		if (!_events.empty() && event.Frame < _events.back().Frame) {
+			Logger::Error("InputReplay: {}:{}: events are not in frame order\n", path, lineNumber);
+			return false;
+		}
+
+		_events.push_back(event);
+	}
+
+	return true;
+}
+
+bool InputReplay::Save(std::string const &path) const
+{
+	std::ofstream file(path);
+
+	if (!file.is_open()) {
+		Logger::Error("InputReplay: could not write {}\n", path);
+		return false;
+	}
+
+	file << "# <frame> <key> <press|release>\n";
+	for (auto const &event : _events) {
+		file << event.Frame << ' ' << event.Key << ' ' << (event.Action == GLFW_PRESS ? "press" : "release") << '\n';
+	}
+
+	return true;
+}
+
+void InputReplay::RecordCallback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+	// Key repeats do not change the keyboard state
+	if (s_recording != nullptr && action != GLFW_REPEAT) {
+		s_recording->_events.push_back(Event{ s_recording->_frame, key, action });
+	}
+
+	if (s_previousCallback != nullptr) {
+		s_previousCallback(window, key, scancode, action, mods);
+	}
+}
+
+void InputReplay::StartRecording(GLFWwindow *window)
+{
+	_events.clear();
+	_frame = 0;
+
+	s_recording = this;
+	s_previousCallback = glfwSetKeyCallback(window, RecordCallback);
+}
+
+void InputReplay::StopRecording(GLFWwindow *window)
+{
+	if (s_recording != this) { return ; }
+
+	glfwSetKeyCallback(window, s_previousCallback);
+	s_recording = nullptr;
+	s_previousCallback = nullptr;
+}
+
+void InputReplay::DetachLiveInput(GLFWwindow *window)
+{
+	glfwSetKeyCallback(window, nullptr);
+	glfwSetCursorPosCallback(window, nullptr);
+	glfwSetMouseButtonCallback(window, nullptr);
+}
+
+void InputReplay::Apply()
+{
+	auto &keyboard = lazy::inputs::input::getKeyboard();
+
+	while (_next < _events.size() && _events[_next].Frame <= _frame) {
+		keyboard.keyCallback(_events[_next].Key, 0, _events[_next].Action, 0);
+		_next++;
+	}
+}
+
+}
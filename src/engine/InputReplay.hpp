@@ -0,0 +1,58 @@
+#pragma once
+
+#include "lazy.hpp"
+#include <string>
+#include <vector>
+
+namespace engine
+{
+
+///
+/// Records the keyboard events of a run and plays them back frame by frame.
+///
+/// The file holds one event per line: `<frame> <key> <press|release>`,
+/// `key` being a GLFW key code. Events are injected in the keyboard at the
+/// same point of the frame as GLFW would deliver them, so a replay drives
+/// the game exactly like the recorded session did.
+///
+class InputReplay
+{
+public:
+	struct Event
+	{
+		size_t Frame;
+		int Key;
+		int Action;
+	};
+
+private:
+	std::vector<Event> _events;
+	size_t _next = 0;
+	size_t _frame = 0;
+
+	static InputReplay *s_recording;
+	static GLFWkeyfun s_previousCallback;
+
+	static void RecordCallback(GLFWwindow *window, int key, int scancode, int action, int mods);
+
+public:
+	bool Load(std::string const &path);
+	bool Save(std::string const &path) const;
+
+	/// Record the events received by `window` until StopRecording
+	void StartRecording(GLFWwindow *window);
+	void StopRecording(GLFWwindow *window);
+
+	/// Ignore the real keyboard and mouse, only the replayed events remain
+	static void DetachLiveInput(GLFWwindow *window);
+
+	/// Inject the events of the current frame, before the inputs are updated
+	void Apply();
+
+	/// Move to the next frame
+	void EndFrame() { _frame++; }
+
+	size_t GetEventCount() const { return _events.size(); }
+};
+
+}
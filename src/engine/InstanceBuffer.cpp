@@ -0,0 +1,68 @@
+#include "InstanceBuffer.hpp"
+#include "Logger.hpp"
+#include <cstddef>
+#include <cstring>
+
+namespace engine
+{
+
+InstanceBuffer::InstanceBuffer() : _stream(GL_ARRAY_BUFFER, MaxInstances * sizeof(Instance) * 4)
+{
+	// glVertexAttribDivisor is core since 3.3
+	_supported = GLEW_VERSION_3_3 || GLEW_ARB_instanced_arrays;
+	_arb = !GLEW_VERSION_3_3;
+
+	if (!_supported) {
+		Logger::Warn("Instanced arrays are not supported, every mesh is drawn on its own\n");
+	}
+}
+
+void InstanceBuffer::Divisor(GLuint location, GLuint divisor)
+{
+	if (_arb) { glVertexAttribDivisorARB(location, divisor); }
+	else { glVertexAttribDivisor(location, divisor); }
+}
+
+std::optional<GLintptr> InstanceBuffer::Upload(Instance const *instances, size_t count)
+{
+	auto allocation = _stream.Allocate(count * sizeof(Instance), sizeof(GLfloat));
+
+	if (allocation.Data == nullptr) { return std::nullopt; }
+
+	std::memcpy(allocation.Data, instances, allocation.Size);
+	_stream.Commit(allocation);
+
+	return allocation.Offset;
+}
+
+void InstanceBuffer::Attach(GLintptr offset)
+{
+	GLsizei const stride = sizeof(Instance);
+
+	glBindBuffer(GL_ARRAY_BUFFER, _stream.GetBuffer());
+
+	glEnableVertexAttribArray(MaterialLocation);
+	glVertexAttribPointer(MaterialLocation, 1, GL_FLOAT, GL_FALSE, stride,
+		reinterpret_cast<void*>(offset + offsetof(Instance, Material)));
+	Divisor(MaterialLocation, 1);
+
+	for (GLuint column = 0; column < 4; column++) {
+		glEnableVertexAttribArray(ModelLocation + column);
+		glVertexAttribPointer(ModelLocation + column, 4, GL_FLOAT, GL_FALSE, stride,
+			reinterpret_cast<void*>(offset + offsetof(Instance, Model) + column * sizeof(glm::vec4)));
+		Divisor(ModelLocation + column, 1);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::SetCurrent(Instance const &instance)
+{
+	glVertexAttrib1f(MaterialLocation, instance.Material);
+
+	for (GLuint column = 0; column < 4; column++) {
+		glVertexAttrib4fv(ModelLocation + column, glm::value_ptr(instance.Model[column]));
+	}
+}
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "lazy.hpp"
+#include "StreamBuffer.hpp"
+#include <optional>
+
+namespace engine
+{
+
+///
+/// Per instance data of the model shaders (basic.vs and depth.vs), streamed
+/// every frame so that all the instances of a mesh are drawn in one call.
+///
+/// Attach() points the instanced attributes of the bound vertex array at the
+/// instances written by Upload(). Without instanced arrays (GL 3.2 without
+/// ARB_instanced_arrays) nothing is attached: each instance is drawn on its
+/// own with its values set as the current attribute values, like for the
+/// vertex arrays that never had them attached.
+///
+class InstanceBuffer
+{
+public:
+	struct Instance
+	{
+		glm::mat4 Model;
+		/// Index in the Materials block when the material textures are packed
+		GLfloat Material = 0.0f;
+	};
+
+	/// Locations in basic.vs and depth.vs, the model matrix takes four
+	static constexpr GLuint MaterialLocation = 4;
+	static constexpr GLuint ModelLocation = 5;
+
+	/// Most instances drawn in one call
+	static constexpr size_t MaxInstances = 4096;
+
+private:
+	StreamBuffer _stream;
+	bool _supported = false;
+	bool _arb = false;
+
+	void Divisor(GLuint location, GLuint divisor);
+
+public:
+	InstanceBuffer();
+
+	InstanceBuffer(InstanceBuffer const &) = delete;
+	void operator=(InstanceBuffer const &) = delete;
+
+	bool IsSupported() const { return _supported; }
+
+	/// Write at most MaxInstances instances, the offset to Attach() them at
+	std::optional<GLintptr> Upload(Instance const *instances, size_t count);
+
+	/// Point the instanced attributes of the bound vertex array at `offset`
+	void Attach(GLintptr offset);
+
+	/// Values read by a vertex array without instanced attributes
+	static void SetCurrent(Instance const &instance);
+
+	void EndFrame() { _stream.EndFrame(); }
+};
+
+}
@@ -0,0 +1,236 @@
+#include "LightClusters.hpp"
+#include "GLState.hpp"
+#include "GLStats.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace engine {
+
+// Radiance under which a light is considered to not contribute anymore
+static constexpr float LightCutoff = 0.01f;
+
+LightClusters::LightClusters()
+{
+	InitTextureBuffer(_lights, GL_RGBA32F);
+	InitTextureBuffer(_grid, GL_RG32UI);
+	InitTextureBuffer(_indices, GL_R32UI);
+
+	_clusterLights.resize(ClusterCount);
+	_gridData.resize(ClusterCount * 2);
+}
+
+LightClusters::~LightClusters()
+{
+	for (auto *tb : { &_lights, &_grid, &_indices }) {
+		if (tb->Texture) { GLState::Instance().DeleteTexture(tb->Texture); }
+		if (tb->Buffer) { glDeleteBuffers(1, &tb->Buffer); }
+	}
+}
+
+void LightClusters::InitTextureBuffer(TextureBuffer &tb, GLenum format)
+{
+	tb.Format = format;
+
+	glGenBuffers(1, &tb.Buffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, tb.Buffer);
+	glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glGenTextures(1, &tb.Texture);
+	GLState::Instance().BindTexture(GL_TEXTURE_BUFFER, tb.Texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, tb.Format, tb.Buffer);
+	GLState::Instance().BindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusters::Upload(TextureBuffer &tb, void const *data, size_t size)
+{
+	// A texture buffer cannot be empty
+	static GLuint const zero[4] = { 0, 0, 0, 0 };
+
+	if (size == 0) {
+		data = zero;
+		size = sizeof(zero);
+	}
+
+	// Orphan the previous storage so the driver does not wait for the last frame
+	glBindBuffer(GL_TEXTURE_BUFFER, tb.Buffer);
+	glBufferData(GL_TEXTURE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+	GL_STATS(Upload(size));
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+int LightClusters::GetSlice(float depth) const
+{
+	if (depth <= _near) { return 0; }
+
+	int slice = static_cast<int>(std::log(depth / _near) / std::log(_far / _near) * ClusterZ);
+
+	return std::clamp(slice, 0, static_cast<int>(ClusterZ) - 1);
+}
+
+void LightClusters::BuildBounds()
+{
+	// Near and far planes of a standard perspective projection
+	_near = _projection[3][2] / (_projection[2][2] - 1.0f);
+	_far = _projection[3][2] / (_projection[2][2] + 1.0f);
+
+	float const sx = 1.0f / _projection[0][0];
+	float const sy = 1.0f / _projection[1][1];
+
+	for (unsigned int z = 0; z < ClusterZ; z++) {
+		float const dNear = _near * std::pow(_far / _near, static_cast<float>(z) / ClusterZ);
+		float const dFar = _near * std::pow(_far / _near, static_cast<float>(z + 1) / ClusterZ);
+
+		for (unsigned int y = 0; y < ClusterY; y++) {
+			float const y0 = -1.0f + 2.0f * y / ClusterY;
+			float const y1 = -1.0f + 2.0f * (y + 1) / ClusterY;
+
+			for (unsigned int x = 0; x < ClusterX; x++) {
+				float const x0 = -1.0f + 2.0f * x / ClusterX;
+				float const x1 = -1.0f + 2.0f * (x + 1) / ClusterX;
+
+				Aabb &aabb = _bounds[x + y * ClusterX + z * ClusterX * ClusterY];
+				aabb.Min = glm::vec3(std::numeric_limits<float>::max());
+				aabb.Max = glm::vec3(std::numeric_limits<float>::lowest());
+
+				for (float d : { dNear, dFar }) {
+					for (float nx : { x0, x1 }) {
+						for (float ny : { y0, y1 }) {
+							glm::vec3 p(nx * d * sx, ny * d * sy, -d);
+							aabb.Min = glm::min(aabb.Min, p);
+							aabb.Max = glm::max(aabb.Max, p);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+float LightClusters::GetEffectiveRadius(float intensity, float radius)
+{
+	if (radius > 0.0f) { return radius; }
+
+	// Distance at which intensity / d^2 falls under the cutoff
+	return std::sqrt(std::max(intensity, 0.0f) / LightCutoff);
+}
+
+void LightClusters::Update(glm::mat4 const &projection, glm::mat4 const &view,
+	unsigned int width, unsigned int height, std::vector<PointLight> const &lights)
+{
+	_width = width;
+	_height = height;
+
+	if (projection != _projection) {
+		_projection = projection;
+		BuildBounds();
+	}
+
+	float const sx = _projection[0][0];
+	float const sy = _projection[1][1];
+
+	for (auto &cluster : _clusterLights) {
+		cluster.clear();
+	}
+
+	_lightData.clear();
+	_lightData.reserve(lights.size() * 2);
+
+	for (size_t i = 0; i < lights.size(); i++) {
+		auto const &light = lights[i];
+		float const radius = GetEffectiveRadius(light.Intensity, light.Radius);
+
+		_lightData.push_back(glm::vec4(light.Position, radius));
+		_lightData.push_back(glm::vec4(light.Color * light.Intensity, 0.0f));
+
+		glm::vec3 const center = glm::vec3(view * glm::vec4(light.Position, 1.0f));
+
+		float const dMin = std::max(-center.z - radius, _near);
+		float const dMax = std::min(-center.z + radius, _far);
+
+		if (dMin > dMax) { continue ; }
+
+		// Conservative screen-space bounds of the light's view-space AABB
+		float minX = std::numeric_limits<float>::max();
+		float maxX = std::numeric_limits<float>::lowest();
+		float minY = std::numeric_limits<float>::max();
+		float maxY = std::numeric_limits<float>::lowest();
+
+		for (float d : { dMin, dMax }) {
+			for (float offset : { -radius, radius }) {
+				minX = std::min(minX, (center.x + offset) * sx / d);
+				maxX = std::max(maxX, (center.x + offset) * sx / d);
+				minY = std::min(minY, (center.y + offset) * sy / d);
+				maxY = std::max(maxY, (center.y + offset) * sy / d);
+			}
+		}
+
+		if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f) { continue ; }
+
+		auto toTile = [] (float ndc, unsigned int count) {
+			int tile = static_cast<int>((ndc * 0.5f + 0.5f) * count);
+			return std::clamp(tile, 0, static_cast<int>(count) - 1);
+		};
+
+		int const x0 = toTile(minX, ClusterX), x1 = toTile(maxX, ClusterX);
+		int const y0 = toTile(minY, ClusterY), y1 = toTile(maxY, ClusterY);
+		int const z0 = GetSlice(dMin), z1 = GetSlice(dMax);
+
+		float const radius2 = radius * radius;
+
+		for (int z = z0; z <= z1; z++) {
+			for (int y = y0; y <= y1; y++) {
+				for (int x = x0; x <= x1; x++) {
+					size_t const index = x + y * ClusterX + z * ClusterX * ClusterY;
+					Aabb const &aabb = _bounds[index];
+
+					// Sphere / AABB intersection
+					glm::vec3 const closest = glm::clamp(center, aabb.Min, aabb.Max);
+					glm::vec3 const delta = closest - center;
+
+					if (glm::dot(delta, delta) <= radius2) {
+						_clusterLights[index].push_back(static_cast<GLuint>(i));
+					}
+				}
+			}
+		}
+	}
+
+	_indexData.clear();
+
+	for (size_t i = 0; i < ClusterCount; i++) {
+		_gridData[i * 2 + 0] = static_cast<GLuint>(_indexData.size());
+		_gridData[i * 2 + 1] = static_cast<GLuint>(_clusterLights[i].size());
+		_indexData.insert(_indexData.end(), _clusterLights[i].begin(), _clusterLights[i].end());
+	}
+
+	Upload(_lights, _lightData.data(), _lightData.size() * sizeof(glm::vec4));
+	Upload(_grid, _gridData.data(), _gridData.size() * sizeof(GLuint));
+	Upload(_indices, _indexData.data(), _indexData.size() * sizeof(GLuint));
+}
+
+void LightClusters::Bind(lazy::graphics::Shader &shader)
+{
+	shader.setUniform1i("clusterLights", LightsUnit);
+	shader.setUniform1i("clusterGrid", GridUnit);
+	shader.setUniform1i("clusterIndices", IndicesUnit);
+	shader.setUniform3f("clusterDims", glm::vec3(ClusterX, ClusterY, ClusterZ));
+	shader.setUniform4f("clusterParams", glm::vec4(_width, _height, _near, _far));
+
+	GLState::Instance().BindTexture(GL_TEXTURE0 + LightsUnit, GL_TEXTURE_BUFFER, _lights.Texture);
+	GLState::Instance().BindTexture(GL_TEXTURE0 + GridUnit, GL_TEXTURE_BUFFER, _grid.Texture);
+	GLState::Instance().BindTexture(GL_TEXTURE0 + IndicesUnit, GL_TEXTURE_BUFFER, _indices.Texture);
+	GLState::Instance().ActiveTexture(GL_TEXTURE0);
+}
+
+void LightClusters::Unbind()
+{
+	for (GLuint unit : { LightsUnit, GridUnit, IndicesUnit }) {
+		GLState::Instance().BindTexture(GL_TEXTURE0 + unit, GL_TEXTURE_BUFFER, 0);
+	}
+	GLState::Instance().ActiveTexture(GL_TEXTURE0);
+}
+
+}
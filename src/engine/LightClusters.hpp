@@ -0,0 +1,105 @@
+#pragma once
+
+#include "lazy.hpp"
+#include <vector>
+#include <array>
+
+namespace engine {
+
+///
+/// Clustered light assignment.
+///
+/// The view frustum is split into ClusterX * ClusterY screen tiles and
+/// ClusterZ exponential depth slices. Every frame the point lights are binned
+/// on the CPU into the clusters their sphere of influence touches and the
+/// result is uploaded to three texture buffers:
+///   - lights:  2 RGBA32F texels per light (position + radius, color * intensity)
+///   - grid:    1 RG32UI texel per cluster (offset in the index list, light count)
+///   - indices: 1 R32UI texel per (cluster, light) pair
+///
+/// The lighting pass then only iterates over the lights of the pixel's cluster.
+///
+class LightClusters
+{
+public:
+	struct PointLight
+	{
+		glm::vec3 Position;
+		glm::vec3 Color;
+		float Intensity;
+		float Radius;
+	};
+
+	static constexpr unsigned int ClusterX = 16;
+	static constexpr unsigned int ClusterY = 9;
+	static constexpr unsigned int ClusterZ = 24;
+	static constexpr unsigned int ClusterCount = ClusterX * ClusterY * ClusterZ;
+
+	// Texture units used by Bind()
+	static constexpr GLuint LightsUnit = 7;
+	static constexpr GLuint GridUnit = 8;
+	static constexpr GLuint IndicesUnit = 9;
+
+private:
+	struct Aabb
+	{
+		glm::vec3 Min;
+		glm::vec3 Max;
+	};
+
+	struct TextureBuffer
+	{
+		GLuint Buffer = 0;
+		GLuint Texture = 0;
+		GLenum Format = GL_R32UI;
+	};
+
+	TextureBuffer _lights;
+	TextureBuffer _grid;
+	TextureBuffer _indices;
+
+	// View-space bounds of every cluster, rebuilt when the projection changes
+	std::array<Aabb, ClusterCount> _bounds;
+	glm::mat4 _projection{0.0f};
+	float _near = 0.1f;
+	float _far = 1.0f;
+
+	// Scratch storage, kept between frames to avoid reallocating
+	std::vector<glm::vec4> _lightData;
+	std::vector<std::vector<GLuint>> _clusterLights;
+	std::vector<GLuint> _gridData;
+	std::vector<GLuint> _indexData;
+
+	unsigned int _width = 0;
+	unsigned int _height = 0;
+
+	void InitTextureBuffer(TextureBuffer &tb, GLenum format);
+	void Upload(TextureBuffer &tb, void const *data, size_t size);
+	void BuildBounds();
+
+	/// Depth slice containing a view-space depth (positive distance)
+	int GetSlice(float depth) const;
+
+public:
+	LightClusters();
+	~LightClusters();
+
+	LightClusters(LightClusters const &) = delete;
+	void operator=(LightClusters const &) = delete;
+
+	///
+	/// Bin the lights for the current camera and upload the cluster data.
+	/// `width` and `height` are the size of the lighting pass viewport.
+	///
+	void Update(glm::mat4 const &projection, glm::mat4 const &view,
+		unsigned int width, unsigned int height, std::vector<PointLight> const &lights);
+
+	/// Set the cluster uniforms of `shader` and bind the texture buffers
+	void Bind(lazy::graphics::Shader &shader);
+	void Unbind();
+
+	/// Radius used for lights without an explicit one
+	static float GetEffectiveRadius(float intensity, float radius);
+};
+
+}
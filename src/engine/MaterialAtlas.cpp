@@ -0,0 +1,219 @@
+#include "MaterialAtlas.hpp"
+#include "TextureManager.hpp"
+#include "Logger.hpp"
+#include "GLState.hpp"
+#include "GLStats.hpp"
+#include <algorithm>
+
+namespace engine
+{
+
+MaterialAtlas::~MaterialAtlas()
+{
+	Clear();
+}
+
+void MaterialAtlas::Clear()
+{
+	for (auto const &bucket : _buckets) {
+		for (auto array : bucket.Arrays) {
+			if (array) { GLState::Instance().DeleteTexture(array); }
+		}
+	}
+
+	if (_uniformBuffer) {
+		glDeleteBuffers(1, &_uniformBuffer);
+		_uniformBuffer = 0;
+	}
+
+	_buckets.clear();
+	_entries.clear();
+}
+
+GLuint MaterialAtlas::CreateArray(Bucket const &bucket, Role role)
+{
+	auto const &layers = bucket.Layers[role];
+
+	if (layers.empty()) { return 0; }
+
+	GLuint array;
+	GLenum internalFormat = role == Albedo ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+
+	glGenTextures(1, &array);
+	GLState::Instance().BindTexture(GL_TEXTURE_2D_ARRAY, array);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, internalFormat, bucket.Width, bucket.Height, layers.size(), 0,
+		GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+	// Blit the level 0 of the loaded textures into the layers instead of
+	// decoding the files again. The formats may differ (RGB textures), a blit
+	// converts them; without GL_FRAMEBUFFER_SRGB sRGB values are copied as
+	// they are.
+	GLuint framebuffers[2];
+
+	GLState::Instance().Disable(GL_FRAMEBUFFER_SRGB);
+
+	glGenFramebuffers(2, framebuffers);
+	GLState::Instance().BindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+	GLState::Instance().BindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+
+	for (auto const &[name, layer] : layers) {
+		auto texture = TextureManager::instance().find(name);
+
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture->id(), 0);
+		glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, array, 0, layer);
+
+		if (glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE ||
+			glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			Logger::Warn("MaterialAtlas: could not copy {}\n", name);
+			continue ;
+		}
+
+		glBlitFramebuffer(0, 0, bucket.Width, bucket.Height, 0, 0, bucket.Width, bucket.Height,
+			GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	}
+
+	GLState::Instance().BindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLState::Instance().DeleteFramebuffer(framebuffers[0]);
+	GLState::Instance().DeleteFramebuffer(framebuffers[1]);
+
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	GLState::Instance().BindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	return array;
+}
+
+void MaterialAtlas::Build(std::unordered_map<std::string, PbrMaterial> const &materials)
+{
+	Clear();
+
+	std::vector<MaterialData> data;
+
+	for (auto const &[name, material] : materials) {
+
+		if (data.size() == MaxMaterials) {
+			Logger::Warn("MaterialAtlas: more than {} materials, the others use individual textures\n", MaxMaterials);
+			break ;
+		}
+
+		std::array<std::optional<std::string>, RoleCount> textures = {
+			material.Albedo, material.Normal, material.MetallicRoughness
+		};
+
+		// Every texture of the material must have the same size
+		int width = 0;
+		int height = 0;
+		bool packable = true;
+
+		for (auto const &texture : textures) {
+			if (!texture.has_value()) { continue ; }
+
+			auto loaded = TextureManager::instance().find(texture.value());
+
+			// Not loaded, or loaded in a format that cannot be blitted
+			if (loaded == nullptr || loaded->width() == 0 || loaded->nChannel() < 3) {
+				packable = false;
+				break ;
+			}
+
+			int w = loaded->width();
+			int h = loaded->height();
+
+			if (width == 0) {
+				width = w;
+				height = h;
+			}
+			else if (w != width || h != height) {
+				packable = false;
+				break ;
+			}
+		}
+
+		if (!packable) { continue ; }
+
+		auto bucket = std::find_if(_buckets.begin(), _buckets.end(),
+			[&] (Bucket const &b) { return b.Width == width && b.Height == height; });
+
+		if (bucket == _buckets.end()) {
+			_buckets.push_back(Bucket{ width, height, {}, {} });
+			bucket = _buckets.end() - 1;
+		}
+
+		MaterialData materialData = {
+			material.BaseColor,
+			glm::vec4(material.MetallicFactor, material.RoughnessFactor, 0.0f, 0.0f),
+			{ -1, -1, -1, 0 }
+		};
+
+		for (int role = 0; role < RoleCount; role++) {
+			if (!textures[role].has_value()) { continue ; }
+
+			auto &layers = bucket->Layers[role];
+			auto layer = layers.emplace(textures[role].value(), static_cast<GLint>(layers.size())).first;
+
+			materialData.Layers[role] = layer->second;
+		}
+
+		_entries[name] = Entry{ static_cast<size_t>(bucket - _buckets.begin()), static_cast<GLint>(data.size()) };
+		data.push_back(materialData);
+	}
+
+	for (auto &bucket : _buckets) {
+		for (int role = 0; role < RoleCount; role++) {
+			bucket.Arrays[role] = CreateArray(bucket, static_cast<Role>(role));
+		}
+	}
+
+	glGenBuffers(1, &_uniformBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, _uniformBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, MaxMaterials * sizeof(MaterialData), nullptr, GL_STATIC_DRAW);
+	if (!data.empty()) {
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, data.size() * sizeof(MaterialData), data.data());
+		GL_STATS(Upload(data.size() * sizeof(MaterialData)));
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	Logger::Info("MaterialAtlas: {} of {} materials packed in {} buckets\n", _entries.size(), materials.size(), _buckets.size());
+}
+
+std::optional<MaterialAtlas::Entry> MaterialAtlas::Find(std::string const &material) const
+{
+	auto entry = _entries.find(material);
+
+	if (entry == _entries.end()) { return std::nullopt; }
+
+	return entry->second;
+}
+
+void MaterialAtlas::BindBucket(size_t bucket) const
+{
+	auto const &arrays = _buckets[bucket].Arrays;
+
+	GLState::Instance().BindTexture(GL_TEXTURE0 + AlbedoUnit, GL_TEXTURE_2D_ARRAY, arrays[Albedo]);
+	GLState::Instance().BindTexture(GL_TEXTURE0 + NormalUnit, GL_TEXTURE_2D_ARRAY, arrays[Normal]);
+	GLState::Instance().BindTexture(GL_TEXTURE0 + MetallicRoughnessUnit, GL_TEXTURE_2D_ARRAY, arrays[MetallicRoughness]);
+	GLState::Instance().ActiveTexture(GL_TEXTURE0);
+}
+
+void MaterialAtlas::BindUniformBlock(lazy::graphics::Shader &shader) const
+{
+	GLuint index = glGetUniformBlockIndex(shader.getProgram(), "Materials");
+
+	if (index == GL_INVALID_INDEX) { return ; }
+
+	glUniformBlockBinding(shader.getProgram(), index, UniformBinding);
+	glBindBufferBase(GL_UNIFORM_BUFFER, UniformBinding, _uniformBuffer);
+}
+
+void MaterialAtlas::Unbind() const
+{
+	for (auto unit : { AlbedoUnit, NormalUnit, MetallicRoughnessUnit }) {
+		GLState::Instance().BindTexture(GL_TEXTURE0 + unit, GL_TEXTURE_2D_ARRAY, 0);
+	}
+	GLState::Instance().ActiveTexture(GL_TEXTURE0);
+}
+
+}
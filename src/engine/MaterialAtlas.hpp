@@ -0,0 +1,97 @@
+#pragma once
+
+#include "lazy.hpp"
+#include "Material.hpp"
+#include <array>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace engine
+{
+
+///
+/// Packs the textures of the PBR materials into GL_TEXTURE_2D_ARRAYs and
+/// their parameters into a uniform buffer.
+///
+/// Materials whose textures all have the same size go in the bucket of that
+/// size, which holds one array per texture role (albedo, normal and
+/// metallic-roughness). Every material of a bucket is drawn with the same
+/// texture bindings, it is selected in the shader by its index in the
+/// Materials uniform block. Materials mixing texture sizes are left out and
+/// keep using their individual textures.
+///
+class MaterialAtlas
+{
+public:
+	static constexpr size_t MaxMaterials = 256;
+
+	/// Texture units of the arrays, after the units of the individual textures
+	static constexpr GLuint AlbedoUnit = 3;
+	static constexpr GLuint NormalUnit = 4;
+	static constexpr GLuint MetallicRoughnessUnit = 5;
+
+	/// Binding point of the Materials uniform block
+	static constexpr GLuint UniformBinding = 0;
+
+	struct Entry
+	{
+		size_t Bucket;
+		GLint Index;
+	};
+
+private:
+	enum Role { Albedo = 0, Normal, MetallicRoughness, RoleCount };
+
+	struct Bucket
+	{
+		int Width;
+		int Height;
+		std::array<GLuint, RoleCount> Arrays{};
+		std::array<std::map<std::string, GLint>, RoleCount> Layers;
+	};
+
+	// std140 layout of an element of the Materials block
+	struct MaterialData
+	{
+		glm::vec4 BaseColor;
+		/// x: metallic factor, y: roughness factor
+		glm::vec4 Factors;
+		/// Layers of the albedo, normal and metallic-roughness textures, -1 if absent
+		GLint Layers[4];
+	};
+
+	std::vector<Bucket> _buckets;
+	std::unordered_map<std::string, Entry> _entries;
+	GLuint _uniformBuffer = 0;
+
+	void Clear();
+	GLuint CreateArray(Bucket const &bucket, Role role);
+
+public:
+	MaterialAtlas() = default;
+	~MaterialAtlas();
+
+	MaterialAtlas(MaterialAtlas const &) = delete;
+	void operator=(MaterialAtlas const &) = delete;
+
+	/// Copy the textures of every material, loaded by the TextureManager, into arrays
+	void Build(std::unordered_map<std::string, PbrMaterial> const &materials);
+
+	std::optional<Entry> Find(std::string const &material) const;
+
+	/// Bind the arrays of a bucket to their texture units
+	void BindBucket(size_t bucket) const;
+
+	/// Connect the Materials block of `shader` to the material buffer
+	void BindUniformBlock(lazy::graphics::Shader &shader) const;
+
+	void Unbind() const;
+
+	size_t GetMaterialCount() const { return _entries.size(); }
+	size_t GetBucketCount() const { return _buckets.size(); }
+};
+
+}
@@ -1,9 +1,32 @@
 #include "Mesh.hpp"
 #include <fmt/format.h>
 #include "TextureManager.hpp"
+#include "MeshSimplifier.hpp"
+#include "Logger.hpp"
+#include "GLState.hpp"
+#include "GLStats.hpp"
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <cstring>
+#include <limits>
 
 namespace engine
 {
+	///
+	/// Pack a vector in [-1, 1] for GL_INT_2_10_10_10_REV. The w component
+	/// only holds a sign: -2 and 1 decode to -1 and 1 with both the GL 3.x and
+	/// the GL 4.2 signed normalized conversion rules.
+	///
+	static GLuint PackSigned1010102(glm::vec4 const &v)
+	{
+		auto pack10 = [] (float f) {
+			return static_cast<GLuint>(static_cast<GLint>(std::round(std::clamp(f, -1.0f, 1.0f) * 511.0f))) & 0x3ff;
+		};
+		GLuint w = v.w < 0.0f ? 0x2 : 0x1;
+
+		return pack10(v.x) | (pack10(v.y) << 10) | (pack10(v.z) << 20) | (w << 30);
+	}
+
 	Mesh::Mesh() : vao(0), ibo(0), objectBuffer(0)
 	{
 		addTexture("prototype_tile_8", TextureType::TT_Diffuse);
@@ -13,7 +36,7 @@ namespace engine
 	{
 		if (ibo > 0) { glDeleteBuffers(1, &ibo); }
 		if (objectBuffer > 0) { glDeleteBuffers(1, &objectBuffer); }
-		if (vao > 0) { glDeleteVertexArrays(1, &vao); }
+		if (vao > 0) { GLState::Instance().DeleteVertexArray(vao); }
 	}
 
 	Mesh::Mesh(Mesh &&m)
@@ -24,6 +47,15 @@ namespace engine
 		vTangents = std::move(m.vTangents);
 		indices = std::move(m.indices);
 		textures = std::move(m.textures);
+		lodIndices = std::move(m.lodIndices);
+		lods = std::move(m.lods);
+		boundsCenter = m.boundsCenter;
+		boundsExtent = m.boundsExtent;
+		boundsRadius = m.boundsRadius;
+		quantized = m.quantized;
+		positionScale = m.positionScale;
+		positionOffset = m.positionOffset;
+		indexType = m.indexType;
 		_material = std::move(m._material);
 
 		vao = m.vao;
@@ -44,7 +76,7 @@ namespace engine
 		{
 			if (ibo != 0) { glDeleteBuffers(1, &ibo); }
 			if (objectBuffer != 0) { glDeleteBuffers(1, &objectBuffer); }
-			if (vao != 0) { glDeleteVertexArrays(1, &vao); }
+			if (vao != 0) { GLState::Instance().DeleteVertexArray(vao); }
 
 			vPositions = std::move(rhs.vPositions);
 			vNormals = std::move(rhs.vNormals);
@@ -52,6 +84,15 @@ namespace engine
 			vTangents = std::move(rhs.vTangents);
 			indices = std::move(rhs.indices);
 			textures = std::move(rhs.textures);
+			lodIndices = std::move(rhs.lodIndices);
+			lods = std::move(rhs.lods);
+			boundsCenter = rhs.boundsCenter;
+			boundsExtent = rhs.boundsExtent;
+			boundsRadius = rhs.boundsRadius;
+			quantized = rhs.quantized;
+			positionScale = rhs.positionScale;
+			positionOffset = rhs.positionOffset;
+			indexType = rhs.indexType;
 			_material = std::move(rhs._material);
 
 			vao = rhs.vao;
@@ -131,61 +172,276 @@ namespace engine
 		return textures;
 	}
 
+	std::pair<MeshOptimizer::Statistics, MeshOptimizer::Statistics> Mesh::optimize(bool overdraw)
+	{
+		size_t const vertexCount = vPositions.size() / 3;
+
+		auto before = MeshOptimizer::AnalyzeVertexCache(indices, vertexCount);
+
+		indices = MeshOptimizer::OptimizeVertexCache(indices, vertexCount);
+		if (overdraw) {
+			indices = MeshOptimizer::OptimizeOverdraw(indices, vPositions);
+		}
+
+		auto remap = MeshOptimizer::OptimizeVertexFetch(indices, vertexCount);
+
+		auto remapAttribute = [&] (std::vector<GLfloat> &attribute, size_t components) {
+			if (attribute.size() < vertexCount * components) { return ; }
+
+			std::vector<GLfloat> reordered(attribute.size());
+
+			for (size_t v = 0; v < vertexCount; v++) {
+				std::copy_n(&attribute[v * components], components, &reordered[remap[v] * components]);
+			}
+			attribute = std::move(reordered);
+		};
+
+		remapAttribute(vPositions, 3);
+		remapAttribute(vNormals, 3);
+		remapAttribute(vUvs, 2);
+		remapAttribute(vTangents, 4);
+
+		for (auto &index : indices) {
+			index = remap[index];
+		}
+
+		return { before, MeshOptimizer::AnalyzeVertexCache(indices, vertexCount) };
+	}
+
+	Mesh &Mesh::generateLods(size_t maxLods)
+	{
+		// Past this error a level is not worth drawing even for distant meshes
+		static constexpr float MaxLodError = 0.25f;
+
+		lodIndices.clear();
+		lods.clear();
+
+		// The first level is the full mesh
+		lods.push_back({ 0, static_cast<GLsizei>(indices.size()), 0.0f });
+
+		std::vector<GLuint> previous = indices;
+		float error = 0.0f;
+
+		for (size_t i = 0; i < maxLods; i++) {
+			auto simplified = MeshSimplifier::Simplify(vPositions, previous, previous.size() / 2, MaxLodError - error);
+
+			// Stop when the simplifier is stuck on locked vertices
+			if (simplified.Indices.empty() || simplified.Indices.size() > previous.size() * 9 / 10) {
+				break ;
+			}
+
+			error += simplified.Error;
+			simplified.Indices = MeshOptimizer::OptimizeVertexCache(simplified.Indices, vPositions.size() / 3);
+
+			lods.push_back({ indices.size() + lodIndices.size(), static_cast<GLsizei>(simplified.Indices.size()), error });
+			lodIndices.insert(lodIndices.end(), simplified.Indices.begin(), simplified.Indices.end());
+
+			previous = std::move(simplified.Indices);
+		}
+
+		if (lods.size() > 1) {
+			Logger::Info("Generated {} LODs: {} to {} triangles\n", lods.size() - 1,
+				indices.size() / 3, lods.back().count / 3);
+		}
+
+		return *this;
+	}
+
+	Mesh &Mesh::quantizePositions(bool enable)
+	{
+		quantized = enable;
+
+		return *this;
+	}
+
 	Mesh &Mesh::build()
 	{
-		glGenVertexArrays(1, &vao);
-		glBindVertexArray(vao);
+		size_t const vertexCount = vPositions.size() / 3;
 
-		glEnableVertexAttribArray(0);
-		glEnableVertexAttribArray(1);
-		glEnableVertexAttribArray(2);
-		glEnableVertexAttribArray(3);
+		// Bounds, used for the bounding sphere and to quantize the positions
+		glm::vec3 min(0.0f);
+		glm::vec3 max(0.0f);
+
+		if (vertexCount > 0) {
+			min = max = glm::vec3(vPositions[0], vPositions[1], vPositions[2]);
+
+			for (size_t i = 0; i < vertexCount; i++) {
+				glm::vec3 p(vPositions[i * 3 + 0], vPositions[i * 3 + 1], vPositions[i * 3 + 2]);
+				min = glm::min(min, p);
+				max = glm::max(max, p);
+			}
+		}
+
+		// Bounding sphere around the AABB, the same one the simplifier measures errors with
+		boundsCenter = (min + max) * 0.5f;
+		boundsExtent = (max - min) * 0.5f;
+		boundsRadius = glm::length(max - min) * 0.5f;
+
+		// Half floats are precise to a texel of a 1024 texture up to 2.0
+		bool halfUvs = std::all_of(vUvs.begin(), vUvs.end(), [] (GLfloat uv) { return std::abs(uv) <= 2.0f; });
+
+		// Layout of the interleaved vertex, 20 bytes when fully compressed (48 as floats):
+		// quantized positions 8 (padded to 4 shorts), normal 4, half float uvs 4, tangent 4
+		size_t const positionSize = quantized ? 4 * sizeof(GLshort) : 3 * sizeof(GLfloat);
+		size_t const normalSize = vNormals.empty() ? 0 : sizeof(GLuint);
+		size_t const uvSize = vUvs.empty() ? 0 : (halfUvs ? 2 * sizeof(GLushort) : 2 * sizeof(GLfloat));
+		size_t const tangentSize = vTangents.empty() ? 0 : sizeof(GLuint);
+
+		size_t const normalOffset = positionSize;
+		size_t const uvOffset = normalOffset + normalSize;
+		size_t const tangentOffset = uvOffset + uvSize;
+		size_t const stride = tangentOffset + tangentSize;
+
+		glm::vec3 const halfExtent = glm::max((max - min) * 0.5f, glm::vec3(std::numeric_limits<float>::min()));
+
+		if (quantized) {
+			positionScale = halfExtent / 32767.0f;
+			positionOffset = boundsCenter;
+		}
+		else {
+			positionScale = glm::vec3(1.0f);
+			positionOffset = glm::vec3(0.0f);
+		}
 
-		const size_t bufferSize = (vPositions.size()
-								  + vNormals.size()
-								  + vUvs.size()
-								  + vTangents.size()) * sizeof(GLfloat);
-		size_t offset = 0;
+		std::vector<uint8_t> vertices(stride * vertexCount);
+
+		for (size_t i = 0; i < vertexCount; i++) {
+			uint8_t *vertex = &vertices[i * stride];
+
+			if (quantized) {
+				glm::vec3 p(vPositions[i * 3 + 0], vPositions[i * 3 + 1], vPositions[i * 3 + 2]);
+				glm::vec3 q = glm::round(glm::clamp((p - boundsCenter) / halfExtent, -1.0f, 1.0f) * 32767.0f);
+				GLshort position[4] = { static_cast<GLshort>(q.x), static_cast<GLshort>(q.y), static_cast<GLshort>(q.z), 0 };
+
+				std::memcpy(vertex, position, sizeof(position));
+			}
+			else {
+				std::memcpy(vertex, &vPositions[i * 3], positionSize);
+			}
+
+			if (normalSize && i * 3 + 2 < vNormals.size()) {
+				GLuint normal = PackSigned1010102(glm::vec4(vNormals[i * 3 + 0], vNormals[i * 3 + 1], vNormals[i * 3 + 2], 0.0f));
+				std::memcpy(vertex + normalOffset, &normal, sizeof(normal));
+			}
+
+			if (uvSize && i * 2 + 1 < vUvs.size()) {
+				if (halfUvs) {
+					GLushort uv[2] = { glm::packHalf1x16(vUvs[i * 2 + 0]), glm::packHalf1x16(vUvs[i * 2 + 1]) };
+					std::memcpy(vertex + uvOffset, uv, sizeof(uv));
+				}
+				else {
+					std::memcpy(vertex + uvOffset, &vUvs[i * 2], uvSize);
+				}
+			}
+
+			if (tangentSize && i * 4 + 3 < vTangents.size()) {
+				GLuint tangent = PackSigned1010102(glm::vec4(vTangents[i * 4 + 0], vTangents[i * 4 + 1],
+					vTangents[i * 4 + 2], vTangents[i * 4 + 3]));
+				std::memcpy(vertex + tangentOffset, &tangent, sizeof(tangent));
+			}
+		}
+
+		glGenVertexArrays(1, &vao);
+		GLState::Instance().BindVertexArray(vao);
 
 		glGenBuffers(1, &objectBuffer);
 		glBindBuffer(GL_ARRAY_BUFFER, objectBuffer);
-		glBufferData(GL_ARRAY_BUFFER, bufferSize, nullptr, GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size(), vertices.data(), GL_STATIC_DRAW);
+		GL_STATS(Upload(vertices.size()));
 
-		if (vPositions.size() > 0) {
-			glBufferSubData(GL_ARRAY_BUFFER, offset, vPositions.size() * sizeof(GLfloat), vPositions.data());
-			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), reinterpret_cast<void*>(offset));
-			offset += vPositions.size() * sizeof(GLfloat);
+		// Quantized positions are decoded in the vertex shader with positionScale and positionOffset
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, quantized ? GL_SHORT : GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(0));
+
+		if (normalSize) {
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, reinterpret_cast<void*>(normalOffset));
 		}
-		if (vNormals.size() > 0) {
-			glBufferSubData(GL_ARRAY_BUFFER, offset, vNormals.size() * sizeof(GLfloat), vNormals.data());
-			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), reinterpret_cast<void*>(offset));
-			offset += vNormals.size() * sizeof(GLfloat);
+		if (uvSize) {
+			glEnableVertexAttribArray(2);
+			glVertexAttribPointer(2, 2, halfUvs ? GL_HALF_FLOAT : GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(uvOffset));
 		}
-		if (vUvs.size() > 0) {
-			glBufferSubData(GL_ARRAY_BUFFER, offset, vUvs.size() * sizeof(GLfloat), vUvs.data());
-			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), reinterpret_cast<void*>(offset));
-			offset += vUvs.size() * sizeof(GLfloat);
+		if (tangentSize) {
+			glEnableVertexAttribArray(3);
+			glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, reinterpret_cast<void*>(tangentOffset));
 		}
-		if (vTangents.size() > 0) {
-			glBufferSubData(GL_ARRAY_BUFFER, offset, vTangents.size() * sizeof(GLfloat), vTangents.data());
-			glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), reinterpret_cast<void*>(offset));
-			offset += vTangents.size() * sizeof(GLfloat);
+
+		if (lods.empty()) {
+			lods.push_back({ 0, static_cast<GLsizei>(indices.size()), 0.0f });
 		}
 
+		// Every level of detail lives in the same index buffer, 16 bits wide when possible
+		std::vector<GLuint> allIndices(indices);
+		allIndices.insert(allIndices.end(), lodIndices.begin(), lodIndices.end());
+
 		glGenBuffers(1, &ibo);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indices.size(), &indices[0], GL_STATIC_DRAW);
 
-		glBindVertexArray(0);
+		if (vertexCount <= std::numeric_limits<GLushort>::max() + 1) {
+			std::vector<GLushort> shortIndices(allIndices.begin(), allIndices.end());
+
+			indexType = GL_UNSIGNED_SHORT;
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * shortIndices.size(), shortIndices.data(), GL_STATIC_DRAW);
+			GL_STATS(Upload(sizeof(GLushort) * shortIndices.size()));
+		}
+		else {
+			indexType = GL_UNSIGNED_INT;
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * allIndices.size(), allIndices.data(), GL_STATIC_DRAW);
+			GL_STATS(Upload(sizeof(GLuint) * allIndices.size()));
+		}
+
+		GLState::Instance().BindVertexArray(0);
 
 		return *this;
 	}
 
 	void Mesh::Draw() const
 	{
-		glBindVertexArray(vao);
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, nullptr);
-		glBindVertexArray(0);
+		GLState::Instance().BindVertexArray(vao);
+		glDrawElements(GL_TRIANGLES, indices.size(), indexType, nullptr);
+		GL_STATS(Draw(GL_TRIANGLES, indices.size()));
+	}
+
+	void Mesh::DrawLod(size_t lod) const
+	{
+		if (lod >= lods.size()) { return Draw(); }
+
+		size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+
+		GLState::Instance().BindVertexArray(vao);
+		glDrawElements(GL_TRIANGLES, lods[lod].count, indexType,
+			reinterpret_cast<void*>(lods[lod].first * indexSize));
+		GL_STATS(Draw(GL_TRIANGLES, lods[lod].count));
+	}
+
+	void Mesh::DrawLodInstanced(size_t lod, GLsizei instances) const
+	{
+		size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+		// Same ranges as DrawLod()
+		size_t first = lod < lods.size() ? lods[lod].first : 0;
+		GLsizei count = lod < lods.size() ? lods[lod].count : static_cast<GLsizei>(indices.size());
+
+		GLState::Instance().BindVertexArray(vao);
+		glDrawElementsInstanced(GL_TRIANGLES, count, indexType,
+			reinterpret_cast<void*>(first * indexSize), instances);
+		GL_STATS(Draw(GL_TRIANGLES, count, instances));
+	}
+
+	void Mesh::Bind() const
+	{
+		GLState::Instance().BindVertexArray(vao);
+	}
+
+	size_t Mesh::SelectLod(float projectedRadius, float maxPixelError) const
+	{
+		size_t lod = 0;
+
+		for (size_t i = 1; i < lods.size(); i++) {
+			if (lods[i].error * projectedRadius > maxPixelError) { break ; }
+			lod = i;
+		}
+
+		return lod;
 	}
 
 	std::vector<GLuint> const Mesh::GetTextureIDs() const
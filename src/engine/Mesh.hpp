@@ -4,6 +4,7 @@
 #include <vector>
 #include "IDrawable.hpp"
 #include "Material.hpp"
+#include "MeshOptimizer.hpp"
 
 namespace engine
 {
@@ -22,6 +23,14 @@ public:
 		TextureType type;
 	};
 
+	/// Range of the index buffer holding one level of detail
+	struct Lod {
+		size_t first;
+		GLsizei count;
+		/// Geometric error of the level, relative to the mesh radius
+		float error;
+	};
+
 private:
 	std::vector<GLfloat> vPositions;
 	std::vector<GLfloat> vNormals;
@@ -30,6 +39,21 @@ private:
 	std::vector<GLuint> indices;
 	std::vector<Texture> textures;
 
+	// Indices of the simplified levels, stored after `indices` in the index buffer
+	std::vector<GLuint> lodIndices;
+	std::vector<Lod> lods;
+
+	glm::vec3 boundsCenter{0.0f};
+	glm::vec3 boundsExtent{0.0f};
+	float boundsRadius = 0.0f;
+
+	// Positions stored as 16 bits integers in the bounding box, see quantizePositions()
+	bool quantized = false;
+	glm::vec3 positionScale{1.0f};
+	glm::vec3 positionOffset{0.0f};
+
+	GLenum indexType = GL_UNSIGNED_INT;
+
 	GLuint vao;
 	GLuint ibo;
 	GLuint objectBuffer;
@@ -64,11 +88,59 @@ public:
 	std::string GetMaterial() const { return _material; }
 
 	void SetPbrMaterial(std::string name) { _pbrMaterial = name; }
-	std::optional<std::string> GetPbrMaterial() { return _pbrMaterial; }
-
+	std::optional<std::string> GetPbrMaterial() const { return _pbrMaterial; }
+
+	///
+	/// Reorder triangles for the vertex cache (and for overdraw if `overdraw`
+	/// is set) then vertices for fetch locality. Must be called before
+	/// generateLods() and build(). Returns the cache statistics before and after.
+	///
+	std::pair<MeshOptimizer::Statistics, MeshOptimizer::Statistics> optimize(bool overdraw = true);
+
+	///
+	/// Generate up to `maxLods` simplified index buffers, each with about half
+	/// the triangles of the previous one. Must be called before build().
+	///
+	Mesh &generateLods(size_t maxLods = 3);
+
+	///
+	/// Store positions as 16 bits integers relative to the bounding box.
+	/// The shader must decode them with GetPositionScale() and GetPositionOffset().
+	///
+	Mesh &quantizePositions(bool enable = true);
+
+	///
+	/// Upload the mesh as interleaved vertices: positions (float or quantized),
+	/// normals and tangents packed in 2_10_10_10, uvs in half floats when they
+	/// fit, and 16 bits indices when there are few enough vertices
+	///
 	Mesh &build();
 
 	void Draw() const override;
+	void DrawLod(size_t lod) const;
+	/// Attributes of the instances must be attached to the vertex array, see Bind()
+	void DrawLodInstanced(size_t lod, GLsizei instances) const;
+
+	/// Bind the vertex array, e.g. to attach instanced attributes to it
+	void Bind() const;
+
+	size_t GetLodCount() const { return lods.size(); }
+	Lod const &GetLod(size_t lod) const { return lods[lod]; }
+
+	///
+	/// Coarsest level whose error stays under `maxPixelError` pixels when the
+	/// mesh bounding sphere covers `projectedRadius` pixels on screen
+	///
+	size_t SelectLod(float projectedRadius, float maxPixelError) const;
+
+	/// Bounding box (center and half size) and sphere in model space
+	glm::vec3 const &GetBoundsCenter() const { return boundsCenter; }
+	glm::vec3 const &GetBoundsExtent() const { return boundsExtent; }
+	float GetBoundsRadius() const { return boundsRadius; }
+
+	/// Model space position = in_position * scale + offset
+	glm::vec3 const &GetPositionScale() const { return positionScale; }
+	glm::vec3 const &GetPositionOffset() const { return positionOffset; }
 	std::vector<Texture> const &getTextures() const;
 };
 
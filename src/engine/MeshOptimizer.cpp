@@ -0,0 +1,307 @@
+#include "MeshOptimizer.hpp"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <limits>
+
+namespace engine
+{
+
+namespace
+{
+
+// Size of the LRU cache modelled by the optimizer
+constexpr int CacheSize = 32;
+
+float VertexScore(int cachePosition, GLuint remainingTriangles)
+{
+	// Vertices with no triangle left should never be picked again
+	if (remainingTriangles == 0) { return -1.0f; }
+
+	float score = 0.0f;
+
+	if (cachePosition >= 0) {
+		// The last triangle's vertices get a fixed score so that the next
+		// triangle does not reuse the same vertices in a strip-like order
+		if (cachePosition < 3) {
+			score = 0.75f;
+		}
+		else {
+			float const scaler = 1.0f / (CacheSize - 3);
+			score = std::pow(1.0f - (cachePosition - 3) * scaler, 1.5f);
+		}
+	}
+
+	// Favour vertices with few triangles left, to finish them off
+	score += 2.0f / std::sqrt(static_cast<float>(remainingTriangles));
+
+	return score;
+}
+
+}
+
+MeshOptimizer::Statistics MeshOptimizer::AnalyzeVertexCache(std::vector<GLuint> const &indices, size_t vertexCount,
+	size_t cacheSize)
+{
+	Statistics stats;
+	std::deque<GLuint> cache;
+	std::vector<bool> used(vertexCount, false);
+	size_t misses = 0;
+	size_t usedVertices = 0;
+
+	for (auto index : indices) {
+		if (std::find(cache.begin(), cache.end(), index) != cache.end()) { continue ; }
+
+		misses++;
+		cache.push_back(index);
+		if (cache.size() > cacheSize) { cache.pop_front(); }
+
+		if (index < vertexCount && !used[index]) {
+			used[index] = true;
+			usedVertices++;
+		}
+	}
+
+	if (indices.size() >= 3) {
+		stats.Acmr = static_cast<float>(misses) / (indices.size() / 3);
+	}
+	if (usedVertices > 0) {
+		stats.Atvr = static_cast<float>(misses) / usedVertices;
+	}
+
+	return stats;
+}
+
+std::vector<GLuint> MeshOptimizer::OptimizeVertexCache(std::vector<GLuint> const &indices, size_t vertexCount)
+{
+	size_t const triangleCount = indices.size() / 3;
+
+	// Triangles using each vertex
+	std::vector<GLuint> remaining(vertexCount, 0);
+	std::vector<GLuint> offsets(vertexCount + 1, 0);
+
+	for (size_t i = 0; i < triangleCount * 3; i++) {
+		remaining[indices[i]]++;
+	}
+	for (size_t v = 0; v < vertexCount; v++) {
+		offsets[v + 1] = offsets[v] + remaining[v];
+	}
+
+	std::vector<GLuint> adjacency(triangleCount * 3);
+	{
+		std::vector<GLuint> fill(offsets.begin(), offsets.end() - 1);
+
+		for (size_t t = 0; t < triangleCount; t++) {
+			for (int i = 0; i < 3; i++) {
+				adjacency[fill[indices[t * 3 + i]]++] = t;
+			}
+		}
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+
+	for (size_t v = 0; v < vertexCount; v++) {
+		vertexScore[v] = VertexScore(-1, remaining[v]);
+	}
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+
+	for (size_t t = 0; t < triangleCount; t++) {
+		triangleScore[t] = vertexScore[indices[t * 3 + 0]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+	}
+
+	std::vector<GLuint> result;
+	result.reserve(triangleCount * 3);
+
+	std::vector<GLuint> cache;
+	std::vector<GLuint> newCache;
+
+	auto best = std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin();
+	size_t cursor = 0;
+
+	for (size_t n = 0; n < triangleCount; n++) {
+
+		// Nothing in the cache touches a remaining triangle, start somewhere else
+		if (best < 0) {
+			while (emitted[cursor]) { cursor++; }
+			best = cursor;
+		}
+
+		GLuint const *triangle = &indices[best * 3];
+
+		emitted[best] = true;
+		result.insert(result.end(), triangle, triangle + 3);
+
+		newCache.assign(triangle, triangle + 3);
+
+		for (int i = 0; i < 3; i++) {
+			GLuint const v = triangle[i];
+			GLuint *begin = &adjacency[offsets[v]];
+			GLuint *end = begin + remaining[v];
+
+			std::iter_swap(std::find(begin, end, static_cast<GLuint>(best)), end - 1);
+			remaining[v]--;
+		}
+
+		for (auto v : cache) {
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+				newCache.push_back(v);
+			}
+		}
+
+		best = -1;
+		float bestScore = -std::numeric_limits<float>::max();
+
+		for (size_t i = 0; i < newCache.size(); i++) {
+			GLuint const v = newCache[i];
+
+			cachePosition[v] = i < CacheSize ? static_cast<int>(i) : -1;
+			vertexScore[v] = VertexScore(cachePosition[v], remaining[v]);
+		}
+
+		for (auto v : newCache) {
+			for (GLuint a = offsets[v]; a < offsets[v] + remaining[v]; a++) {
+				GLuint const t = adjacency[a];
+				float const score = vertexScore[indices[t * 3 + 0]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+				triangleScore[t] = score;
+
+				if (score > bestScore) {
+					bestScore = score;
+					best = t;
+				}
+			}
+		}
+
+		newCache.resize(std::min(newCache.size(), static_cast<size_t>(CacheSize)));
+		std::swap(cache, newCache);
+	}
+
+	return result;
+}
+
+std::vector<GLuint> MeshOptimizer::OptimizeOverdraw(std::vector<GLuint> const &indices, std::vector<GLfloat> const &positions,
+	float threshold)
+{
+	size_t const vertexCount = positions.size() / 3;
+	size_t const triangleCount = indices.size() / 3;
+
+	auto position = [&] (GLuint v) {
+		return glm::vec3(positions[v * 3 + 0], positions[v * 3 + 1], positions[v * 3 + 2]);
+	};
+
+	// Split where the simulated cache misses the three vertices of a triangle:
+	// moving such a cluster around costs nothing in cache efficiency
+	std::vector<size_t> clusterStarts;
+	std::deque<GLuint> cache;
+
+	for (size_t t = 0; t < triangleCount; t++) {
+		int misses = 0;
+
+		for (int i = 0; i < 3; i++) {
+			GLuint const index = indices[t * 3 + i];
+
+			if (std::find(cache.begin(), cache.end(), index) == cache.end()) {
+				misses++;
+				cache.push_back(index);
+				if (cache.size() > AnalysisCacheSize) { cache.pop_front(); }
+			}
+		}
+
+		if (t == 0 || misses == 3) {
+			clusterStarts.push_back(t);
+		}
+	}
+
+	if (clusterStarts.size() < 2) { return indices; }
+
+	clusterStarts.push_back(triangleCount);
+
+	glm::vec3 meshCenter(0.0f);
+	float meshArea = 0.0f;
+
+	struct Cluster
+	{
+		size_t First;
+		size_t Last;
+		glm::vec3 Center;
+		glm::vec3 Normal;
+		float Sort;
+	};
+
+	std::vector<Cluster> clusters;
+
+	for (size_t c = 0; c + 1 < clusterStarts.size(); c++) {
+		Cluster cluster = { clusterStarts[c], clusterStarts[c + 1], glm::vec3(0.0f), glm::vec3(0.0f), 0.0f };
+		float area = 0.0f;
+
+		for (size_t t = cluster.First; t < cluster.Last; t++) {
+			glm::vec3 const p0 = position(indices[t * 3 + 0]);
+			glm::vec3 const p1 = position(indices[t * 3 + 1]);
+			glm::vec3 const p2 = position(indices[t * 3 + 2]);
+
+			// Twice the area, weighted by area
+			glm::vec3 const normal = glm::cross(p1 - p0, p2 - p0);
+			float const triangleArea = glm::length(normal);
+
+			cluster.Center += (p0 + p1 + p2) / 3.0f * triangleArea;
+			cluster.Normal += normal;
+			area += triangleArea;
+		}
+
+		meshCenter += cluster.Center;
+		meshArea += area;
+
+		cluster.Center = area > 0.0f ? cluster.Center / area : position(indices[cluster.First * 3]);
+		clusters.push_back(cluster);
+	}
+
+	if (meshArea > 0.0f) { meshCenter /= meshArea; }
+
+	// Clusters far out along their normal are likely to occlude the others
+	for (auto &cluster : clusters) {
+		float const length = glm::length(cluster.Normal);
+
+		cluster.Sort = length > 0.0f ? glm::dot(cluster.Center - meshCenter, cluster.Normal / length) : 0.0f;
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [] (Cluster const &a, Cluster const &b) { return a.Sort > b.Sort; });
+
+	std::vector<GLuint> result;
+	result.reserve(indices.size());
+
+	for (auto const &cluster : clusters) {
+		result.insert(result.end(), indices.begin() + cluster.First * 3, indices.begin() + cluster.Last * 3);
+	}
+
+	float const before = AnalyzeVertexCache(indices, vertexCount).Acmr;
+	float const after = AnalyzeVertexCache(result, vertexCount).Acmr;
+
+	return after <= before * threshold ? result : indices;
+}
+
+std::vector<GLuint> MeshOptimizer::OptimizeVertexFetch(std::vector<GLuint> const &indices, size_t vertexCount)
+{
+	GLuint const unassigned = std::numeric_limits<GLuint>::max();
+	std::vector<GLuint> remap(vertexCount, unassigned);
+	GLuint next = 0;
+
+	for (auto index : indices) {
+		if (remap[index] == unassigned) {
+			remap[index] = next++;
+		}
+	}
+
+	for (auto &index : remap) {
+		if (index == unassigned) {
+			index = next++;
+		}
+	}
+
+	return remap;
+}
+
+}
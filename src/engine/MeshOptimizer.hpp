@@ -0,0 +1,52 @@
+#pragma once
+
+#include "lazy.hpp"
+#include <vector>
+
+namespace engine
+{
+
+///
+/// Index and vertex reordering run once when a model is imported:
+///   - triangles are reordered for the post-transform vertex cache
+///     (Forsyth, "Linear-Speed Vertex Cache Optimisation")
+///   - optionally, clusters of triangles are sorted so that the ones facing
+///     outwards are drawn first, reducing overdraw
+///   - vertices are reordered in the order they are first used, so that
+///     vertex fetches walk the buffer linearly
+///
+class MeshOptimizer
+{
+public:
+	struct Statistics
+	{
+		/// Average cache miss ratio: transformed vertices per triangle (0.5 to 3)
+		float Acmr = 0.0f;
+		/// Average transform to vertex ratio: transformed vertices per vertex (1 is ideal)
+		float Atvr = 0.0f;
+	};
+
+	/// FIFO size used to simulate the post-transform cache when reporting
+	static constexpr size_t AnalysisCacheSize = 16;
+
+	static Statistics AnalyzeVertexCache(std::vector<GLuint> const &indices, size_t vertexCount,
+		size_t cacheSize = AnalysisCacheSize);
+
+	static std::vector<GLuint> OptimizeVertexCache(std::vector<GLuint> const &indices, size_t vertexCount);
+
+	///
+	/// Sort the clusters of a cache optimized index list front to back from the
+	/// outside of the mesh. The result is dropped if it makes the ACMR worse
+	/// than `threshold` times the input ACMR.
+	///
+	static std::vector<GLuint> OptimizeOverdraw(std::vector<GLuint> const &indices, std::vector<GLfloat> const &positions,
+		float threshold = 1.05f);
+
+	///
+	/// New index of every vertex, in order of first use by `indices`.
+	/// Unused vertices are moved at the end.
+	///
+	static std::vector<GLuint> OptimizeVertexFetch(std::vector<GLuint> const &indices, size_t vertexCount);
+};
+
+}
@@ -0,0 +1,291 @@
+#include "MeshSimplifier.hpp"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <unordered_map>
+
+namespace engine
+{
+
+namespace
+{
+
+///
+/// Sum of squared distances to a set of planes, stored as the symmetric
+/// matrix [A b; b c] so that Q(p) = p.A.p + 2 b.p + c
+///
+struct Quadric
+{
+	double a00 = 0.0, a01 = 0.0, a02 = 0.0;
+	double a11 = 0.0, a12 = 0.0;
+	double a22 = 0.0;
+	double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+	double c = 0.0;
+
+	static Quadric FromPlane(glm::dvec3 const &n, double d)
+	{
+		Quadric q;
+
+		q.a00 = n.x * n.x; q.a01 = n.x * n.y; q.a02 = n.x * n.z;
+		q.a11 = n.y * n.y; q.a12 = n.y * n.z;
+		q.a22 = n.z * n.z;
+		q.b0 = n.x * d; q.b1 = n.y * d; q.b2 = n.z * d;
+		q.c = d * d;
+
+		return q;
+	}
+
+	Quadric &operator+=(Quadric const &o)
+	{
+		a00 += o.a00; a01 += o.a01; a02 += o.a02;
+		a11 += o.a11; a12 += o.a12;
+		a22 += o.a22;
+		b0 += o.b0; b1 += o.b1; b2 += o.b2;
+		c += o.c;
+
+		return *this;
+	}
+
+	double Evaluate(glm::dvec3 const &p) const
+	{
+		double const x = p.x, y = p.y, z = p.z;
+
+		return a00 * x * x + a11 * y * y + a22 * z * z
+			+ 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+			+ 2.0 * (b0 * x + b1 * y + b2 * z)
+			+ c;
+	}
+};
+
+struct Collapse
+{
+	double Cost;
+	GLuint From;
+	GLuint To;
+	unsigned int FromVersion;
+	unsigned int ToVersion;
+
+	bool operator>(Collapse const &o) const { return Cost > o.Cost; }
+};
+
+uint64_t EdgeKey(GLuint a, GLuint b)
+{
+	return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+}
+
+}
+
+MeshSimplifier::Result MeshSimplifier::Simplify(std::vector<GLfloat> const &positions, std::vector<GLuint> const &indices,
+	size_t targetIndexCount, float maxError)
+{
+	Result result;
+
+	size_t const vertexCount = positions.size() / 3;
+	size_t const triangleCount = indices.size() / 3;
+
+	auto position = [&] (GLuint v) {
+		return glm::dvec3(positions[v * 3 + 0], positions[v * 3 + 1], positions[v * 3 + 2]);
+	};
+
+	// Errors are measured relative to the bounding sphere of the mesh
+	glm::dvec3 min(std::numeric_limits<double>::max());
+	glm::dvec3 max(std::numeric_limits<double>::lowest());
+
+	for (size_t v = 0; v < vertexCount; v++) {
+		min = glm::min(min, position(v));
+		max = glm::max(max, position(v));
+	}
+
+	double const radius = vertexCount > 0 ? glm::length(max - min) * 0.5 : 0.0;
+
+	if (radius <= 0.0 || indices.size() <= targetIndexCount) {
+		result.Indices = indices;
+		return result;
+	}
+
+	std::vector<GLuint> triangles(indices.begin(), indices.begin() + triangleCount * 3);
+	std::vector<bool> removed(triangleCount, false);
+	std::vector<std::vector<GLuint>> vertexTriangles(vertexCount);
+
+	std::vector<GLuint> remap(vertexCount);
+	std::iota(remap.begin(), remap.end(), 0);
+
+	std::vector<unsigned int> version(vertexCount, 0);
+	std::vector<bool> locked(vertexCount, false);
+	std::vector<Quadric> quadrics(vertexCount);
+
+	// Edges used by a single triangle are borders or seams, edges used by more
+	// than two are not manifold: their vertices must stay in place
+	std::unordered_map<uint64_t, int> edges;
+
+	for (size_t t = 0; t < triangleCount; t++) {
+		for (int e = 0; e < 3; e++) {
+			edges[EdgeKey(triangles[t * 3 + e], triangles[t * 3 + (e + 1) % 3])]++;
+		}
+	}
+
+	for (auto const &[key, count] : edges) {
+		if (count != 2) {
+			locked[key >> 32] = true;
+			locked[key & 0xffffffff] = true;
+		}
+	}
+
+	for (size_t t = 0; t < triangleCount; t++) {
+		GLuint const *tri = &triangles[t * 3];
+
+		glm::dvec3 const p0 = position(tri[0]);
+		glm::dvec3 normal = glm::cross(position(tri[1]) - p0, position(tri[2]) - p0);
+		double const length = glm::length(normal);
+
+		for (int i = 0; i < 3; i++) {
+			vertexTriangles[tri[i]].push_back(t);
+		}
+
+		if (length <= 0.0) { continue ; }
+
+		normal /= length;
+
+		Quadric const plane = Quadric::FromPlane(normal, -glm::dot(normal, p0));
+
+		for (int i = 0; i < 3; i++) {
+			quadrics[tri[i]] += plane;
+		}
+	}
+
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+
+	// Queue the cheapest direction of the edge (a, b)
+	auto pushEdge = [&] (GLuint a, GLuint b) {
+		double const infinity = std::numeric_limits<double>::infinity();
+		double costAB = infinity;
+		double costBA = infinity;
+
+		if (!locked[a]) {
+			Quadric q = quadrics[a];
+			q += quadrics[b];
+			costAB = std::max(q.Evaluate(position(b)), 0.0);
+		}
+		if (!locked[b]) {
+			Quadric q = quadrics[b];
+			q += quadrics[a];
+			costBA = std::max(q.Evaluate(position(a)), 0.0);
+		}
+
+		if (costAB == infinity && costBA == infinity) { return ; }
+
+		if (costAB <= costBA) {
+			queue.push({ costAB, a, b, version[a], version[b] });
+		}
+		else {
+			queue.push({ costBA, b, a, version[b], version[a] });
+		}
+	};
+
+	// Moving `from` onto `to` must not flip any of the remaining triangles
+	auto canCollapse = [&] (GLuint from, GLuint to) {
+		for (auto t : vertexTriangles[from]) {
+			if (removed[t]) { continue ; }
+
+			GLuint const *tri = &triangles[t * 3];
+
+			if (tri[0] == to || tri[1] == to || tri[2] == to) { continue ; }
+
+			glm::dvec3 before[3];
+			glm::dvec3 after[3];
+
+			for (int i = 0; i < 3; i++) {
+				before[i] = position(tri[i]);
+				after[i] = tri[i] == from ? position(to) : before[i];
+			}
+
+			glm::dvec3 const n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+			glm::dvec3 const n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+
+			if (glm::dot(n0, n1) <= 0.0) { return false; }
+		}
+
+		return true;
+	};
+
+	for (auto const &[key, count] : edges) {
+		pushEdge(static_cast<GLuint>(key >> 32), static_cast<GLuint>(key & 0xffffffff));
+	}
+
+	double const maxCost = std::pow(maxError * radius, 2.0);
+	double worstCost = 0.0;
+	size_t liveTriangles = triangleCount;
+
+	while (liveTriangles * 3 > targetIndexCount && !queue.empty()) {
+		Collapse const collapse = queue.top();
+		queue.pop();
+
+		GLuint const from = collapse.From;
+		GLuint const to = collapse.To;
+
+		// One of the vertices was collapsed, its edges were queued again for the survivor
+		if (remap[from] != from || remap[to] != to) { continue ; }
+
+		if (collapse.FromVersion != version[from] || collapse.ToVersion != version[to]) {
+			pushEdge(from, to);
+			continue ;
+		}
+
+		// Quadrics only grow so the remaining collapses cannot be cheaper
+		if (collapse.Cost > maxCost) { break ; }
+
+		if (!canCollapse(from, to)) { continue ; }
+
+		for (auto t : vertexTriangles[from]) {
+			if (removed[t]) { continue ; }
+
+			GLuint *tri = &triangles[t * 3];
+
+			if (tri[0] == to || tri[1] == to || tri[2] == to) {
+				removed[t] = true;
+				liveTriangles--;
+				continue ;
+			}
+
+			for (int i = 0; i < 3; i++) {
+				if (tri[i] == from) { tri[i] = to; }
+			}
+			vertexTriangles[to].push_back(t);
+		}
+
+		remap[from] = to;
+		quadrics[to] += quadrics[from];
+		version[to]++;
+		vertexTriangles[from].clear();
+		worstCost = std::max(worstCost, collapse.Cost);
+
+		auto &around = vertexTriangles[to];
+		around.erase(std::remove_if(around.begin(), around.end(), [&] (GLuint t) { return removed[t]; }), around.end());
+
+		for (auto t : around) {
+			for (int i = 0; i < 3; i++) {
+				if (triangles[t * 3 + i] != to) {
+					pushEdge(to, triangles[t * 3 + i]);
+				}
+			}
+		}
+	}
+
+	result.Indices.reserve(liveTriangles * 3);
+
+	for (size_t t = 0; t < triangleCount; t++) {
+		if (!removed[t]) {
+			result.Indices.insert(result.Indices.end(), &triangles[t * 3], &triangles[t * 3] + 3);
+		}
+	}
+
+	result.Error = static_cast<float>(std::sqrt(worstCost) / radius);
+
+	return result;
+}
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "lazy.hpp"
+#include <vector>
+
+namespace engine
+{
+
+///
+/// Quadric error metric edge-collapse simplification (Garland & Heckbert).
+///
+/// Vertices are only ever collapsed onto other existing vertices, so the
+/// result indexes the same vertex data as the input and can be stored in the
+/// same vertex buffer. Vertices on an open edge of the index topology (mesh
+/// borders and uv/normal seams, where vertices are split) are locked to avoid
+/// opening cracks.
+///
+class MeshSimplifier
+{
+public:
+	struct Result
+	{
+		std::vector<GLuint> Indices;
+		/// Largest geometric error introduced, relative to the mesh radius
+		float Error = 0.0f;
+	};
+
+	///
+	/// Collapse edges of the triangles in `indices` until at most
+	/// `targetIndexCount` indices remain or the next collapse would move the
+	/// surface by more than `maxError` (relative to the mesh radius).
+	/// `positions` holds 3 floats per vertex.
+	///
+	static Result Simplify(std::vector<GLfloat> const &positions, std::vector<GLuint> const &indices,
+		size_t targetIndexCount, float maxError);
+};
+
+}
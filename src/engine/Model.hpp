@@ -6,6 +6,7 @@
 #include "tinygltf/tiny_gltf.h"
 #include "Mesh.hpp"
 #include "TextureManager.hpp"
+#include "utils/Settings.hpp"
 
 namespace engine {
 
@@ -59,7 +60,19 @@ private:
 				auto normals   = getVertex("NORMAL");
 				auto tangents  = getVertex("TANGENT");
 				auto texcoords = getVertex("TEXCOORD_0");
-				auto indices   = reinterpret_cast<const GLushort*>(&indBuffer.data[indBufferView.byteOffset + indAccessor.byteOffset]);
+				auto indices   = &indBuffer.data[indBufferView.byteOffset + indAccessor.byteOffset];
+
+				// Indices may be stored on 8, 16 or 32 bits
+				auto getIndex = [&] (size_t i) -> GLuint {
+					switch (indAccessor.componentType) {
+					case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+						return indices[i];
+					case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+						return reinterpret_cast<const GLuint*>(indices)[i];
+					default:
+						return reinterpret_cast<const GLushort*>(indices)[i];
+					}
+				};
 
 				// Build the mesh
 				// --------------
@@ -108,12 +121,18 @@ private:
 				// triangles so that we do not overrun the buffer
 				for (size_t i = 0; i < indAccessor.count / 3; i++) {
 					current.addTriangle({
-						static_cast<GLuint>(indices[i * 3 + 0]),
-						static_cast<GLuint>(indices[i * 3 + 1]),
-						static_cast<GLuint>(indices[i * 3 + 2])
+						getIndex(i * 3 + 0),
+						getIndex(i * 3 + 1),
+						getIndex(i * 3 + 2)
 					});
 				}
 
+				auto [ before, after ] = current.optimize(std::any_cast<int>(Settings::instance().get("optimizeOverdraw")));
+				Logger::Info("{}: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}\n", mesh.name,
+					before.Acmr, after.Acmr, before.Atvr, after.Atvr);
+
+				current.generateLods();
+				current.quantizePositions();
 				current.build();
 				if (primitive.material >= 0) {
 					if (primitive.material > materials.size()) abort();
@@ -0,0 +1,433 @@
+#include "OcclusionCuller.hpp"
+#include "GBuffer.hpp"
+#include "Logger.hpp"
+#include "GLState.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace engine
+{
+
+// Width of the pyramid level read back, about 120x68 texels for a 1080p frame
+static constexpr int MaxReadbackWidth = 160;
+
+// Query objects of boxes that were not tested for this many frames are released
+static constexpr size_t QueryTimeout = 60;
+
+OcclusionCuller::OcclusionCuller()
+{
+	_hizShader.addVertexShader("shaders/ssao.vs.glsl")
+		.addFragmentShader("shaders/hiz.fs.glsl")
+		.link();
+
+	_boxShader.addVertexShader("shaders/bbox.vs.glsl")
+		.addFragmentShader("shaders/depth.fs.glsl")
+		.link();
+
+	for (int i = 0; i < 8; i++) {
+		_box.addPosition(glm::vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1));
+	}
+
+	// Faces of the unit cube, the winding does not matter as culling is disabled
+	_box.addTriangle({ 0, 1, 3 }).addTriangle({ 0, 3, 2 })
+		.addTriangle({ 4, 6, 7 }).addTriangle({ 4, 7, 5 })
+		.addTriangle({ 0, 4, 5 }).addTriangle({ 0, 5, 1 })
+		.addTriangle({ 2, 3, 7 }).addTriangle({ 2, 7, 6 })
+		.addTriangle({ 0, 2, 6 }).addTriangle({ 0, 6, 4 })
+		.addTriangle({ 1, 5, 7 }).addTriangle({ 1, 7, 3 });
+	_box.build();
+
+	glGenFramebuffers(1, &_framebuffer);
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+	DeletePyramid();
+	GLState::Instance().DeleteFramebuffer(_framebuffer);
+
+	for (auto &[key, object] : _queries) {
+		glDeleteQueries(object.Queries.size(), object.Queries.data());
+	}
+}
+
+void OcclusionCuller::DeletePyramid()
+{
+	if (_pyramid) {
+		GLState::Instance().DeleteTexture(_pyramid);
+		_pyramid = 0;
+	}
+
+	for (auto &readback : _readbacks) {
+		if (readback.Fence) { glDeleteSync(readback.Fence); }
+		if (readback.Buffer) { glDeleteBuffers(1, &readback.Buffer); }
+		readback = Readback();
+	}
+
+	_depth.clear();
+	_depthSizes.clear();
+}
+
+void OcclusionCuller::CreatePyramid(int width, int height)
+{
+	DeletePyramid();
+
+	_width = width;
+	_height = height;
+
+	// Level 0 is half the resolution of the depth buffer
+	int levelWidth = std::max(width / 2, 1);
+	int levelHeight = std::max(height / 2, 1);
+
+	glGenTextures(1, &_pyramid);
+	GLState::Instance().BindTexture(GL_TEXTURE_2D, _pyramid);
+
+	_levels = 0;
+	size_t readbackSize = 0;
+
+	while (true) {
+		glTexImage2D(GL_TEXTURE_2D, _levels, GL_R32F, levelWidth, levelHeight, 0, GL_RED, GL_FLOAT, nullptr);
+
+		if (readbackSize == 0 && (levelWidth <= MaxReadbackWidth || (levelWidth == 1 && levelHeight == 1))) {
+			readbackSize = levelWidth * levelHeight * sizeof(float);
+		}
+
+		_levels++;
+
+		if (levelWidth == 1 && levelHeight == 1) { break ; }
+
+		levelWidth = std::max(levelWidth / 2, 1);
+		levelHeight = std::max(levelHeight / 2, 1);
+	}
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, _levels - 1);
+	GLState::Instance().BindTexture(GL_TEXTURE_2D, 0);
+
+	for (auto &readback : _readbacks) {
+		glGenBuffers(1, &readback.Buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.Buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, readbackSize, nullptr, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void OcclusionCuller::CollectReadback()
+{
+	// The slot written this frame was filled FrameLatency frames ago
+	Readback &readback = _readbacks[_frame % FrameLatency];
+
+	if (!readback.Fence) { return ; }
+
+	GLenum status = glClientWaitSync(readback.Fence, 0, 0);
+
+	// Never stall, the previous depth is kept meanwhile
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) { return ; }
+
+	glDeleteSync(readback.Fence);
+	readback.Fence = nullptr;
+
+	size_t const count = readback.Width * readback.Height;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.Buffer);
+	auto const *data = static_cast<float const *>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, count * sizeof(float), GL_MAP_READ_BIT));
+
+	if (data == nullptr) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		return ;
+	}
+
+	_depth.resize(1);
+	_depth[0].assign(data, data + count);
+	_depthSizes.assign(1, glm::ivec2(readback.Width, readback.Height));
+	_depthViewProjection = readback.ViewProjection;
+
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	// Coarser levels are reduced on the CPU, same rule as hiz.fs
+	while (_depthSizes.back() != glm::ivec2(1, 1)) {
+		glm::ivec2 const source = _depthSizes.back();
+		glm::ivec2 const size = glm::max(source / 2, glm::ivec2(1));
+		std::vector<float> level(size.x * size.y);
+		std::vector<float> const &previous = _depth.back();
+
+		for (int y = 0; y < size.y; y++) {
+			for (int x = 0; x < size.x; x++) {
+				int const x1 = x == size.x - 1 ? source.x - 1 : x * 2 + 1;
+				int const y1 = y == size.y - 1 ? source.y - 1 : y * 2 + 1;
+				float depth = 0.0f;
+
+				for (int sy = y * 2; sy <= std::min(y1, source.y - 1); sy++) {
+					for (int sx = x * 2; sx <= std::min(x1, source.x - 1); sx++) {
+						depth = std::max(depth, previous[sy * source.x + sx]);
+					}
+				}
+				level[y * size.x + x] = depth;
+			}
+		}
+
+		_depth.push_back(std::move(level));
+		_depthSizes.push_back(size);
+	}
+}
+
+void OcclusionCuller::BeginFrame(OcclusionMode mode)
+{
+	if (mode != _mode) {
+		// Results of another mode say nothing about this one
+		_depth.clear();
+		_depthSizes.clear();
+
+		for (auto &[key, object] : _queries) {
+			glDeleteQueries(object.Queries.size(), object.Queries.data());
+		}
+		_queries.clear();
+
+		_mode = mode;
+	}
+
+	_frame++;
+
+	if (_mode == OcclusionMode::HiZ) {
+		CollectReadback();
+	}
+	else if (_mode == OcclusionMode::Queries) {
+		for (auto it = _queries.begin(); it != _queries.end();) {
+			if (it->second.LastFrame + QueryTimeout < _frame) {
+				glDeleteQueries(it->second.Queries.size(), it->second.Queries.data());
+				it = _queries.erase(it);
+			}
+			else {
+				it++;
+			}
+		}
+	}
+}
+
+bool OcclusionCuller::TestPyramid(Box const &box) const
+{
+	if (_depth.empty()) { return true; }
+
+	glm::vec2 uvMin(std::numeric_limits<float>::max());
+	glm::vec2 uvMax(std::numeric_limits<float>::lowest());
+	float nearest = std::numeric_limits<float>::max();
+
+	for (int i = 0; i < 8; i++) {
+		glm::vec3 corner(i & 1 ? box.Max.x : box.Min.x, i & 2 ? box.Max.y : box.Min.y, i & 4 ? box.Max.z : box.Min.z);
+		glm::vec4 clip = _depthViewProjection * glm::vec4(corner, 1.0f);
+
+		// Crosses the near plane
+		if (clip.w <= 0.0f) { return true; }
+
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		glm::vec2 uv = glm::vec2(ndc.x, ndc.y) * 0.5f + 0.5f;
+
+		uvMin = glm::min(uvMin, uv);
+		uvMax = glm::max(uvMax, uv);
+		nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+	}
+
+	// Outside of the screen, not for occlusion culling to decide
+	if (uvMax.x < 0.0f || uvMax.y < 0.0f || uvMin.x > 1.0f || uvMin.y > 1.0f) { return true; }
+
+	glm::ivec2 const size = _depthSizes[0];
+
+	// One more texel on each side as the pyramid levels round their sizes down
+	glm::ivec2 lo = glm::ivec2(glm::floor(glm::clamp(uvMin, 0.0f, 1.0f) * glm::vec2(size))) - 1;
+	glm::ivec2 hi = glm::ivec2(glm::floor(glm::clamp(uvMax, 0.0f, 1.0f) * glm::vec2(size))) + 1;
+
+	// Go down the pyramid until the box covers at most 3x3 texels
+	size_t level = 0;
+	while ((hi.x - lo.x > 2 || hi.y - lo.y > 2) && level + 1 < _depth.size()) {
+		lo = lo / 2;
+		hi = hi / 2;
+		level++;
+	}
+
+	glm::ivec2 const levelSize = _depthSizes[level];
+	lo = glm::clamp(lo, glm::ivec2(0), levelSize - 1);
+	hi = glm::clamp(hi, glm::ivec2(0), levelSize - 1);
+
+	float farthest = 0.0f;
+
+	for (int y = lo.y; y <= hi.y; y++) {
+		for (int x = lo.x; x <= hi.x; x++) {
+			farthest = std::max(farthest, _depth[level][y * levelSize.x + x]);
+		}
+	}
+
+	return nearest <= farthest;
+}
+
+bool OcclusionCuller::IsVisible(uint64_t key, Box const &box)
+{
+	switch (_mode) {
+	case OcclusionMode::HiZ:
+		return TestPyramid(box);
+	case OcclusionMode::Queries: {
+		auto &object = _queries[key];
+
+		if (object.Queries[0] == 0) {
+			glGenQueries(object.Queries.size(), object.Queries.data());
+		}
+
+		object.LastFrame = _frame;
+		object.Bounds = box;
+
+		return !object.Occluded;
+	}
+	default:
+		return true;
+	}
+}
+
+void OcclusionCuller::BuildPyramid(GBuffer const &gBuffer, engine::Mesh const &quad, glm::mat4 const &viewProjection,
+	int renderWidth, int renderHeight)
+{
+	glm::ivec2 sourceSize(renderWidth, renderHeight);
+	glm::ivec2 size = glm::max(sourceSize / 2, glm::ivec2(1));
+
+	GLState::Instance().Disable(GL_DEPTH_TEST);
+	GLState::Instance().BindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+
+	_hizShader.bind();
+	_hizShader.setUniform1i("source", 0);
+	GLState::Instance().ActiveTexture(GL_TEXTURE0);
+
+	int level = 0;
+
+	while (true) {
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _pyramid, level);
+		glViewport(0, 0, size.x, size.y);
+
+		if (level == 0) {
+			GLState::Instance().BindTexture(GL_TEXTURE_2D, gBuffer.GetDepthTex());
+		}
+		else {
+			// Only expose the previous level to the shader, the one written is not sampled
+			GLState::Instance().BindTexture(GL_TEXTURE_2D, _pyramid);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+		}
+
+		_sourceSize.set(sourceSize);
+		quad.Draw();
+
+		if (size.x <= MaxReadbackWidth || level + 1 == _levels) { break ; }
+
+		sourceSize = size;
+		size = glm::max(size / 2, glm::ivec2(1));
+		level++;
+	}
+
+	GLState::Instance().BindTexture(GL_TEXTURE_2D, _pyramid);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, _levels - 1);
+	GLState::Instance().BindTexture(GL_TEXTURE_2D, 0);
+	_hizShader.unbind();
+
+	// Asynchronous read back of the level, picked up FrameLatency frames later
+	Readback &readback = _readbacks[_frame % FrameLatency];
+
+	if (readback.Fence) { glDeleteSync(readback.Fence); }
+
+	readback.Width = size.x;
+	readback.Height = size.y;
+	readback.ViewProjection = viewProjection;
+
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.Buffer);
+	glReadPixels(0, 0, size.x, size.y, GL_RED, GL_FLOAT, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	readback.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	GLState::Instance().BindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void OcclusionCuller::IssueQueries(GBuffer const &gBuffer, glm::mat4 const &viewProjection, glm::vec3 const &viewPos)
+{
+	// Any samples is enough and cheaper when available
+	GLenum const target = GLEW_VERSION_3_3 || GLEW_ARB_occlusion_query2 ? GL_ANY_SAMPLES_PASSED : GL_SAMPLES_PASSED;
+	size_t const slot = _frame % FrameLatency;
+	GLboolean const cullFace = glIsEnabled(GL_CULL_FACE);
+
+	GLState::Instance().BindFramebuffer(GL_FRAMEBUFFER, gBuffer.GetFramebufferId());
+	GLState::Instance().ColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	GLState::Instance().DepthMask(GL_FALSE);
+	GLState::Instance().Enable(GL_DEPTH_TEST);
+	GLState::Instance().Disable(GL_CULL_FACE);
+
+	_boxShader.bind();
+	_boxShader.setUniform4x4f("viewProjectionMatrix", viewProjection);
+
+	for (auto &[key, object] : _queries) {
+		if (object.LastFrame != _frame) { continue ; }
+
+		GLuint const query = object.Queries[slot];
+
+		// Result of the query issued FrameLatency frames ago, unknown means visible
+		if (object.Issued[slot]) {
+			GLint available = GL_FALSE;
+			glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+
+			GLuint samples = 1;
+			if (available) {
+				glGetQueryObjectuiv(query, GL_QUERY_RESULT, &samples);
+			}
+			object.Occluded = samples == 0;
+			object.Issued[slot] = false;
+		}
+
+		// The faces of the box would be clipped by the near plane
+		glm::vec3 const min = object.Bounds.Min - 1.0f;
+		glm::vec3 const max = object.Bounds.Max + 1.0f;
+		if (viewPos.x >= min.x && viewPos.y >= min.y && viewPos.z >= min.z
+			&& viewPos.x <= max.x && viewPos.y <= max.y && viewPos.z <= max.z) {
+			object.Occluded = false;
+			continue ;
+		}
+
+		_boxMin.set(object.Bounds.Min);
+		_boxMax.set(object.Bounds.Max);
+
+		glBeginQuery(target, query);
+		_box.Draw();
+		glEndQuery(target);
+
+		object.Issued[slot] = true;
+	}
+
+	_boxShader.unbind();
+
+	if (cullFace) { GLState::Instance().Enable(GL_CULL_FACE); }
+	GLState::Instance().DepthMask(GL_TRUE);
+	GLState::Instance().ColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	GLState::Instance().Disable(GL_DEPTH_TEST);
+	GLState::Instance().BindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void OcclusionCuller::Render(GBuffer const &gBuffer, engine::Mesh const &quad, glm::mat4 const &viewProjection,
+	glm::vec3 const &viewPos, int renderWidth, int renderHeight, int width, int height)
+{
+	switch (_mode) {
+	case OcclusionMode::HiZ:
+		if (width != _width || height != _height || !_pyramid) {
+			CreatePyramid(width, height);
+		}
+		BuildPyramid(gBuffer, quad, viewProjection, renderWidth, renderHeight);
+		break ;
+	case OcclusionMode::Queries:
+		glViewport(0, 0, renderWidth, renderHeight);
+		IssueQueries(gBuffer, viewProjection, viewPos);
+		break ;
+	default:
+		break ;
+	}
+}
+
+}
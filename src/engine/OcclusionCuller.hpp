@@ -0,0 +1,128 @@
+#pragma once
+
+#include "lazy.hpp"
+#include "Mesh.hpp"
+#include <array>
+#include <unordered_map>
+#include <vector>
+
+class GBuffer;
+
+namespace engine
+{
+
+enum class OcclusionMode : int
+{
+	Off = 0,
+	/// Depth pyramid of the previous frame read back and tested on the CPU
+	HiZ,
+	/// One GL_SAMPLES_PASSED query per object, read a few frames later
+	Queries,
+};
+
+///
+/// Decides which objects are hidden behind the geometry drawn last frame.
+///
+/// Both modes only ever use results that are already available, so they
+/// never wait for the GPU and an object is considered visible whenever
+/// nothing is known about it. Objects reappear with one or two frames of
+/// latency, which is why moving objects should not be tested.
+///
+/// HiZ: after the G-buffer pass the depth is reduced (max) into a mip chain,
+/// a small level is read back asynchronously with its view projection.
+/// Boxes are projected with that matrix (reprojection of the old depth) and
+/// compared to the pyramid texels covering them.
+///
+/// Queries: the box of every object tested this frame is drawn against the
+/// G-buffer depth inside an occlusion query; works on any GL 3.2 context.
+///
+class OcclusionCuller
+{
+public:
+	struct Box
+	{
+		glm::vec3 Min;
+		glm::vec3 Max;
+	};
+
+	static constexpr size_t FrameLatency = 3;
+
+private:
+	OcclusionMode _mode = OcclusionMode::Off;
+	size_t _frame = 0;
+
+	// Depth pyramid
+	lazy::graphics::Shader _hizShader;
+	lazy::graphics::UniformHandle<glm::ivec2> _sourceSize{ _hizShader, "sourceSize" };
+	GLuint _pyramid = 0;
+	GLuint _framebuffer = 0;
+	int _width = 0;
+	int _height = 0;
+	int _levels = 0;
+
+	struct Readback
+	{
+		GLuint Buffer = 0;
+		GLsync Fence = nullptr;
+		int Width = 0;
+		int Height = 0;
+		glm::mat4 ViewProjection{1.0f};
+	};
+
+	std::array<Readback, FrameLatency> _readbacks;
+
+	// Last depth available on the CPU and its reductions, level 0 is the read back level
+	std::vector<std::vector<float>> _depth;
+	std::vector<glm::ivec2> _depthSizes;
+	glm::mat4 _depthViewProjection{1.0f};
+
+	// Occlusion queries
+	lazy::graphics::Shader _boxShader;
+	lazy::graphics::UniformHandle<glm::vec3> _boxMin{ _boxShader, "boxMin" };
+	lazy::graphics::UniformHandle<glm::vec3> _boxMax{ _boxShader, "boxMax" };
+	engine::Mesh _box;
+
+	struct QueryObject
+	{
+		std::array<GLuint, FrameLatency> Queries{};
+		std::array<bool, FrameLatency> Issued{};
+		bool Occluded = false;
+		size_t LastFrame = 0;
+		Box Bounds;
+	};
+
+	std::unordered_map<uint64_t, QueryObject> _queries;
+
+	void CreatePyramid(int width, int height);
+	void DeletePyramid();
+	void CollectReadback();
+	void BuildPyramid(GBuffer const &gBuffer, engine::Mesh const &quad, glm::mat4 const &viewProjection,
+		int renderWidth, int renderHeight);
+	bool TestPyramid(Box const &box) const;
+	void IssueQueries(GBuffer const &gBuffer, glm::mat4 const &viewProjection, glm::vec3 const &viewPos);
+
+public:
+	OcclusionCuller();
+	~OcclusionCuller();
+
+	OcclusionCuller(OcclusionCuller const &) = delete;
+	void operator=(OcclusionCuller const &) = delete;
+
+	/// Pick up the results that became available, at the start of the frame
+	void BeginFrame(OcclusionMode mode);
+
+	///
+	/// Whether the object `key` with the world space bounds `box` may be
+	/// visible. In query mode this also schedules a query for the object.
+	///
+	bool IsVisible(uint64_t key, Box const &box);
+
+	///
+	/// Capture the occluders once the G-buffer depth is complete.
+	/// Changes the framebuffer and viewport bindings.
+	///
+	void Render(GBuffer const &gBuffer, engine::Mesh const &quad, glm::mat4 const &viewProjection, glm::vec3 const &viewPos,
+		int renderWidth, int renderHeight, int width, int height);
+};
+
+}
@@ -0,0 +1,379 @@
+#include "RenderGraph.hpp"
+#include "GpuProfiler.hpp"
+#include "Logger.hpp"
+#include "GLState.hpp"
+#include <algorithm>
+#include <cassert>
+
+namespace engine
+{
+
+void RenderGraph::Builder::Read(Resource resource)
+{
+	_graph._passes[_pass].Reads.push_back(resource);
+}
+
+void RenderGraph::Builder::Write(Resource resource)
+{
+	_graph._passes[_pass].Writes.push_back(resource);
+}
+
+void RenderGraph::Builder::Color(Resource resource, LoadOp load)
+{
+	_graph._passes[_pass].Colors.push_back({ resource, load });
+	Write(resource);
+
+	if (load == LoadOp::Load) { Read(resource); }
+}
+
+void RenderGraph::Builder::Depth(Resource resource, LoadOp load)
+{
+	_graph._passes[_pass].Depth = Attachment{ resource, load };
+	Write(resource);
+
+	if (load == LoadOp::Load) { Read(resource); }
+}
+
+void RenderGraph::Builder::BlitFrom(Resource resource)
+{
+	_graph._passes[_pass].BlitSource = resource;
+	Read(resource);
+}
+
+void RenderGraph::Builder::Viewport(int width, int height)
+{
+	_graph._passes[_pass].Viewport = std::pair(width, height);
+}
+
+void RenderGraph::Builder::SideEffect()
+{
+	_graph._passes[_pass].SideEffect = true;
+}
+
+RenderGraph::RenderGraph()
+{
+	_forgetTexture = [this] (GLuint texture) { ForgetTexture(texture); };
+	RenderTargetPool::Instance().OnDelete += _forgetTexture;
+}
+
+RenderGraph::~RenderGraph()
+{
+	RenderTargetPool::Instance().OnDelete -= _forgetTexture;
+
+	for (auto const &[key, framebuffer] : _framebuffers) {
+		GLState::Instance().DeleteFramebuffer(framebuffer.Id);
+	}
+}
+
+RenderGraph::Resource RenderGraph::ImportBackbuffer(int width, int height)
+{
+	ResourceNode node;
+	node.Name = "Backbuffer";
+	node.Desc = { width, height, GL_NONE };
+	node.Imported = true;
+	node.Backbuffer = true;
+
+	_resources.push_back(node);
+	_backbuffer = _resources.size() - 1;
+
+	return _resources.size() - 1;
+}
+
+RenderGraph::Resource RenderGraph::Import(std::string name, GLuint texture, TextureDesc const &desc)
+{
+	ResourceNode node;
+	node.Name = std::move(name);
+	node.Desc = desc;
+	node.Texture = texture;
+	node.Imported = true;
+
+	_resources.push_back(node);
+
+	return _resources.size() - 1;
+}
+
+RenderGraph::Resource RenderGraph::Create(std::string name, TextureDesc const &desc)
+{
+	ResourceNode node;
+	node.Name = std::move(name);
+	node.Desc = desc;
+
+	_resources.push_back(node);
+
+	return _resources.size() - 1;
+}
+
+void RenderGraph::AddPass(std::string name, Setup const &setup, Execution execution)
+{
+	PassNode pass;
+	pass.Name = std::move(name);
+	pass.Run = std::move(execution);
+
+	_passes.push_back(std::move(pass));
+
+	Builder builder(*this, _passes.size() - 1);
+	setup(builder);
+}
+
+///
+/// Walk the passes backwards from the outputs: a pass is needed if it writes
+/// something a later needed pass reads, and then what it reads is needed too
+///
+void RenderGraph::Cull()
+{
+	std::vector<bool> needed(_resources.size(), false);
+
+	for (size_t i = 0; i < _resources.size(); i++) {
+		needed[i] = _resources[i].Backbuffer;
+	}
+
+	_culled.clear();
+
+	for (auto pass = _passes.rbegin(); pass != _passes.rend(); ++pass) {
+		pass->Culled = !pass->SideEffect && std::none_of(pass->Writes.begin(), pass->Writes.end(),
+			[&] (Resource resource) { return needed[resource]; });
+
+		if (pass->Culled) {
+			_culled.push_back(pass->Name);
+			continue ;
+		}
+
+		for (auto resource : pass->Reads) {
+			needed[resource] = true;
+		}
+	}
+
+	std::reverse(_culled.begin(), _culled.end());
+}
+
+void RenderGraph::ComputeLifetimes()
+{
+	for (size_t i = 0; i < _passes.size(); i++) {
+		if (_passes[i].Culled) { continue ; }
+
+		auto use = [&] (Resource resource) {
+			auto &node = _resources[resource];
+
+			if (!node.FirstUse.has_value()) { node.FirstUse = i; }
+			node.LastUse = i;
+		};
+
+		std::for_each(_passes[i].Reads.begin(), _passes[i].Reads.end(), use);
+		std::for_each(_passes[i].Writes.begin(), _passes[i].Writes.end(), use);
+	}
+}
+
+void RenderGraph::Execute()
+{
+	Cull();
+	ComputeLifetimes();
+
+	auto &profiler = GpuProfiler::Instance();
+
+	for (size_t i = 0; i < _passes.size(); i++) {
+		auto const &pass = _passes[i];
+
+		if (pass.Culled) { continue ; }
+
+		for (auto &resource : _resources) {
+			if (!resource.Imported && resource.FirstUse == i) {
+				resource.Texture = RenderTargetPool::Instance().Acquire(resource.Desc);
+			}
+		}
+
+		profiler.Begin(pass.Name.c_str());
+		BindTargets(pass);
+		pass.Run(*this);
+		profiler.End();
+
+		// Storage of the resources that are done is free for the next passes
+		for (auto &resource : _resources) {
+			if (!resource.Imported && resource.FirstUse.has_value() && resource.LastUse == i) {
+				RenderTargetPool::Instance().Release(resource.Texture);
+			}
+		}
+	}
+
+	GLState::Instance().BindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (_backbuffer.has_value()) {
+		auto const &desc = _resources[_backbuffer.value()].Desc;
+		glViewport(0, 0, desc.Width, desc.Height);
+	}
+
+	EvictIdle();
+
+	_resources.clear();
+	_passes.clear();
+	_backbuffer.reset();
+	_frame++;
+}
+
+GLuint RenderGraph::GetTexture(Resource resource) const
+{
+	return _resources[resource].Texture;
+}
+
+void RenderGraph::EvictIdle()
+{
+	for (auto it = _framebuffers.begin(); it != _framebuffers.end();) {
+		if (_frame - it->second.LastUsed > MaxIdleFrames) {
+			GLState::Instance().DeleteFramebuffer(it->second.Id);
+			it = _framebuffers.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+}
+
+///
+/// The pool deletes a texture: drop the framebuffers it is attached to
+/// before its name is given to another texture
+///
+void RenderGraph::ForgetTexture(GLuint texture)
+{
+	for (auto it = _framebuffers.begin(); it != _framebuffers.end();) {
+		auto const &[colors, depth] = it->first;
+
+		if (depth == texture || std::find(colors.begin(), colors.end(), texture) != colors.end()) {
+			GLState::Instance().DeleteFramebuffer(it->second.Id);
+			it = _framebuffers.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+}
+
+GLuint RenderGraph::GetFramebuffer(std::vector<Resource> const &colors, std::optional<Resource> depth)
+{
+	FramebufferKey key;
+
+	for (auto color : colors) {
+		key.first.push_back(_resources[color].Texture);
+	}
+	key.second = depth.has_value() ? _resources[depth.value()].Texture : 0;
+
+	auto cached = _framebuffers.find(key);
+
+	if (cached != _framebuffers.end()) {
+		cached->second.LastUsed = _frame;
+		return cached->second.Id;
+	}
+
+	GLuint framebuffer;
+
+	glGenFramebuffers(1, &framebuffer);
+	GLState::Instance().BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	std::vector<GLenum> drawBuffers;
+
+	for (size_t i = 0; i < colors.size(); i++) {
+		auto const &desc = _resources[colors[i]].Desc;
+
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, RenderTargetPool::GetTextureTarget(desc),
+			key.first[i], 0);
+		drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+	}
+
+	if (depth.has_value()) {
+		auto const &desc = _resources[depth.value()].Desc;
+
+		glFramebufferTexture2D(GL_FRAMEBUFFER, RenderTargetPool::GetAttachment(desc.InternalFormat),
+			RenderTargetPool::GetTextureTarget(desc), key.second, 0);
+	}
+
+	if (drawBuffers.empty()) {
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+	}
+	else {
+		glDrawBuffers(drawBuffers.size(), drawBuffers.data());
+	}
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		Logger::Error("RenderGraph: incomplete framebuffer with {} color attachments\n", colors.size());
+	}
+
+	GLState::Instance().BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	_framebuffers[key] = { framebuffer, _frame };
+
+	return framebuffer;
+}
+
+void RenderGraph::BindTargets(PassNode const &pass)
+{
+	std::vector<Resource> colors;
+	std::optional<Resource> depth;
+	bool backbuffer = false;
+
+	for (auto const &attachment : pass.Colors) {
+		colors.push_back(attachment.Target);
+		backbuffer = backbuffer || _resources[attachment.Target].Backbuffer;
+	}
+	if (pass.Depth.has_value()) {
+		depth = pass.Depth->Target;
+		backbuffer = backbuffer || _resources[depth.value()].Backbuffer;
+	}
+
+	bool attached = !colors.empty() || depth.has_value();
+
+	// The default framebuffer cannot be combined with textures
+	assert(!backbuffer || std::all_of(colors.begin(), colors.end(),
+		[&] (Resource resource) { return _resources[resource].Backbuffer; }));
+	assert(!backbuffer || !depth.has_value() || _resources[depth.value()].Backbuffer);
+
+	// Looked up first: creating a framebuffer changes the binding
+	std::optional<GLuint> blitSource;
+
+	if (pass.BlitSource.has_value()) {
+		auto const &source = _resources[pass.BlitSource.value()];
+
+		if (source.Backbuffer) {
+			blitSource = 0;
+		}
+		else if (RenderTargetPool::IsDepthFormat(source.Desc.InternalFormat)) {
+			blitSource = GetFramebuffer({}, pass.BlitSource);
+		}
+		else {
+			blitSource = GetFramebuffer({ pass.BlitSource.value() }, std::nullopt);
+		}
+	}
+
+	GLuint framebuffer = (attached && !backbuffer) ? GetFramebuffer(colors, depth) : 0;
+
+	GLState::Instance().BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	if (blitSource.has_value()) {
+		GLState::Instance().BindFramebuffer(GL_READ_FRAMEBUFFER, blitSource.value());
+	}
+
+	std::optional<std::pair<int, int>> size = pass.Viewport;
+
+	if (!size.has_value() && attached) {
+		auto const &desc = _resources[colors.empty() ? depth.value() : colors.front()].Desc;
+		size = std::pair(desc.Width, desc.Height);
+	}
+	if (!size.has_value() && _backbuffer.has_value()) {
+		auto const &desc = _resources[_backbuffer.value()].Desc;
+		size = std::pair(desc.Width, desc.Height);
+	}
+	if (size.has_value()) {
+		glViewport(0, 0, size->first, size->second);
+	}
+
+	static GLfloat const black[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	static GLfloat const far = 1.0f;
+
+	for (size_t i = 0; i < pass.Colors.size(); i++) {
+		if (pass.Colors[i].Load == LoadOp::Clear) {
+			glClearBufferfv(GL_COLOR, backbuffer ? 0 : i, black);
+		}
+	}
+	if (pass.Depth.has_value() && pass.Depth->Load == LoadOp::Clear) {
+		glClearBufferfv(GL_DEPTH, 0, &far);
+	}
+}
+
+}
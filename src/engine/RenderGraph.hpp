@@ -0,0 +1,176 @@
+#pragma once
+
+#include "lazy.hpp"
+#include "RenderTargetPool.hpp"
+#include "Callback.hpp"
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace engine
+{
+
+///
+/// Frame graph of the render passes.
+///
+/// Every frame the passes are added in execution order, each one declaring
+/// the resources it reads and the ones it writes, then Execute() runs them:
+///
+///   - Passes whose outputs are never read, directly or through other
+///     passes, by the backbuffer or by a pass with side effects are culled.
+///   - Transient textures are only given storage between their first and
+///     last use, taken from the RenderTargetPool. Textures of equal
+///     description whose lifetimes do not overlap share the same storage.
+///   - Before a pass runs, the framebuffer of its attachments is bound (and
+///     built the first time), the viewport is set and the attachments are
+///     cleared if asked. A pass without attachments starts on the default
+///     framebuffer and is free to bind its own.
+///   - Every pass is timed by the GpuProfiler under its name.
+///
+class RenderGraph
+{
+public:
+	using Resource = size_t;
+
+	using TextureDesc = RenderTargetDesc;
+
+	/// What an attachment holds when its pass starts
+	enum class LoadOp
+	{
+		/// Cleared to black (color) or to the far plane (depth)
+		Clear,
+		/// Previous contents, which makes the attachment an input of the pass
+		Load,
+		/// Undefined, the pass overwrites every pixel it uses
+		DontCare,
+	};
+
+	///
+	/// Given to the setup function of a pass to declare what it uses
+	///
+	class Builder
+	{
+	public:
+		/// Sampled by the pass
+		void Read(Resource resource);
+		/// Written by the pass through a framebuffer it binds itself
+		void Write(Resource resource);
+		/// Next color attachment of the pass framebuffer
+		void Color(Resource resource, LoadOp load = LoadOp::Clear);
+		/// Depth attachment of the pass framebuffer
+		void Depth(Resource resource, LoadOp load = LoadOp::Clear);
+		/// Bound as the read framebuffer, for glBlitFramebuffer
+		void BlitFrom(Resource resource);
+		/// Viewport of the pass, the size of its attachments otherwise
+		void Viewport(int width, int height);
+		/// Never culled, e.g. it reads back results for the next frame
+		void SideEffect();
+
+	private:
+		friend class RenderGraph;
+
+		Builder(RenderGraph &graph, size_t pass) : _graph(graph), _pass(pass) {}
+
+		RenderGraph &_graph;
+		size_t _pass;
+	};
+
+	using Setup = std::function<void(Builder &)>;
+	using Execution = std::function<void(RenderGraph const &)>;
+
+	RenderGraph();
+	~RenderGraph();
+
+	RenderGraph(RenderGraph const &) = delete;
+	void operator=(RenderGraph const &) = delete;
+
+	/// The default framebuffer, the final output of the graph
+	Resource ImportBackbuffer(int width, int height);
+
+	/// Texture owned outside of the graph, it lives across frames
+	Resource Import(std::string name, GLuint texture, TextureDesc const &desc);
+
+	/// Texture only valid during this frame
+	Resource Create(std::string name, TextureDesc const &desc);
+
+	void AddPass(std::string name, Setup const &setup, Execution execution);
+
+	/// Cull, allocate and run the passes added since the last call
+	void Execute();
+
+	/// Texture of a resource, only valid while a pass using it runs
+	GLuint GetTexture(Resource resource) const;
+
+	/// Passes culled by the last Execute()
+	std::vector<std::string> const &GetCulledPasses() const { return _culled; }
+
+private:
+	/// Frames a framebuffer stays allocated without being used
+	static constexpr size_t MaxIdleFrames = 120;
+
+	struct ResourceNode
+	{
+		std::string Name;
+		TextureDesc Desc;
+		GLuint Texture = 0;
+		bool Imported = false;
+		bool Backbuffer = false;
+
+		// Live passes using it, first and last
+		std::optional<size_t> FirstUse;
+		size_t LastUse = 0;
+	};
+
+	struct Attachment
+	{
+		Resource Target;
+		LoadOp Load;
+	};
+
+	struct PassNode
+	{
+		std::string Name;
+		std::vector<Resource> Reads;
+		std::vector<Resource> Writes;
+		std::vector<Attachment> Colors;
+		std::optional<Attachment> Depth;
+		std::optional<Resource> BlitSource;
+		std::optional<std::pair<int, int>> Viewport;
+		bool SideEffect = false;
+		bool Culled = false;
+		Execution Run;
+	};
+
+	/// Color textures and depth texture (0 for none) of a framebuffer
+	using FramebufferKey = std::pair<std::vector<GLuint>, GLuint>;
+
+	struct CachedFramebuffer
+	{
+		GLuint Id;
+		size_t LastUsed;
+	};
+
+	std::vector<ResourceNode> _resources;
+	std::vector<PassNode> _passes;
+	std::vector<std::string> _culled;
+	std::optional<Resource> _backbuffer;
+
+	std::map<FramebufferKey, CachedFramebuffer> _framebuffers;
+	size_t _frame = 0;
+
+	Callback<GLuint> _forgetTexture;
+
+	void Cull();
+	void ComputeLifetimes();
+
+	void EvictIdle();
+	void ForgetTexture(GLuint texture);
+
+	GLuint GetFramebuffer(std::vector<Resource> const &colors, std::optional<Resource> depth);
+	void BindTargets(PassNode const &pass);
+};
+
+}
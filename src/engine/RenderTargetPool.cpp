@@ -0,0 +1,134 @@
+#include "RenderTargetPool.hpp"
+#include "Logger.hpp"
+#include "GLState.hpp"
+#include <algorithm>
+
+namespace engine
+{
+
+GLuint RenderTargetPool::Acquire(RenderTargetDesc const &desc)
+{
+	auto free = std::find_if(_targets.begin(), _targets.end(),
+		[&] (Target const &target) { return target.Free && target.Desc == desc; });
+
+	if (free != _targets.end()) {
+		free->Free = false;
+		free->LastUsed = _frame;
+		return free->Texture;
+	}
+
+	GLuint texture = Create(desc);
+
+	_targets.push_back({ desc, texture, false, _frame });
+
+	return texture;
+}
+
+void RenderTargetPool::Release(GLuint texture)
+{
+	auto target = std::find_if(_targets.begin(), _targets.end(),
+		[&] (Target const &t) { return t.Texture == texture; });
+
+	if (target == _targets.end()) {
+		Logger::Warn("RenderTargetPool: texture {} was not acquired from the pool\n", texture);
+		return ;
+	}
+
+	target->Free = true;
+	target->LastUsed = _frame;
+}
+
+void RenderTargetPool::BeginFrame()
+{
+	_frame++;
+
+	for (auto it = _targets.begin(); it != _targets.end();) {
+		if (!it->Free || _frame - it->LastUsed <= MaxIdleFrames) {
+			++it;
+			continue ;
+		}
+
+		GLuint texture = it->Texture;
+
+		OnDelete(texture);
+		GLState::Instance().DeleteTexture(texture);
+
+		it = _targets.erase(it);
+	}
+}
+
+GLuint RenderTargetPool::Create(RenderTargetDesc const &desc)
+{
+	GLuint texture;
+	GLenum target = GetTextureTarget(desc);
+
+	glGenTextures(1, &texture);
+	GLState::Instance().BindTexture(target, texture);
+
+	if (target == GL_TEXTURE_2D_MULTISAMPLE) {
+		glTexImage2DMultisample(target, desc.Samples, desc.InternalFormat, desc.Width, desc.Height, GL_TRUE);
+	}
+	else {
+		// Any format and type matching the internal format, nothing is uploaded
+		GLenum format = GL_RGBA;
+		GLenum type = GL_UNSIGNED_BYTE;
+
+		if (desc.InternalFormat == GL_DEPTH24_STENCIL8) {
+			format = GL_DEPTH_STENCIL;
+			type = GL_UNSIGNED_INT_24_8;
+		}
+		else if (desc.InternalFormat == GL_DEPTH32F_STENCIL8) {
+			format = GL_DEPTH_STENCIL;
+			type = GL_FLOAT_32_UNSIGNED_INT_24_8_REV;
+		}
+		else if (IsDepthFormat(desc.InternalFormat)) {
+			format = GL_DEPTH_COMPONENT;
+			type = GL_FLOAT;
+		}
+
+		glTexImage2D(target, 0, desc.InternalFormat, desc.Width, desc.Height, 0, format, type, nullptr);
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	GLState::Instance().BindTexture(target, 0);
+
+	return texture;
+}
+
+GLenum RenderTargetPool::GetTextureTarget(RenderTargetDesc const &desc)
+{
+	return desc.Samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+}
+
+bool RenderTargetPool::IsDepthFormat(GLenum internalFormat)
+{
+	switch (internalFormat) {
+	case GL_DEPTH_COMPONENT16:
+	case GL_DEPTH_COMPONENT24:
+	case GL_DEPTH_COMPONENT32:
+	case GL_DEPTH_COMPONENT32F:
+	case GL_DEPTH24_STENCIL8:
+	case GL_DEPTH32F_STENCIL8:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool RenderTargetPool::HasStencil(GLenum internalFormat)
+{
+	return internalFormat == GL_DEPTH24_STENCIL8 || internalFormat == GL_DEPTH32F_STENCIL8;
+}
+
+GLenum RenderTargetPool::GetAttachment(GLenum internalFormat, size_t colorIndex)
+{
+	if (HasStencil(internalFormat)) { return GL_DEPTH_STENCIL_ATTACHMENT; }
+	if (IsDepthFormat(internalFormat)) { return GL_DEPTH_ATTACHMENT; }
+
+	return GL_COLOR_ATTACHMENT0 + colorIndex;
+}
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "lazy.hpp"
+#include "Action.hpp"
+#include <vector>
+
+namespace engine
+{
+
+struct RenderTargetDesc
+{
+	int Width = 0;
+	int Height = 0;
+	GLenum InternalFormat = GL_NONE;
+	/// More than one for a GL_TEXTURE_2D_MULTISAMPLE
+	int Samples = 1;
+
+	bool operator==(RenderTargetDesc const &other) const
+	{
+		return Width == other.Width && Height == other.Height
+			&& InternalFormat == other.InternalFormat && Samples == other.Samples;
+	}
+};
+
+///
+/// Textures used as render targets, recycled by format, size and sample count.
+///
+/// Acquire() hands out a free texture of the same description or creates
+/// one, Release() gives it back. Targets left free for MaxIdleFrames frames
+/// are deleted, e.g. the ones of the previous window size after a resize.
+/// OnDelete is raised before, so that the framebuffers they are attached to
+/// can be forgotten: the name of a deleted texture may be given to a new one.
+///
+class RenderTargetPool
+{
+public:
+	static constexpr size_t MaxIdleFrames = 120;
+
+	/// Texture about to be deleted
+	Action<GLuint> OnDelete;
+
+private:
+	struct Target
+	{
+		RenderTargetDesc Desc;
+		GLuint Texture;
+		bool Free;
+		size_t LastUsed;
+	};
+
+	std::vector<Target> _targets;
+	size_t _frame = 0;
+
+	RenderTargetPool() = default;
+
+	GLuint Create(RenderTargetDesc const &desc);
+
+public:
+	RenderTargetPool(RenderTargetPool const &) = delete;
+	void operator=(RenderTargetPool const &) = delete;
+
+	/// Never destroyed, the GBuffer, framebuffers and render graphs of the
+	/// scene give their targets back from the destructor of the Engine.
+	/// The textures left go away with the GL context.
+	static RenderTargetPool &Instance()
+	{
+		static RenderTargetPool *pool = new RenderTargetPool();
+		return *pool;
+	}
+
+	GLuint Acquire(RenderTargetDesc const &desc);
+	void Release(GLuint texture);
+
+	/// Delete the targets that stayed free too long
+	void BeginFrame();
+
+	size_t GetTargetCount() const { return _targets.size(); }
+
+	/// GL_TEXTURE_2D, or GL_TEXTURE_2D_MULTISAMPLE when it has samples
+	static GLenum GetTextureTarget(RenderTargetDesc const &desc);
+
+	static bool IsDepthFormat(GLenum internalFormat);
+	static bool HasStencil(GLenum internalFormat);
+
+	/// Attachment point of a target of this format
+	static GLenum GetAttachment(GLenum internalFormat, size_t colorIndex = 0);
+};
+
+}
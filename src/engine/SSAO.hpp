@@ -0,0 +1,201 @@
+#pragma once
+
+#include "lazy.hpp"
+#include "GLState.hpp"
+#include "Mesh.hpp"
+#include <random>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+///
+/// Screen space ambient occlusion computed at a fraction of the screen
+/// resolution. Both passes write RG16F: r is the occlusion, g the linear
+/// view depth of the texel so that the blur and the upsample done in the
+/// lighting pass can reject samples across depth discontinuities.
+/// The targets are transient textures of the render graph.
+///
+class SSAO
+{
+public:
+	static constexpr int MaxSamples = 64;
+
+private:
+	lazy::graphics::Shader _ssaoShader;
+	lazy::graphics::Shader _blurShader;
+
+	/// The whole kernel, uploaded in one call
+	lazy::graphics::UniformHandle<glm::vec3> _kernel{ _ssaoShader, "samples" };
+
+	GLuint _noiseTex = 0;
+
+	int _samples = 0;
+
+	// View space radius of the sampled hemisphere and depth bias
+	static constexpr float Radius = 15.0f;
+	static constexpr float Bias = 0.5f;
+
+	std::default_random_engine _generator;
+
+	void InitNoise()
+	{
+		std::uniform_real_distribution<float> randomFloats(0.0f, 1.0f);
+		std::array<glm::vec3, 16> noise;
+
+		for (auto &n : noise) {
+			n = glm::vec3(randomFloats(_generator) * 2.0f - 1.0f,
+						  randomFloats(_generator) * 2.0f - 1.0f,
+						  0.0f);
+		}
+
+		glGenTextures(1, &_noiseTex);
+		engine::GLState::Instance().BindTexture(GL_TEXTURE_2D, _noiseTex);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, 4, 4, 0, GL_RGB, GL_FLOAT, noise.data());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		engine::GLState::Instance().BindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	///
+	/// Hemisphere kernel with more samples close to the origin.
+	/// The distribution depends on the sample count so it is rebuilt when it changes.
+	///
+	void GenKernel(int samples)
+	{
+		std::uniform_real_distribution<float> randomFloats(0.0f, 1.0f);
+		std::vector<glm::vec3> kernel;
+
+		auto lerp = [] (float a, float b, float f) -> float {
+			return a + f * (b - a);
+		};
+
+		_generator.seed(0);
+
+		for (int i = 0; i < samples; i++) {
+			glm::vec3 sample(randomFloats(_generator) * 2.0f - 1.0f,
+							 randomFloats(_generator) * 2.0f - 1.0f,
+							 randomFloats(_generator));
+			sample = glm::normalize(sample);
+			sample *= randomFloats(_generator);
+
+			float scale = static_cast<float>(i) / static_cast<float>(samples);
+			scale = lerp(0.1f, 1.0f, scale * scale);
+			sample *= scale;
+
+			kernel.push_back(sample);
+		}
+
+		_ssaoShader.bind();
+		_kernel.set(kernel);
+		_ssaoShader.setUniform1i("kernelSize", samples);
+		_ssaoShader.unbind();
+
+		_samples = samples;
+	}
+
+public:
+	SSAO()
+	{
+		_ssaoShader.addVertexShader("shaders/ssao.vs.glsl")
+			.addFragmentShader("shaders/ssao.fs.glsl")
+			.link();
+
+		_ssaoShader.bind();
+		_ssaoShader.setUniform1i("gDepth", 0);
+		_ssaoShader.setUniform1i("gNormal", 1);
+		_ssaoShader.setUniform1i("texNoise", 2);
+		_ssaoShader.setUniform1f("radius", Radius);
+		_ssaoShader.setUniform1f("bias", Bias);
+		_ssaoShader.unbind();
+
+		_blurShader.addVertexShader("shaders/ssao.vs.glsl")
+			.addFragmentShader("shaders/ssaoblur.fs.glsl")
+			.link();
+
+		_blurShader.bind();
+		_blurShader.setUniform1i("ssaoInput", 0);
+		_blurShader.unbind();
+
+		InitNoise();
+	}
+
+	~SSAO()
+	{
+		if (_noiseTex) { engine::GLState::Instance().DeleteTexture(_noiseTex); }
+	}
+
+	SSAO(SSAO const &) = delete;
+	void operator=(SSAO const &) = delete;
+
+	///
+	/// Size of the occlusion targets for a screen size and resolution divisor
+	/// (2: half resolution, 4: quarter resolution), both of format RG16F
+	///
+	static glm::ivec2 GetTargetSize(int screenWidth, int screenHeight, int divisor)
+	{
+		divisor = std::max(divisor, 1);
+
+		return glm::ivec2(std::max(screenWidth / divisor, 1), std::max(screenHeight / divisor, 1));
+	}
+
+	///
+	/// Rebuild the kernel for a sample count, does nothing if it did not change
+	///
+	void Configure(int samples)
+	{
+		samples = std::clamp(samples, 1, MaxSamples);
+
+		if (samples != _samples) {
+			GenKernel(samples);
+		}
+	}
+
+	///
+	/// Compute the occlusion from the G-buffer textures into the bound
+	/// framebuffer, a target of `size`. `scale` is the fraction of the
+	/// G-buffer the frame was rendered to, only the same fraction of the
+	/// target is written.
+	///
+	void RenderOcclusion(GLuint depth, GLuint normal, glm::ivec2 size, engine::Mesh &quad,
+		glm::mat4 const &projection, glm::mat4 const &view, float scale = 1.0f)
+	{
+		SetViewport(size, scale);
+
+		_ssaoShader.bind();
+		_ssaoShader.setUniform4x4f("projectionMatrix", projection);
+		_ssaoShader.setUniform4x4f("invProjectionMatrix", glm::inverse(projection));
+		_ssaoShader.setUniform4x4f("viewMatrix", view);
+		_ssaoShader.setUniform3f("noiseScale", glm::vec3(size.x / 4.0f, size.y / 4.0f, 0.0f));
+		_ssaoShader.setUniform1f("uvScale", scale);
+
+		engine::GLState::Instance().BindTexture(GL_TEXTURE0, GL_TEXTURE_2D, depth);
+		engine::GLState::Instance().BindTexture(GL_TEXTURE1, GL_TEXTURE_2D, normal);
+		engine::GLState::Instance().BindTexture(GL_TEXTURE2, GL_TEXTURE_2D, _noiseTex);
+
+		quad.Draw();
+	}
+
+	///
+	/// Depth aware blur of the output of RenderOcclusion() into the bound
+	/// framebuffer, a target of the same size
+	///
+	void RenderBlur(GLuint occlusion, glm::ivec2 size, engine::Mesh &quad, float scale = 1.0f)
+	{
+		SetViewport(size, scale);
+
+		_blurShader.bind();
+		_blurShader.setUniform1f("uvScale", scale);
+
+		engine::GLState::Instance().BindTexture(GL_TEXTURE0, GL_TEXTURE_2D, occlusion);
+
+		quad.Draw();
+	}
+
+private:
+	void SetViewport(glm::ivec2 size, float scale)
+	{
+		glViewport(0, 0, std::max(static_cast<int>(size.x * scale), 1), std::max(static_cast<int>(size.y * scale), 1));
+	}
+};
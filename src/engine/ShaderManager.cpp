@@ -0,0 +1,422 @@
+#include "ShaderManager.hpp"
+#include "Logger.hpp"
+#include "utils/Settings.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <fmt/format.h>
+
+namespace
+{
+
+constexpr char BinaryMagic[4] = { 'L', 'G', 'P', 'B' };
+
+/// FNV-1a
+uint64_t HashBytes(uint64_t hash, void const *data, size_t size)
+{
+	auto const *bytes = static_cast<unsigned char const *>(data);
+
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+constexpr uint64_t HashSeed = 14695981039346656037ull;
+
+std::string GetString(GLenum name)
+{
+	auto const *string = glGetString(name);
+
+	return string ? reinterpret_cast<char const *>(string) : "";
+}
+
+std::string GetInfoLog(GLuint object, bool program)
+{
+	GLint length = 0;
+
+	if (program) { glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length); }
+	else { glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length); }
+
+	if (length <= 0) { return ""; }
+
+	std::vector<GLchar> log(length);
+
+	if (program) { glGetProgramInfoLog(object, length, &length, log.data()); }
+	else { glGetShaderInfoLog(object, length, &length, log.data()); }
+
+	return std::string(log.data(), length);
+}
+
+}
+
+void ShaderManager::Init()
+{
+	_cacheDirectory = std::any_cast<std::string>(Settings::instance().get("shaderCache"));
+	_driver = GetString(GL_VENDOR) + " " + GetString(GL_RENDERER) + " " + GetString(GL_VERSION);
+
+	GLint binaryFormats = 0;
+
+	if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary) {
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+	}
+	_binarySupported = binaryFormats > 0;
+
+	// Older GLEW headers do not know the extension
+#ifdef GL_KHR_parallel_shader_compile
+	_parallelCompile = GLEW_KHR_parallel_shader_compile;
+	if (_parallelCompile) {
+		// Let the driver pick the number of threads
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	}
+#else
+	_parallelCompile = false;
+#endif
+
+	if (!_cacheDirectory.empty()) {
+		std::error_code error;
+
+		std::filesystem::create_directories(_cacheDirectory, error);
+		if (error) {
+			Logger::Warn("ShaderManager: cannot create {}, shaders will not be cached\n", _cacheDirectory);
+			_cacheDirectory.clear();
+		}
+	}
+
+	lazy::graphics::Shader::setProgramProvider(this);
+
+	Logger::Info("ShaderManager: program binaries {}, parallel compile {}\n",
+		_binarySupported ? "on" : "off", _parallelCompile ? "on" : "off");
+
+	Prewarm();
+}
+
+uint64_t ShaderManager::GetKey(std::vector<Stage> const &stages) const
+{
+	uint64_t hash = HashBytes(HashSeed, _driver.data(), _driver.size());
+
+	for (auto const &stage : stages) {
+		hash = HashBytes(hash, &stage.type, sizeof(stage.type));
+		hash = HashBytes(hash, stage.source.data(), stage.source.size() + 1);
+	}
+
+	return hash;
+}
+
+std::string ShaderManager::GetBinaryPath(uint64_t key) const
+{
+	return fmt::format("{}/{:016x}.bin", _cacheDirectory, key);
+}
+
+std::string ShaderManager::GetManifestPath() const
+{
+	return _cacheDirectory + "/programs.txt";
+}
+
+GLuint ShaderManager::createProgram(std::vector<Stage> const &stages)
+{
+	auto key = GetKey(stages);
+
+	auto prewarmed = _prewarmed.find(key);
+	if (prewarmed != _prewarmed.end()) {
+		GLuint program = prewarmed->second;
+		_prewarmed.erase(prewarmed);
+		return program;
+	}
+
+	// The same sources are still linking, wait for them to get the binary
+	for (auto const &[program, pending] : _pending) {
+		if (pending.Key == key) {
+			GLuint linking = program;
+			finishProgram(linking);
+			break ;
+		}
+	}
+
+	GLuint program = LoadBinary(key);
+
+	if (program) { return program; }
+
+	AddToManifest(stages);
+
+	return Link(key, stages);
+}
+
+bool ShaderManager::finishProgram(GLuint program)
+{
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+
+	auto pending = _pending.find(program);
+
+	// Loaded from a binary, already checked
+	if (pending == _pending.end()) { return status == GL_TRUE; }
+
+	auto link = std::move(pending->second);
+	_pending.erase(pending);
+
+	if (status == GL_FALSE) {
+		for (auto hash : link.Stages) {
+			GLuint stage = _compiled.at(hash).Shader;
+			GLint compiled = GL_FALSE;
+			glGetShaderiv(stage, GL_COMPILE_STATUS, &compiled);
+
+			if (compiled == GL_FALSE) {
+				Logger::Error("Shader error:\n{}\n", GetInfoLog(stage, false));
+			}
+		}
+		Logger::Error("Shader link error:\n{}\n", GetInfoLog(program, true));
+	}
+	else {
+		SaveBinary(link.Key, program);
+	}
+
+	ReleaseStages(program, link);
+
+	return status == GL_TRUE;
+}
+
+void ShaderManager::ReleasePrewarmed()
+{
+	for (auto const &[key, program] : _prewarmed) {
+		auto pending = _pending.find(program);
+
+		// Deleting a program that is still linking is fine, GL waits for it
+		if (pending != _pending.end()) {
+			ReleaseStages(program, pending->second);
+			_pending.erase(pending);
+		}
+		glDeleteProgram(program);
+	}
+
+	if (!_prewarmed.empty()) {
+		Logger::Info("ShaderManager: {} prewarmed programs were not used\n", _prewarmed.size());
+	}
+
+	_prewarmed.clear();
+}
+
+uint64_t ShaderManager::Compile(Stage const &stage)
+{
+	uint64_t hash = HashBytes(HashSeed, &stage.type, sizeof(stage.type));
+	hash = HashBytes(hash, stage.source.data(), stage.source.size());
+
+	auto compiled = _compiled.find(hash);
+
+	if (compiled != _compiled.end()) {
+		compiled->second.Links++;
+		return hash;
+	}
+
+	GLuint shader = glCreateShader(stage.type);
+	char const *source = stage.source.c_str();
+
+	glShaderSource(shader, 1, &source, nullptr);
+	// The status is read by finishProgram() if the link fails
+	glCompileShader(shader);
+
+	_compiled[hash] = CompiledStage{ shader, 1 };
+
+	return hash;
+}
+
+void ShaderManager::ReleaseStages(GLuint program, PendingLink const &link)
+{
+	for (auto hash : link.Stages) {
+		auto &stage = _compiled.at(hash);
+
+		glDetachShader(program, stage.Shader);
+
+		if (--stage.Links == 0) {
+			glDeleteShader(stage.Shader);
+			_compiled.erase(hash);
+		}
+	}
+}
+
+GLuint ShaderManager::Link(uint64_t key, std::vector<Stage> const &stages)
+{
+	GLuint program = glCreateProgram();
+	PendingLink link = { key, {} };
+
+	for (auto const &stage : stages) {
+		uint64_t hash = Compile(stage);
+
+		glAttachShader(program, _compiled.at(hash).Shader);
+		link.Stages.push_back(hash);
+	}
+
+	if (_binarySupported) {
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	glLinkProgram(program);
+
+	_pending[program] = std::move(link);
+	_linkCount++;
+
+	return program;
+}
+
+bool ShaderManager::HasBinary(uint64_t key) const
+{
+	if (!_binarySupported) { return false; }
+	if (_binaries.count(key)) { return true; }
+
+	return !_cacheDirectory.empty() && std::filesystem::exists(GetBinaryPath(key));
+}
+
+GLuint ShaderManager::LoadBinary(uint64_t key)
+{
+	if (!_binarySupported) { return 0; }
+
+	auto binary = _binaries.find(key);
+
+	if (binary == _binaries.end() && !_cacheDirectory.empty()) {
+		std::ifstream file(GetBinaryPath(key), std::ios::binary);
+		char magic[4];
+		uint32_t driverLength = 0;
+		uint32_t format = 0;
+		uint32_t size = 0;
+
+		if (!file.read(magic, sizeof(magic)) || !std::equal(magic, magic + 4, BinaryMagic)) { return 0; }
+		if (!file.read(reinterpret_cast<char *>(&driverLength), sizeof(driverLength))) { return 0; }
+
+		std::string driver(driverLength, '\0');
+
+		if (!file.read(driver.data(), driverLength) || driver != _driver) { return 0; }
+		if (!file.read(reinterpret_cast<char *>(&format), sizeof(format))) { return 0; }
+		if (!file.read(reinterpret_cast<char *>(&size), sizeof(size))) { return 0; }
+
+		Binary loaded = { format, std::vector<char>(size) };
+
+		if (!file.read(loaded.Data.data(), size)) { return 0; }
+
+		binary = _binaries.emplace(key, std::move(loaded)).first;
+	}
+
+	if (binary == _binaries.end()) { return 0; }
+
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, binary->second.Format, binary->second.Data.data(), binary->second.Data.size());
+
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+
+	// Rejected by the driver, e.g. after an update that kept the same version string
+	if (status == GL_FALSE) {
+		glDeleteProgram(program);
+		_binaries.erase(binary);
+		if (!_cacheDirectory.empty()) {
+			std::error_code error;
+			std::filesystem::remove(GetBinaryPath(key), error);
+		}
+		return 0;
+	}
+
+	_binaryLoadCount++;
+
+	return program;
+}
+
+void ShaderManager::SaveBinary(uint64_t key, GLuint program)
+{
+	if (!_binarySupported || _binaries.count(key)) { return ; }
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+
+	if (length <= 0) { return ; }
+
+	Binary binary = { GL_NONE, std::vector<char>(length) };
+	glGetProgramBinary(program, length, &length, &binary.Format, binary.Data.data());
+	binary.Data.resize(length);
+
+	if (!_cacheDirectory.empty()) {
+		std::ofstream file(GetBinaryPath(key), std::ios::binary | std::ios::trunc);
+		uint32_t driverLength = _driver.size();
+		uint32_t format = binary.Format;
+		uint32_t size = binary.Data.size();
+
+		file.write(BinaryMagic, sizeof(BinaryMagic));
+		file.write(reinterpret_cast<char const *>(&driverLength), sizeof(driverLength));
+		file.write(_driver.data(), driverLength);
+		file.write(reinterpret_cast<char const *>(&format), sizeof(format));
+		file.write(reinterpret_cast<char const *>(&size), sizeof(size));
+		file.write(binary.Data.data(), size);
+
+		if (!file) {
+			Logger::Warn("ShaderManager: could not write {}\n", GetBinaryPath(key));
+		}
+	}
+
+	_binaries[key] = std::move(binary);
+}
+
+///
+/// Issue the links of the programs used by the previous runs that have no
+/// binary (first run after a driver update, or no binary support), so that
+/// they compile in parallel instead of one after the other
+///
+void ShaderManager::Prewarm()
+{
+	if (_cacheDirectory.empty()) { return ; }
+
+	std::ifstream manifest(GetManifestPath());
+	std::string line;
+
+	while (std::getline(manifest, line)) {
+		std::istringstream stream(line);
+		std::vector<Stage> stages;
+		GLenum type;
+		std::string path;
+
+		while (stream >> type >> path) {
+			if (!std::filesystem::exists(path)) {
+				stages.clear();
+				break ;
+			}
+			stages.push_back({ type, path, lazy::utils::LoadShader(path) });
+		}
+
+		if (stages.empty()) { continue ; }
+
+		auto key = GetKey(stages);
+
+		_manifest.insert(GetManifestLine(stages));
+
+		if (_prewarmed.count(key) || HasBinary(key)) { continue ; }
+
+		_prewarmed[key] = Link(key, stages);
+	}
+
+	if (!_prewarmed.empty()) {
+		Logger::Info("ShaderManager: {} programs compiling in the background\n", _prewarmed.size());
+	}
+}
+
+std::string ShaderManager::GetManifestLine(std::vector<Stage> const &stages)
+{
+	std::string line;
+
+	for (auto const &stage : stages) {
+		line += fmt::format("{}{} {}", line.empty() ? "" : " ", stage.type, stage.path);
+	}
+
+	return line;
+}
+
+void ShaderManager::AddToManifest(std::vector<Stage> const &stages)
+{
+	auto line = GetManifestLine(stages);
+
+	if (_cacheDirectory.empty() || _manifest.count(line)) { return ; }
+
+	std::ofstream manifest(GetManifestPath(), std::ios::app);
+	manifest << line << "\n";
+
+	_manifest.insert(line);
+}
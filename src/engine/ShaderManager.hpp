@@ -1,10 +1,33 @@
 #pragma once
 
 #include "lazy.hpp"
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
-class ShaderManager
+///
+/// Owns the shaders created by the scenes and, once Init() is called,
+/// builds the program of every lazy::graphics::Shader:
+///
+///   - Each stage source is compiled once, each set of stages linked once.
+///     Other shaders with the same sources get a copy of the program through
+///     its binary, or are linked from the already compiled stages when
+///     program binaries are not supported.
+///   - Linked programs are saved with glGetProgramBinary in the shaderCache
+///     directory, keyed by a hash of their sources and of the driver, and
+///     loaded with glProgramBinary on the next runs.
+///   - Links are issued without waiting: the status is only checked when a
+///     shader is first used, so with GL_KHR_parallel_shader_compile the
+///     driver compiles on its own threads in the meantime. The stages of
+///     the previous runs are listed in a manifest and the ones missing from
+///     the binary cache are all issued at once by Init(), the ones no
+///     Shader asked for are deleted by ReleasePrewarmed().
+///   - Stages are deleted once the last link using them is checked.
+///
+class ShaderManager : public lazy::graphics::Shader::ProgramProvider
 {
 public:
 	static ShaderManager &instance() {
@@ -40,11 +63,88 @@ public:
 		_shaders.erase(id);
 	}
 
+	///
+	/// Start building the programs of every Shader, needs a GL context
+	///
+	void Init();
+
+	///
+	/// Delete the programs issued by Init() that no Shader asked for, to call
+	/// once the scene is loaded
+	///
+	void ReleasePrewarmed();
+
+	GLuint createProgram(std::vector<lazy::graphics::Shader::Stage> const &stages) override;
+	bool finishProgram(GLuint program) override;
+
+	/// Programs linked from source, the others came from a binary
+	size_t GetLinkCount() const { return _linkCount; }
+	size_t GetBinaryLoadCount() const { return _binaryLoadCount; }
+
 private:
+	using Stage = lazy::graphics::Shader::Stage;
+
+	struct Binary
+	{
+		GLenum Format;
+		std::vector<char> Data;
+	};
+
+	struct CompiledStage
+	{
+		GLuint Shader;
+		/// Pending links the stage is attached to
+		size_t Links;
+	};
+
+	struct PendingLink
+	{
+		uint64_t Key;
+		/// Hashes of the stages in _compiled
+		std::vector<uint64_t> Stages;
+	};
+
 	std::unordered_map<unsigned int, std::unique_ptr<lazy::graphics::Shader>> _shaders;
 
 	unsigned int _nextId = 0;
 
+	// Program binaries by key
+	std::unordered_map<uint64_t, Binary> _binaries;
+	// Compiled shader objects by hash of their type and source
+	std::unordered_map<uint64_t, CompiledStage> _compiled;
+	// Programs whose link was issued but not checked yet
+	std::unordered_map<GLuint, PendingLink> _pending;
+	// Programs issued by Init() that no Shader asked for yet
+	std::unordered_map<uint64_t, GLuint> _prewarmed;
+	// Lines of the manifest, the paths of the stages of a program
+	std::unordered_set<std::string> _manifest;
+
+	std::string _cacheDirectory;
+	std::string _driver;
+	bool _binarySupported = false;
+	bool _parallelCompile = false;
+
+	size_t _linkCount = 0;
+	size_t _binaryLoadCount = 0;
+
+	uint64_t GetKey(std::vector<Stage> const &stages) const;
+	std::string GetBinaryPath(uint64_t key) const;
+	std::string GetManifestPath() const;
+
+	/// Compile or reuse a stage, its hash
+	uint64_t Compile(Stage const &stage);
+	/// Detach the stages of a link and delete the ones no other link uses
+	void ReleaseStages(GLuint program, PendingLink const &link);
+	GLuint Link(uint64_t key, std::vector<Stage> const &stages);
+
+	bool HasBinary(uint64_t key) const;
+	GLuint LoadBinary(uint64_t key);
+	void SaveBinary(uint64_t key, GLuint program);
+
+	void Prewarm();
+	void AddToManifest(std::vector<Stage> const &stages);
+	static std::string GetManifestLine(std::vector<Stage> const &stages);
+
 private:
 	ShaderManager()
 	{
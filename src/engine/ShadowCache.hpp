@@ -0,0 +1,286 @@
+#pragma once
+
+#include "lazy.hpp"
+#include "GLState.hpp"
+#include <array>
+#include <vector>
+#include <algorithm>
+
+///
+/// Filtering used by the lighting pass when sampling the shadow cube map
+///   - Off: no shadows
+///   - Hardware: a single depth comparison (bilinear 2x2 PCF done by the sampler)
+///   - Poisson: a few hardware comparisons spread over a Poisson disk
+///   - Pcf: 64 manual depth fetches (the most expensive)
+///
+enum class ShadowQuality : int
+{
+	Off = 0,
+	Hardware,
+	Poisson,
+	Pcf,
+};
+
+///
+/// Point light shadow cube map split in two layers:
+///   - a cached layer holding the static casters, re-rendered only when the
+///     light or one of the casters in its range moved
+///   - the final layer sampled by the lighting pass, made of the cached layer
+///     with the dynamic casters (the player) composited on top
+///
+/// Dirty faces of the cached layer can be refreshed round-robin so that a
+/// frame never re-renders more than a given number of faces.
+///
+class ShadowCache
+{
+public:
+	struct Caster
+	{
+		unsigned int Id;
+		glm::vec3 Position;
+		glm::vec3 Scale;
+
+		bool operator==(Caster const &rhs) const
+		{
+			return Id == rhs.Id && Position == rhs.Position && Scale == rhs.Scale;
+		}
+	};
+
+	static constexpr size_t NumFaces = 6;
+
+private:
+	GLuint _staticFb = 0;
+	GLuint _staticCubemap = 0;
+
+	GLuint _finalFb = 0;
+	GLuint _finalCubemap = 0;
+
+	// Used to attach a single face of the final cube map when compositing
+	GLuint _copyFb = 0;
+
+	unsigned int _size;
+	float _near;
+	float _far;
+	glm::mat4 _projection;
+
+	glm::vec3 _lightPos{0.0f};
+	std::vector<Caster> _casters;
+
+	std::array<bool, NumFaces> _dirtyFaces;
+	size_t _nextFace = 0;
+
+	bool _isValid = false;
+	bool _hasDynamicLayer = false;
+	bool _compare = false;
+
+	GLuint CreateCubemap()
+	{
+		GLuint cubemap;
+
+		glGenTextures(1, &cubemap);
+		engine::GLState::Instance().BindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+		for (size_t face = 0; face < NumFaces; face++) {
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT, _size, _size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+		}
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		engine::GLState::Instance().BindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+		return cubemap;
+	}
+
+	void Init()
+	{
+		_staticCubemap = CreateCubemap();
+		_finalCubemap = CreateCubemap();
+
+		glGenFramebuffers(1, &_staticFb);
+		engine::GLState::Instance().BindFramebuffer(GL_FRAMEBUFFER, _staticFb);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X, _staticCubemap, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+
+		glGenFramebuffers(1, &_copyFb);
+		engine::GLState::Instance().BindFramebuffer(GL_FRAMEBUFFER, _copyFb);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X, _finalCubemap, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+
+		// Layered attachment, the geometry shader picks the face with gl_Layer
+		glGenFramebuffers(1, &_finalFb);
+		engine::GLState::Instance().BindFramebuffer(GL_FRAMEBUFFER, _finalFb);
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, _finalCubemap, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+
+		engine::GLState::Instance().BindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+public:
+	ShadowCache(unsigned int size, float near, float far) : _size(size), _near(near), _far(far)
+	{
+		_projection = glm::perspective(glm::radians(90.0f), 1.0f, _near, _far);
+		_dirtyFaces.fill(true);
+
+		Init();
+	}
+
+	~ShadowCache()
+	{
+		if (_staticFb) { engine::GLState::Instance().DeleteFramebuffer(_staticFb); }
+		if (_finalFb) { engine::GLState::Instance().DeleteFramebuffer(_finalFb); }
+		if (_copyFb) { engine::GLState::Instance().DeleteFramebuffer(_copyFb); }
+		if (_staticCubemap) { engine::GLState::Instance().DeleteTexture(_staticCubemap); }
+		if (_finalCubemap) { engine::GLState::Instance().DeleteTexture(_finalCubemap); }
+	}
+
+	ShadowCache(ShadowCache const &) = delete;
+	void operator=(ShadowCache const &) = delete;
+
+	/// Force every face of the cached layer to be rendered again
+	void Invalidate()
+	{
+		_dirtyFaces.fill(true);
+		_isValid = false;
+	}
+
+	///
+	/// Compare the light and the static casters in its range with the ones used
+	/// to build the cached layer and invalidate it if anything moved.
+	/// `casters` must be given in a stable order (ie. the ECS order).
+	///
+	void Update(glm::vec3 const &lightPos, std::vector<Caster> const &casters)
+	{
+		if (!_isValid || lightPos != _lightPos || casters != _casters) {
+			_lightPos = lightPos;
+			_casters = casters;
+			_dirtyFaces.fill(true);
+			_isValid = true;
+		}
+	}
+
+	///
+	/// Returns at most `budget` dirty faces, starting after the last face that
+	/// was updated so that every face eventually gets refreshed.
+	/// The returned faces are considered clean afterwards.
+	///
+	std::vector<size_t> TakeDirtyFaces(size_t budget)
+	{
+		std::vector<size_t> faces;
+
+		for (size_t i = 0; i < NumFaces && faces.size() < budget; i++) {
+			size_t face = (_nextFace + i) % NumFaces;
+
+			if (_dirtyFaces[face]) {
+				_dirtyFaces[face] = false;
+				faces.push_back(face);
+			}
+		}
+
+		if (!faces.empty()) {
+			_nextFace = (faces.back() + 1) % NumFaces;
+		}
+
+		return faces;
+	}
+
+	bool IsDirty() const
+	{
+		return std::any_of(_dirtyFaces.begin(), _dirtyFaces.end(), [] (bool d) { return d; });
+	}
+
+	/// Light-space matrices for each face of the cube map
+	std::array<glm::mat4, NumFaces> GetFaceTransforms() const
+	{
+		glm::vec3 const &p = _lightPos;
+
+		return {
+			_projection * glm::lookAt(p, p + glm::vec3( 1.0, 0.0, 0.0), glm::vec3(0.0,-1.0, 0.0)),
+			_projection * glm::lookAt(p, p + glm::vec3(-1.0, 0.0, 0.0), glm::vec3(0.0,-1.0, 0.0)),
+			_projection * glm::lookAt(p, p + glm::vec3( 0.0, 1.0, 0.0), glm::vec3(0.0, 0.0, 1.0)),
+			_projection * glm::lookAt(p, p + glm::vec3( 0.0,-1.0, 0.0), glm::vec3(0.0, 0.0,-1.0)),
+			_projection * glm::lookAt(p, p + glm::vec3( 0.0, 0.0, 1.0), glm::vec3(0.0,-1.0, 0.0)),
+			_projection * glm::lookAt(p, p + glm::vec3( 0.0, 0.0,-1.0), glm::vec3(0.0,-1.0, 0.0)),
+		};
+	}
+
+	/// Bind a single face of the cached layer as the depth target
+	void BindStaticFace(size_t face)
+	{
+		glViewport(0, 0, _size, _size);
+		engine::GLState::Instance().BindFramebuffer(GL_FRAMEBUFFER, _staticFb);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, _staticCubemap, 0);
+	}
+
+	///
+	/// Copy the cached layer into the final cube map.
+	/// Only does work when the cached layer changed or when dynamic casters
+	/// were (or are about to be) drawn on top of it.
+	///
+	void Composite(std::vector<size_t> const &updatedFaces, bool hasDynamicCasters)
+	{
+		bool fullCopy = hasDynamicCasters || _hasDynamicLayer;
+
+		if (!fullCopy && updatedFaces.empty()) { return ; }
+
+		auto copyFace = [this] (size_t face) {
+			glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, _staticCubemap, 0);
+			glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, _finalCubemap, 0);
+			glBlitFramebuffer(0, 0, _size, _size, 0, 0, _size, _size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		};
+
+		engine::GLState::Instance().BindFramebuffer(GL_READ_FRAMEBUFFER, _staticFb);
+		engine::GLState::Instance().BindFramebuffer(GL_DRAW_FRAMEBUFFER, _copyFb);
+
+		if (fullCopy) {
+			for (size_t face = 0; face < NumFaces; face++) {
+				copyFace(face);
+			}
+		}
+		else {
+			for (auto face : updatedFaces) {
+				copyFace(face);
+			}
+		}
+
+		engine::GLState::Instance().BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		_hasDynamicLayer = hasDynamicCasters;
+	}
+
+	/// Bind every face of the final cube map for a layered (geometry shader) pass
+	void BindFinal()
+	{
+		glViewport(0, 0, _size, _size);
+		engine::GLState::Instance().BindFramebuffer(GL_FRAMEBUFFER, _finalFb);
+	}
+
+	GLuint GetCubemap() const { return _finalCubemap; }
+	unsigned int GetSize() const { return _size; }
+	float GetFar() const { return _far; }
+	glm::vec3 const &GetLightPos() const { return _lightPos; }
+
+	///
+	/// Enable hardware depth comparison on the final cube map so it can be
+	/// sampled with a samplerCubeShadow. Linear filtering lets the driver
+	/// average the comparison of the four nearest texels.
+	///
+	void SetCompareMode(bool compare)
+	{
+		if (compare == _compare) { return ; }
+
+		GLint filter = compare ? GL_LINEAR : GL_NEAREST;
+
+		engine::GLState::Instance().BindTexture(GL_TEXTURE_CUBE_MAP, _finalCubemap);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, compare ? GL_COMPARE_REF_TO_TEXTURE : GL_NONE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, filter);
+		engine::GLState::Instance().BindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+		_compare = compare;
+	}
+};
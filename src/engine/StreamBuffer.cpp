@@ -0,0 +1,153 @@
+#include "StreamBuffer.hpp"
+#include "Logger.hpp"
+#include "GLStats.hpp"
+
+namespace engine
+{
+
+StreamBuffer::StreamBuffer(GLenum target, size_t regionSize) : _target(target), _regionSize(regionSize)
+{
+	size_t const size = _regionSize * Regions;
+
+	_persistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+
+	glGenBuffers(1, &_buffer);
+	glBindBuffer(_target, _buffer);
+
+	if (_persistent) {
+		GLbitfield const flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+		glBufferStorage(_target, size, nullptr, flags);
+		_mapped = static_cast<char *>(glMapBufferRange(_target, 0, size, flags));
+
+		if (_mapped == nullptr) {
+			Logger::Warn("StreamBuffer: persistent mapping failed, using orphaning\n");
+			glDeleteBuffers(1, &_buffer);
+			glGenBuffers(1, &_buffer);
+			glBindBuffer(_target, _buffer);
+			_persistent = false;
+		}
+	}
+
+	if (!_persistent) {
+		glBufferData(_target, size, nullptr, GL_STREAM_DRAW);
+	}
+
+	glBindBuffer(_target, 0);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	for (auto &fence : _fences) {
+		if (fence) { glDeleteSync(fence); }
+	}
+
+	if (_buffer) {
+		if (_persistent) {
+			glBindBuffer(_target, _buffer);
+			glUnmapBuffer(_target);
+			glBindBuffer(_target, 0);
+		}
+		glDeleteBuffers(1, &_buffer);
+	}
+}
+
+void StreamBuffer::Orphan()
+{
+	// The driver gives us new storage, nothing in flight can be overwritten
+	glBindBuffer(_target, _buffer);
+	glBufferData(_target, _regionSize * Regions, nullptr, GL_STREAM_DRAW);
+	glBindBuffer(_target, 0);
+
+	for (auto &fence : _fences) {
+		if (fence) {
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+}
+
+void StreamBuffer::WaitRegion(size_t region)
+{
+	GLsync &fence = _fences[region];
+
+	if (!fence) { return ; }
+
+	GLenum status = glClientWaitSync(fence, 0, 0);
+
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+		if (!_persistent) {
+			Orphan();
+			return ;
+		}
+
+		// The persistent storage cannot be replaced, wait for the GPU (1ms steps)
+		do {
+			status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		} while (status == GL_TIMEOUT_EXPIRED);
+	}
+
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+void StreamBuffer::EndFrame()
+{
+	if (_fences[_region]) { glDeleteSync(_fences[_region]); }
+	_fences[_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	_region = (_region + 1) % Regions;
+	_offset = 0;
+
+	WaitRegion(_region);
+}
+
+auto StreamBuffer::Allocate(size_t size, size_t alignment) -> Allocation
+{
+	Allocation allocation;
+
+	if (size > _regionSize) {
+		Logger::Error("StreamBuffer: allocation of {} bytes is bigger than a region ({} bytes)\n", size, _regionSize);
+		return allocation;
+	}
+
+	size_t offset = (_offset + alignment - 1) / alignment * alignment;
+
+	if (offset + size > _regionSize) {
+		EndFrame();
+		offset = 0;
+	}
+
+	_offset = offset + size;
+
+	allocation.Offset = _region * _regionSize + offset;
+	allocation.Size = size;
+
+	if (_persistent) {
+		allocation.Data = _mapped + allocation.Offset;
+	}
+	else {
+		glBindBuffer(_target, _buffer);
+		allocation.Data = glMapBufferRange(_target, allocation.Offset, size,
+			GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+	}
+
+	return allocation;
+}
+
+void StreamBuffer::Commit(Allocation const &allocation)
+{
+	if (allocation.Data == nullptr) { return ; }
+
+	// Written through a mapping, counted when the writes are done
+	GL_STATS(Upload(allocation.Size));
+
+	if (_persistent) { return ; }
+
+	// Allocate left the buffer bound
+	glBindBuffer(_target, _buffer);
+	glUnmapBuffer(_target);
+	glBindBuffer(_target, 0);
+}
+
+}
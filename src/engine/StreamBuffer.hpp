@@ -0,0 +1,75 @@
+#pragma once
+
+#include "lazy.hpp"
+#include <array>
+
+namespace engine
+{
+
+///
+/// Ring buffer for data written by the CPU every frame (vertices, instances,
+/// uniforms) without stalling on the GPU still reading the previous frames.
+///
+/// The buffer is split in Regions regions, a fence is placed when leaving a
+/// region and checked before writing to it again:
+///   - with GL 4.4 / ARB_buffer_storage the buffer is persistently mapped
+///     once, a region whose fence is not signaled yet is waited on
+///   - otherwise (GL 3.2) every allocation is mapped with
+///     GL_MAP_UNSYNCHRONIZED_BIT and a region still in use makes the buffer
+///     orphaned instead of waiting
+///
+class StreamBuffer
+{
+public:
+	static constexpr size_t Regions = 3;
+
+	struct Allocation
+	{
+		/// Where to write, nullptr if the allocation failed
+		void *Data = nullptr;
+		/// Offset from the start of the buffer, to use in draw/attribute calls
+		GLintptr Offset = 0;
+		size_t Size = 0;
+	};
+
+private:
+	GLuint _buffer = 0;
+	GLenum _target;
+
+	size_t _regionSize;
+	size_t _region = 0;
+	size_t _offset = 0;
+
+	std::array<GLsync, Regions> _fences{};
+
+	bool _persistent = false;
+	char *_mapped = nullptr;
+
+	void WaitRegion(size_t region);
+	void Orphan();
+
+public:
+	/// `regionSize` is the maximum amount of data written in a frame
+	StreamBuffer(GLenum target, size_t regionSize);
+	~StreamBuffer();
+
+	StreamBuffer(StreamBuffer const &) = delete;
+	void operator=(StreamBuffer const &) = delete;
+
+	///
+	/// Reserve `size` bytes in the current region, moving to the next region
+	/// if it does not fit. Must be followed by Commit() before drawing.
+	///
+	Allocation Allocate(size_t size, size_t alignment = 16);
+
+	/// Make the written data visible to the GPU
+	void Commit(Allocation const &allocation);
+
+	/// Fence the current region and move to the next one
+	void EndFrame();
+
+	GLuint GetBuffer() const { return _buffer; }
+	bool IsPersistent() const { return _persistent; }
+};
+
+}
@@ -1,5 +1,6 @@
 #include "Texture.hpp"
 #include "stb_image.h"
+#include "GLState.hpp"
 #include <fmt/format.h>
 
 Texture::Texture(std::string const &name, GLenum target) : _name(name), _target(target)
@@ -21,7 +22,7 @@ Texture::Texture(Texture &&rhs)
 
 Texture::~Texture()
 {
-	if (_glId) { glDeleteTextures(1, &_glId); }
+	if (_glId) { engine::GLState::Instance().DeleteTexture(_glId); }
 }
 
 bool Texture::load(std::string const &path)
@@ -66,12 +67,11 @@ bool Texture::load(std::string const &path)
 
 void Texture::setParameter(GLenum target, GLenum param, GLenum value)
 {
-	glBindTexture(GL_TEXTURE_2D, _glId);
+	engine::GLState::Instance().BindTexture(GL_TEXTURE_2D, _glId);
 	glTexParameteri(target, param, value);
 }
 
 void Texture::bind(GLuint textureNumber)
 {
-	glActiveTexture(GL_TEXTURE0 + textureNumber);
-	glBindTexture(_target, _glId);
+	engine::GLState::Instance().BindTexture(GL_TEXTURE0 + textureNumber, _target, _glId);
 }
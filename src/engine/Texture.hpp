@@ -38,9 +38,9 @@ public:
 
 private:
 	std::string _name;
-	int _width;
-	int _height;
-	int _nChannel;
+	int _width = 0;
+	int _height = 0;
+	int _nChannel = 0;
 	bool _srgb;
 	GLuint _glId;
 	GLenum _target;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "lazy.hpp"
+#include "GLState.hpp"
 #include <exception>
 #include <optional>
 
@@ -32,12 +33,8 @@ public:
 		Bind();
 	}
 
-	~TextureAutoBind()
-	{
-		if (_bIsBound && _texture.has_value()) {
-			Unbind();
-		}
-	}
+	/// The texture stays bound, the next bind to the unit replaces it
+	~TextureAutoBind() = default;
 
 	TextureAutoBind(TextureAutoBind &&other)
 	{
@@ -76,8 +73,7 @@ public:
 	{
 		if (_bIsBound) {
 			_bIsBound = false;
-			glActiveTexture(_unit);
-			glBindTexture(_target, 0);
+			engine::GLState::Instance().BindTexture(_unit, _target, 0);
 		}
 		else throw std::runtime_error("Tried to unbind an unbound texture");
 	}
@@ -89,8 +85,7 @@ public:
 		}
 		if (!_bIsBound) {
 			_bIsBound = true;
-			glActiveTexture(_unit);
-			glBindTexture(_target, _texture.value());
+			engine::GLState::Instance().BindTexture(_unit, _target, _texture.value());
 		}
 		else throw std::runtime_error("Tried to bind a bound texture");
 	}
@@ -16,6 +16,15 @@ void TextureManager::createTexture(std::string const &name, std::string const &p
 	_textures[name]->load(path);
 }
 
+Texture const *TextureManager::find(std::string const &name) const
+{
+	auto texture = _textures.find(name);
+
+	if (texture == _textures.end()) { return nullptr; }
+
+	return texture->second.get();
+}
+
 void TextureManager::bind(std::string const &name, GLuint textureNumber)
 {
 	if (_textures.find(name) == _textures.end()) {
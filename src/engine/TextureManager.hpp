@@ -21,6 +21,9 @@ public:
 	void add(std::string const &name, Texture t);
 	GLuint get(std::string const &name) { return _textures[name]->id(); }
 
+	/// Texture to read from, nullptr if no texture has that name
+	Texture const *find(std::string const &name) const;
+
 private:
 	std::map<std::string, std::unique_ptr<Texture>> _textures;
 
@@ -5,6 +5,7 @@
 #include <vector>
 #include <algorithm>
 #include <map>
+#include <optional>
 #include "Component.hpp"
 #include "Entity.hpp"
 
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <chrono>
+#include <cxxabi.h>
+#include <cstdlib>
 #include <memory>
+#include <string>
 #include <vector>
 #include <type_traits>
 #include "System.hpp"
@@ -10,6 +14,13 @@ namespace ecs {
 
 class ECSEngine;
 
+/// CPU time spent in a system's OnUpdate during the last update
+struct SystemTiming
+{
+	char const *Name;
+	float Ms;
+};
+
 class SystemManager_Impl
 {
 	friend class SystemManager;
@@ -18,8 +29,21 @@ private:
 	SystemManager_Impl(EntityManager *mgr) : Systems{}, EntityMgr(mgr) {}
 
 	std::unordered_map<TypeIndex, std::unique_ptr<ISystemBase>> Systems;
+	std::unordered_map<TypeIndex, std::string> Names;
+	std::vector<SystemTiming> Timings;
 	EntityManager *EntityMgr;
 
+	template <typename T>
+	static std::string GetSystemName()
+	{
+		int status = 0;
+		char *demangled = abi::__cxa_demangle(typeid(T).name(), nullptr, nullptr, &status);
+		std::string name = status == 0 ? demangled : typeid(T).name();
+
+		std::free(demangled);
+		return name;
+	}
+
 	template <typename T>
 	void InstantiateSystem()
 	{
@@ -36,6 +60,7 @@ private:
 		newSystem->EntityMgr = EntityMgr;
 
 		Systems[GetTypeIndex<T>()] = std::move(newSystem);
+		Names[GetTypeIndex<T>()] = GetSystemName<T>();
 	}
 
 	template <typename T>
@@ -49,13 +74,21 @@ private:
 
 		if (system != Systems.end()) {
 			Systems.erase(system);
+			Names.erase(GetTypeIndex<T>());
 		}
 	}
 
 	void Update(float deltaTime)
 	{
+		Timings.clear();
+
 		for (auto &s : Systems) {
+			auto start = std::chrono::steady_clock::now();
+
 			s.second->OnUpdate(deltaTime);
+
+			std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			Timings.push_back(SystemTiming{ Names[s.first].c_str(), elapsed.count() });
 		}
 	}
 };
@@ -87,6 +120,12 @@ public:
 	{
 		Manager.Update(deltaTime);
 	}
+
+	/// CPU time of every system during the last Update
+	std::vector<SystemTiming> const &GetTimings() const
+	{
+		return Manager.Timings;
+	}
 };
 
 }
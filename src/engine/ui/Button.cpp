@@ -2,6 +2,7 @@
 #include "TextureManager.hpp"
 #include "Anchor.hpp"
 #include "TextComponent.hpp"
+#include "UIRenderer.hpp"
 
 Button::Button(IUIScene *scene) : ASceneComponent(scene)
 {
@@ -34,44 +35,10 @@ void Button::setup(glm::vec2 size, Anchor anchorPoint)
 	_label->setAnchor(Anchor::Center);
 	_label->setText("Hello");
 
-	buildMesh();
-
 	_canBeClicked = true;
 	lazy::inputs::input::getMouse().attach(this);
 }
 
-void Button::buildMesh()
-{
-	glm::vec3 quad[] = {
-		glm::vec3(0.0f,               0.0f,               0.0f),
-		glm::vec3(0.0f + getSize().x, 0.0f,               0.0f),
-		glm::vec3(0.0f + getSize().x, 0.0f + getSize().y, 0.0f),
-		glm::vec3(0.0f,               0.0f + getSize().y, 0.0f),
-	};
-	glm::uvec3 inds[] = {
-		glm::uvec3(0, 1, 2),
-		glm::uvec3(0, 2, 3),
-	};
-	glm::vec2 tex[] = {
-		glm::vec2(0.0f, 0.0f),
-		glm::vec2(1.0f, 0.0f),
-		glm::vec2(1.0f, 1.0f),
-		glm::vec2(0.0f, 1.0f),
-	};
-
-	_mesh = Mesh();
-	for (auto const &p : quad) {
-		_mesh.addPosition(p);
-	}
-	for (auto const &i : inds) {
-		_mesh.addTriangle(i);
-	}
-	for (auto const &t : tex) {
-		_mesh.addUv(t);
-	}
-	_mesh.build();
-}
-
 Button::~Button()
 {
 }
@@ -80,15 +47,11 @@ void Button::update()
 {
 }
 
-void Button::draw(Shader &shader)
+void Button::emit(UIRenderer &renderer, glm::vec2 position)
 {
-	if (_isHovering) {
-		TextureManager::instance().bind("ButtonHovering", GL_TEXTURE0);
-	}
-	else {
-		TextureManager::instance().bind("Button", GL_TEXTURE0);
-	}
-	_mesh.draw();
+	auto texture = TextureManager::instance().get(_isHovering ? "ButtonHovering" : "Button");
+
+	renderer.addQuad(texture, position, position + getSize());
 }
 
 void Button::setText(std::string const &text)
@@ -104,7 +67,10 @@ void Button::onClickUpInside()
 
 void Button::onHover(bool val)
 {
-	_isHovering = val;
+	if (val != _isHovering) {
+		_isHovering = val;
+		invalidate();
+	}
 }
 
 glm::vec4 Button::getObservedArea() const
@@ -6,7 +6,6 @@
 #include "SceneComponent.hpp"
 #include "Label.hpp"
 
-using lazy::graphics::Mesh;
 using namespace anchor;
 
 class Button : public lazy::inputs::IMouseObserver, public ASceneComponent
@@ -16,7 +15,7 @@ public:
 	~Button();
 
 	void update() override;
-	void draw(Shader &shader) override;
+	void emit(UIRenderer &renderer, glm::vec2 position) override;
 
 	void setText(std::string const &text);
 
@@ -31,11 +30,9 @@ public:
 
 private:
 	void setup(glm::vec2 size, Anchor anchorPoint);
-	void buildMesh();
 
-	Mesh _mesh;
 	std::string _text;
 	bool _canBeClicked;
-	bool _isHovering;
+	bool _isHovering = false;
 	std::shared_ptr<Label> _label;
 };
@@ -4,8 +4,7 @@
 #include <glm/glm.hpp>
 #include "lazy.hpp"
 #include "TextureManager.hpp"
-
-using lazy::graphics::Mesh;
+#include "UIRenderer.hpp"
 
 class Image : public ASceneComponent
 {
@@ -25,41 +24,16 @@ public:
 		// TODO: use a UUID rather than the path
 		_textureName = path;
 
-		_quad = Mesh();
 		setSize(glm::vec2(width, height));
-		std::array<glm::vec3, 4> verts = {
-			glm::vec3(-(width / 2.0f), -(height / 2.0f), 0.0f),
-			glm::vec3( (width / 2.0f), -(height / 2.0f), 0.0f),
-			glm::vec3( (width / 2.0f),  (height / 2.0f), 0.0f),
-			glm::vec3(-(width / 2.0f),  (height / 2.0f), 0.0f),
-		};
-
-		std::array<glm::vec3, 4> tex = {
-			glm::vec3(  0.0f,   0.0f, 0.0f ),
-			glm::vec3(  1.0f,   0.0f, 0.0f ),
-			glm::vec3(  1.0f,   1.0f, 0.0f ),
-			glm::vec3(  0.0f,   1.0f, 0.0f ),
-		};
-
-		for (auto const &v : verts) {
-			_quad.addPosition(v);
-		}
-		for (auto const &t : tex) {
-			_quad.addUv(t);
-		}
-
-		_quad.addTriangle(glm::uvec3(0, 1, 2))
-			 .addTriangle(glm::uvec3(0, 2, 3));
-		_quad.build();
 	}
 
-	void draw(Shader &shader) override
+	void emit(UIRenderer &renderer, glm::vec2 position) override
 	{
-		TextureManager::instance().bind(_textureName, GL_TEXTURE0);
-		_quad.draw();
+		glm::vec2 const halfSize = getSize() / 2.0f;
+
+		renderer.addQuad(TextureManager::instance().get(_textureName), position - halfSize, position + halfSize);
 	}
 
 private:
-	Mesh _quad;
 	std::string _textureName;
 };
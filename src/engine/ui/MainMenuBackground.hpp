@@ -2,10 +2,9 @@
 
 #include "SceneComponent.hpp"
 #include "TextureManager.hpp"
+#include "UIRenderer.hpp"
 #include "lazy.hpp"
 
-using lazy::graphics::Mesh;
-
 class IUIScene;
 
 class MainMenuBackground : public ASceneComponent
@@ -13,13 +12,13 @@ class MainMenuBackground : public ASceneComponent
 public:
 	MainMenuBackground(IUIScene *parent);
 
-	void draw(Shader &shader) override
+	void emit(UIRenderer &renderer, glm::vec2 position) override
 	{
-		TextureManager::instance().bind("MenuBackground", GL_TEXTURE0);
-		_background.draw();
+		// The texture repeats every 64 pixels
+		renderer.addQuad(TextureManager::instance().get("MenuBackground"), position, position + _size,
+			glm::vec2(0.0f), _size / 64.0f);
 	}
 
 private:
 	glm::vec2 _size;
-	Mesh _background;
 };
@@ -10,6 +10,12 @@ void ASceneComponent::call(std::string const &funcName)
 void ASceneComponent::setSize(glm::vec2 size)
 {
 	_size = size;
+	invalidate();
+}
+
+void ASceneComponent::invalidate()
+{
+	_scene->invalidate();
 }
 
 glm::vec2 ASceneComponent::getScreenPosition() const
@@ -11,6 +11,7 @@ using Origin = Anchor;
 using lazy::graphics::Shader;
 
 class IUIScene;
+class UIRenderer;
 
 class ASceneComponent
 {
@@ -21,7 +22,13 @@ public:
 
 	virtual ~ASceneComponent() {}
 	virtual void update() {};
-	virtual void draw(Shader &shader) = 0;
+
+	///
+	/// Add the quads of the component to the scene's draw list, `position`
+	/// is where its origin, anchor and offset put it on screen. Only called
+	/// when the draw list is built again, see invalidate().
+	///
+	virtual void emit(UIRenderer &renderer, glm::vec2 position) {};
 
 	glm::vec2 getSize() const { return _size; }
 	Anchor getAnchor() const { return _anchor; }
@@ -31,10 +38,10 @@ public:
 	glm::vec4 getColor() { return _color; }
 
 	void setSize(glm::vec2 size);
-	void setOrigin(Origin origin) { _origin = origin; }
-	void setAnchor(Anchor anchor) { _anchor = anchor; }
-	void setOffset(glm::vec2 off) { _offset = off; }
-	void setColor(glm::vec4 color) { _color = color; }
+	void setOrigin(Origin origin) { _origin = origin; invalidate(); }
+	void setAnchor(Anchor anchor) { _anchor = anchor; invalidate(); }
+	void setOffset(glm::vec2 off) { _offset = off; invalidate(); }
+	void setColor(glm::vec4 color) { _color = color; invalidate(); }
 
 	std::vector<std::shared_ptr<ASceneComponent>> &getSubComponents() {
 		return _subComponents;
@@ -48,9 +55,13 @@ protected:
 		auto component = std::make_shared<T>(_scene, std::forward<Args>(args)...);
 
 		_subComponents.push_back(component);
+		invalidate();
 		return component;
 	}
 
+	/// The scene's draw list has to be built again, to call when what emit() adds changes
+	void invalidate();
+
 	/*
 	 * Call a function registered to the UI
 	 */
@@ -17,8 +17,4 @@ public:
 	void update() override
 	{
 	}
-
-	void draw(Shader &shader) override
-	{
-	}
 };
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <lazy.hpp>
+#include <string>
+#include <vector>
+#include "Anchor.hpp"
+
+///
+/// Glyph quads of a string, positioned and anchored, ready to be appended to
+/// a TextRenderer batch. Remembers what it was built from so that it is only
+/// laid out again when one of those changes.
+///
+struct TextLayout
+{
+	// Interleaved position, uv and color of a glyph quad vertex
+	struct Vertex {
+		GLfloat x, y;
+		GLfloat u, v;
+		GLubyte r, g, b, a;
+	};
+
+	std::vector<Vertex> Vertices;
+	/// Width and height of the text, before the anchor offset
+	glm::vec2 Size{0.0f};
+
+	std::string Text;
+	GLfloat Scale = 0.0f;
+	glm::vec3 Color{0.0f};
+	anchor::Anchor Anchor = anchor::Anchor::BottomLeft;
+	bool Valid = false;
+
+	bool Matches(std::string const &text, GLfloat scale, glm::vec3 const &color, anchor::Anchor anchor) const
+	{
+		return Valid && Scale == scale && Color == color && Anchor == anchor && Text == text;
+	}
+};
@@ -1,10 +1,23 @@
 #include "TextRenderer.hpp"
+#include "GLState.hpp"
+#include "GLStats.hpp"
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 
 using namespace anchor;
 
-TextRenderer::TextRenderer(float width, float height)
+// Glyph vertices written in a frame, 128K is enough for ~1000 characters
+static constexpr size_t StreamSize = 128 * 1024;
+
+// Width of the glyph atlas, its height is the smallest power of two that fits
+static constexpr int AtlasWidth = 512;
+// Empty texels around each glyph so that neighbours never bleed in
+static constexpr int AtlasPadding = 1;
+
+TextRenderer::TextRenderer(float width, float height) : _stream(GL_ARRAY_BUFFER, StreamSize)
 {
 	_width = width;
 	_height = height;
@@ -13,34 +26,21 @@ TextRenderer::TextRenderer(float width, float height)
 
 void TextRenderer::setup()
 {
-	GLfloat texCoords [6][2] = {
-		{ 0.0, 0.0 },
-		{ 0.0, 1.0 },
-		{ 1.0, 1.0 },
-
-		{ 0.0, 0.0 },
-		{ 1.0, 1.0 },
-		{ 1.0, 0.0 }
-	};
-
 	glGenVertexArrays(1, &_vao);
-	glGenBuffers(1, &_vbo);
-	glGenBuffers(1, &_ubo);
 
-	glBindVertexArray(_vao);
+	engine::GLState::Instance().BindVertexArray(_vao);
 
-	glBindBuffer(GL_ARRAY_BUFFER, _vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 6 * 2, nullptr, GL_DYNAMIC_DRAW);
+	// Vertices are streamed, the first vertex of a draw is given by its offset in the stream
+	glBindBuffer(GL_ARRAY_BUFFER, _stream.GetBuffer());
 	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 2, 0);
-
-	glBindBuffer(GL_ARRAY_BUFFER, _ubo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(texCoords), texCoords, GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void *>(offsetof(Vertex, x)));
 	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 2, 0);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void *>(offsetof(Vertex, u)));
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), reinterpret_cast<void *>(offsetof(Vertex, r)));
 
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	engine::GLState::Instance().BindVertexArray(0);
 
 	FT_Library lib;
 	if (FT_Init_FreeType(&lib)) {
@@ -54,91 +54,202 @@ void TextRenderer::setup()
 	}
 	FT_Set_Pixel_Sizes(face, 0, 48);
 
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	// Render every glyph first to know how big the atlas has to be
+	std::array<std::vector<GLubyte>, 128> bitmaps;
+	std::array<glm::ivec2, 128> positions{};
+
+	glm::ivec2 cursor(AtlasPadding);
+	int rowHeight = 0;
 
 	for (GLubyte c = 0; c < 128; c++) {
 		if (FT_Load_Char(face, c, FT_LOAD_RENDER)) {
 			std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
 			continue ;
 		}
-		GLuint texture;
-
-		glGenTextures(1, &texture);
-		glBindTexture(GL_TEXTURE_2D, texture);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED,
-			face->glyph->bitmap.width, face->glyph->bitmap.rows,
-			0, GL_RED, GL_UNSIGNED_BYTE, face->glyph->bitmap.buffer);
-		    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-		Character character = {
-			texture,
-			glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows),
+
+		auto const &bitmap = face->glyph->bitmap;
+		int const width = bitmap.width;
+		int const height = bitmap.rows;
+
+		// Rows of the bitmap may be padded, keep them tightly packed
+		bitmaps[c].resize(width * height);
+		for (int y = 0; y < height; y++) {
+			std::copy(bitmap.buffer + y * bitmap.pitch, bitmap.buffer + y * bitmap.pitch + width,
+				bitmaps[c].begin() + y * width);
+		}
+
+		// Shelf packing, a new row starts when the glyph does not fit
+		if (cursor.x + width + AtlasPadding > AtlasWidth) {
+			cursor = glm::ivec2(AtlasPadding, cursor.y + rowHeight + AtlasPadding);
+			rowHeight = 0;
+		}
+
+		positions[c] = cursor;
+		cursor.x += width + AtlasPadding;
+		rowHeight = std::max(rowHeight, height);
+
+		_characters[c] = {
+			glm::vec2(0.0f),
+			glm::vec2(0.0f),
+			glm::ivec2(width, height),
 			glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
 			static_cast<GLuint>(face->glyph->advance.x)
 		};
-		_characters.insert(std::pair<GLchar, Character>(c, character));
 	}
 
 	FT_Done_Face(face);
 	FT_Done_FreeType(lib);
+
+	int atlasHeight = 1;
+	while (atlasHeight < cursor.y + rowHeight + AtlasPadding) { atlasHeight *= 2; }
+
+	_atlasSize = glm::ivec2(AtlasWidth, atlasHeight);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	glGenTextures(1, &_atlas);
+	engine::GLState::Instance().BindTexture(GL_TEXTURE_2D, _atlas);
+
+	// Cleared so that the padding between glyphs is transparent
+	std::vector<GLubyte> clear(_atlasSize.x * _atlasSize.y, 0);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, _atlasSize.x, _atlasSize.y, 0, GL_RED, GL_UNSIGNED_BYTE, clear.data());
+
+	for (size_t c = 0; c < _characters.size(); c++) {
+		auto &ch = _characters[c];
+
+		if (ch.size.x == 0 || ch.size.y == 0) { continue ; }
+
+		glTexSubImage2D(GL_TEXTURE_2D, 0, positions[c].x, positions[c].y, ch.size.x, ch.size.y,
+			GL_RED, GL_UNSIGNED_BYTE, bitmaps[c].data());
+
+		ch.uvMin = glm::vec2(positions[c]) / glm::vec2(_atlasSize);
+		ch.uvMax = glm::vec2(positions[c] + ch.size) / glm::vec2(_atlasSize);
+	}
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	engine::GLState::Instance().BindTexture(GL_TEXTURE_2D, 0);
 }
 
-void TextRenderer::drawText(std::string text, GLfloat scale, glm::vec3 color, Anchor anchor)
+TextRenderer::~TextRenderer()
 {
-	glm::vec2 pos(0.0f);
+	if (_atlas) { engine::GLState::Instance().DeleteTexture(_atlas); }
+	if (_vao) { engine::GLState::Instance().DeleteVertexArray(_vao); }
+}
+
+TextRenderer::Character const &TextRenderer::getCharacter(char c) const
+{
+	auto const index = static_cast<unsigned char>(c);
+
+	return _characters[index < _characters.size() ? index : '?'];
+}
+
+bool TextRenderer::updateLayout(TextLayout &layout, std::string const &text, GLfloat scale, glm::vec3 color,
+	Anchor anchor) const
+{
+	if (layout.Matches(text, scale, color, anchor)) { return false; }
+
+	layout.Text = text;
+	layout.Scale = scale;
+	layout.Color = color;
+	layout.Anchor = anchor;
+	layout.Valid = true;
+	layout.Vertices.clear();
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindVertexArray(_vao);
+	glm::vec2 pos(0.0f);
 
 	float textWidth = 0.0f;
 	float maxHeight = 0.0f;
 	for (auto &c : text) {
-        Character const &ch = _characters[c];
+		Character const &ch = getCharacter(c);
 		textWidth += (ch.advance >> 6) * scale;
 		maxHeight = ch.bearing.y * scale > maxHeight ? ch.bearing.y * scale : maxHeight;
 	}
 
+	layout.Size = glm::vec2(textWidth, maxHeight);
+
 	// Calculate anchor offset to align text to the desired side
-	glm::vec2 anchorOffset = calculateOffset(anchor, glm::vec2(textWidth, maxHeight));
+	glm::vec2 anchorOffset = calculateOffset(anchor, layout.Size);
 	pos += anchorOffset;
 
+	auto toByte = [] (float value) { return static_cast<GLubyte>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f); };
+	GLubyte const r = toByte(color.x), g = toByte(color.y), b = toByte(color.z), a = 255;
+
+	auto &vertices = layout.Vertices;
+
 	for (auto &c : text)
 	{
-        Character const &ch = _characters[c];
-
-        GLfloat xpos = pos.x + ch.bearing.x * scale;
-        GLfloat ypos = pos.y - (ch.size.y - ch.bearing.y) * scale;
-
-        GLfloat w = ch.size.x * scale;
-        GLfloat h = ch.size.y * scale;
-
-        // Update VBO for each character
-        GLfloat vertices[6][2] = {
-            { xpos,     ypos + h, },
-            { xpos,     ypos,     },
-            { xpos + w, ypos,     },
-
-            { xpos,     ypos + h, },
-            { xpos + w, ypos,     },
-            { xpos + w, ypos + h, },
-        };
-        // Render glyph texture over quad
-        glBindTexture(GL_TEXTURE_2D, ch.texture);
-
-        // Update content of VBO memory
-        glBindBuffer(GL_ARRAY_BUFFER, _vbo);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        // Render quad
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        // Now advance cursors for next glyph (note that advance is number of 1/64 pixels)
-        pos.x += (ch.advance >> 6) * scale; // Bitshift by 6 to get value in pixels (2^6 = 64)
-    }
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+		Character const &ch = getCharacter(c);
+
+		GLfloat xpos = pos.x + ch.bearing.x * scale;
+		GLfloat ypos = pos.y - (ch.size.y - ch.bearing.y) * scale;
+
+		GLfloat w = ch.size.x * scale;
+		GLfloat h = ch.size.y * scale;
+
+		GLfloat u0 = ch.uvMin.x, v0 = ch.uvMin.y;
+		GLfloat u1 = ch.uvMax.x, v1 = ch.uvMax.y;
+
+		// Now advance cursors for next glyph (note that advance is number of 1/64 pixels)
+		pos.x += (ch.advance >> 6) * scale; // Bitshift by 6 to get value in pixels (2^6 = 64)
+
+		if (ch.size.x == 0 || ch.size.y == 0) { continue ; }
+
+		vertices.push_back({ xpos,     ypos + h, u0, v0, r, g, b, a });
+		vertices.push_back({ xpos,     ypos,     u0, v1, r, g, b, a });
+		vertices.push_back({ xpos + w, ypos,     u1, v1, r, g, b, a });
+
+		vertices.push_back({ xpos,     ypos + h, u0, v0, r, g, b, a });
+		vertices.push_back({ xpos + w, ypos,     u1, v1, r, g, b, a });
+		vertices.push_back({ xpos + w, ypos + h, u1, v0, r, g, b, a });
+	}
+
+	return true;
+}
+
+void TextRenderer::addLayout(TextLayout const &layout)
+{
+	_vertices.insert(_vertices.end(), layout.Vertices.begin(), layout.Vertices.end());
+}
+
+void TextRenderer::addText(std::string const &text, GLfloat scale, glm::vec3 color, Anchor anchor)
+{
+	updateLayout(_layout, text, scale, color, anchor);
+	addLayout(_layout);
+}
+
+void TextRenderer::flush()
+{
+	if (_vertices.empty()) { return ; }
+
+	auto allocation = _stream.Allocate(_vertices.size() * sizeof(Vertex), sizeof(Vertex));
+	if (allocation.Data == nullptr) {
+		_vertices.clear();
+		return ;
+	}
+
+	std::memcpy(allocation.Data, _vertices.data(), allocation.Size);
+	_stream.Commit(allocation);
+
+	engine::GLState::Instance().BindTexture(GL_TEXTURE0, GL_TEXTURE_2D, _atlas);
+	engine::GLState::Instance().BindVertexArray(_vao);
+
+	glDrawArrays(GL_TRIANGLES, allocation.Offset / sizeof(Vertex), _vertices.size());
+	GL_STATS(Draw(GL_TRIANGLES, _vertices.size()));
+
+	// Keeps its capacity for the next frame
+	_vertices.clear();
+}
+
+void TextRenderer::drawText(std::string const &text, GLfloat scale, glm::vec3 color, Anchor anchor)
+{
+	addText(text, scale, color, anchor);
+	flush();
+}
+
+void TextRenderer::endFrame()
+{
+	_stream.EndFrame();
 }
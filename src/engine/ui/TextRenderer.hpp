@@ -1,37 +1,84 @@
 #pragma once
 
 #include <lazy.hpp>
+#include <array>
+#include <vector>
 #include "Anchor.hpp"
+#include "TextLayout.hpp"
+#include "StreamBuffer.hpp"
 
 using namespace lazy::graphics;
 using namespace anchor;
 
+///
+/// Draws text with the glyphs of the font packed in a single atlas texture.
+///
+/// addText() only appends the quads of a string to a batch, flush() uploads
+/// the batch in one go and draws it with a single call. The glyph color is
+/// part of the vertices so strings of different colors share the batch.
+///
+/// Text that rarely changes should keep a TextLayout: updateLayout() only
+/// lays it out again when its text, scale, color or anchor changed.
+///
 class TextRenderer
 {
 public:
 //	TextRenderer() = delete;
 	TextRenderer(float width = 1280.0f, float height = 720.0f);
+	~TextRenderer();
 	TextRenderer(const TextRenderer &) = delete;
 
 	void operator=(TextRenderer const &) = delete;
 
 	void setup();
-	void drawText(std::string text, GLfloat scale, glm::vec3 color, Anchor anchor = Anchor::BottomLeft);
+
+	/// Lay out `layout` again if it was built from other parameters, returns whether it did
+	bool updateLayout(TextLayout &layout, std::string const &text, GLfloat scale, glm::vec3 color,
+		Anchor anchor = Anchor::BottomLeft) const;
+
+	/// Queue a laid out string, drawn by the next flush()
+	void addLayout(TextLayout const &layout);
+
+	/// Queue a string, drawn by the next flush()
+	void addText(std::string const &text, GLfloat scale, glm::vec3 color, Anchor anchor = Anchor::BottomLeft);
+
+	/// Draw everything queued since the last flush with the bound shader
+	void flush();
+
+	/// addText() and flush() at once
+	void drawText(std::string const &text, GLfloat scale, glm::vec3 color, Anchor anchor = Anchor::BottomLeft);
+
+	/// Call once all the text of the frame is drawn
+	void endFrame();
+
+	/// Texture holding every glyph, sampled with the coordinates of the layouts
+	GLuint getAtlas() const { return _atlas; }
 
 private:
-	GLuint _vao;
-	GLuint _vbo;
-	GLuint _ubo;
+	using Vertex = TextLayout::Vertex;
+
+	GLuint _vao = 0;
+	engine::StreamBuffer _stream;
 	Shader _shader;
 	int _width;
 	int _height;
 
+	GLuint _atlas = 0;
+	glm::ivec2 _atlasSize{0};
+
 	struct Character {
-		GLuint texture;
+		/// Top left and bottom right corners in the atlas
+		glm::vec2 uvMin;
+		glm::vec2 uvMax;
 		glm::ivec2 size;
 		glm::ivec2 bearing;
 		GLuint advance;
 	};
-	std::map<GLchar, Character> _characters;
+	std::array<Character, 128> _characters{};
+
+	std::vector<Vertex> _vertices;
+	// Layout of the last string queued with addText()
+	TextLayout _layout;
 
+	Character const &getCharacter(char c) const;
 };
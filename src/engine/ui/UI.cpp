@@ -1,4 +1,5 @@
 #include "UI.hpp"
+#include "GpuProfiler.hpp"
 #include <iostream>
 #include <type_traits>
 
@@ -24,7 +25,7 @@ void UI::update()
 	}
 }
 
-void UI::updateComponents(std::vector<std::shared_ptr<ASceneComponent>> components)
+void UI::updateComponents(std::vector<std::shared_ptr<ASceneComponent>> const &components)
 {
 	for (auto &c : components)
 	{
@@ -36,6 +37,8 @@ void UI::updateComponents(std::vector<std::shared_ptr<ASceneComponent>> componen
 void UI::render()
 {
 	if (_state.currentScene) {
+		engine::GpuProfiler::Scope profile("UI");
+
 		renderScene(*_state.currentScene);
 	}
 }
@@ -80,18 +83,24 @@ bool UI::loadScene(std::string const &name)
 
 void UI::renderScene(IUIScene &scene)
 {
-	_shader.bind();
-	renderComponents(scene.getSceneComponents());
-	_shader.unbind();
+	if (&scene != _builtScene || scene.getVersion() != _builtVersion) {
+		_renderer.begin();
+		emitComponents(scene.getSceneComponents());
+		_renderer.end();
+
+		_builtScene = &scene;
+		_builtVersion = scene.getVersion();
+	}
+
+	_renderer.render(_shader);
 }
 
-void UI::renderComponents(std::vector<std::shared_ptr<ASceneComponent>> components,
+void UI::emitComponents(std::vector<std::shared_ptr<ASceneComponent>> const &components,
 	ASceneComponent *parent, glm::vec2 parentPos)
 {
 	for (auto &c : components) {
 		glm::vec2 position(0.0f);
 		glm::vec2 anchorOff = calculateOffset(c->getAnchor(), c->getSize());
-		glm::mat4 modelMatrix(1.0f);
 
 		// TODO: Do this switch in ASceneComponent::getScreenPosition()
 		//       (getScreenPosition needs to access the parent's size)
@@ -133,15 +142,9 @@ void UI::renderComponents(std::vector<std::shared_ptr<ASceneComponent>> componen
 		position += anchorOff;
 		position += offset;
 
-		modelMatrix = glm::translate(glm::mat4(1.0f),
-			glm::vec3(parentPos + position, 0.0f));
-
-		_shader.bind();
-		_shader.setUniform4x4f("modelMatrix", modelMatrix);
-
-		c->draw(_shader);
+		c->emit(_renderer, parentPos + position);
 
-		renderComponents(c->getSubComponents(), c.get(), position);
+		emitComponents(c->getSubComponents(), c.get(), position);
 	}
 }
 
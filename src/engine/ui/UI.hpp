@@ -5,6 +5,7 @@
 #include <optional>
 #include <memory>
 #include "UIScene.hpp"
+#include "UIRenderer.hpp"
 #include "lazy.hpp"
 
 using lazy::graphics::Shader;
@@ -49,10 +50,11 @@ private:
 
 	void renderScene(IUIScene &scene);
 
-	void renderComponents(std::vector<std::shared_ptr<ASceneComponent>> components,
+	/// Flatten the component tree into the draw list
+	void emitComponents(std::vector<std::shared_ptr<ASceneComponent>> const &components,
 		ASceneComponent *parent = nullptr, glm::vec2 parentPos = glm::vec2(0.0f, 0.0f));
 
-	void updateComponents(std::vector<std::shared_ptr<ASceneComponent>> components);
+	void updateComponents(std::vector<std::shared_ptr<ASceneComponent>> const &components);
 
 private:
 	UIState _state;
@@ -60,4 +62,9 @@ private:
 	Shader _shader;
 	std::map<std::string, std::function<void()>> _callbacks;
 	glm::vec2 _size;
+
+	// Draw list of the scene, built again when it changes
+	UIRenderer _renderer;
+	IUIScene *_builtScene = nullptr;
+	size_t _builtVersion = 0;
 };
@@ -0,0 +1,150 @@
+#include "UIRenderer.hpp"
+#include "GLState.hpp"
+#include "GLStats.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+
+UIRenderer::UIRenderer()
+{
+	glGenVertexArrays(1, &_vao);
+	glGenBuffers(1, &_vbo);
+
+	engine::GLState::Instance().BindVertexArray(_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void *>(offsetof(Vertex, x)));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void *>(offsetof(Vertex, u)));
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), reinterpret_cast<void *>(offsetof(Vertex, r)));
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	engine::GLState::Instance().BindVertexArray(0);
+}
+
+UIRenderer::~UIRenderer()
+{
+	glDeleteBuffers(1, &_vbo);
+	engine::GLState::Instance().DeleteVertexArray(_vao);
+}
+
+void UIRenderer::begin()
+{
+	_batches.clear();
+}
+
+auto UIRenderer::getBatch(GLuint texture, bool text, Rect const &bounds) -> Batch &
+{
+	auto overlaps = [&] (Rect const &r) {
+		return r.min.x < bounds.max.x && bounds.min.x < r.max.x &&
+			r.min.y < bounds.max.y && bounds.min.y < r.max.y;
+	};
+
+	// Walk back to the last batch with this texture, as long as nothing
+	// drawn in between would end up under the new quad
+	for (auto batch = _batches.rbegin(); batch != _batches.rend(); ++batch) {
+		if (batch->texture == texture && batch->text == text) {
+			return *batch;
+		}
+		if (std::any_of(batch->bounds.begin(), batch->bounds.end(), overlaps)) {
+			break ;
+		}
+	}
+
+	_batches.push_back(Batch{ texture, text, {}, {}, 0 });
+
+	return _batches.back();
+}
+
+void UIRenderer::addQuad(GLuint texture, glm::vec2 min, glm::vec2 max, glm::vec2 uvMin, glm::vec2 uvMax)
+{
+	auto &batch = getBatch(texture, false, Rect{ min, max });
+	auto &vertices = batch.vertices;
+
+	vertices.push_back({ min.x, min.y, uvMin.x, uvMin.y, 255, 255, 255, 255 });
+	vertices.push_back({ max.x, min.y, uvMax.x, uvMin.y, 255, 255, 255, 255 });
+	vertices.push_back({ max.x, max.y, uvMax.x, uvMax.y, 255, 255, 255, 255 });
+
+	vertices.push_back({ min.x, min.y, uvMin.x, uvMin.y, 255, 255, 255, 255 });
+	vertices.push_back({ max.x, max.y, uvMax.x, uvMax.y, 255, 255, 255, 255 });
+	vertices.push_back({ min.x, max.y, uvMin.x, uvMax.y, 255, 255, 255, 255 });
+
+	batch.bounds.push_back(Rect{ min, max });
+}
+
+void UIRenderer::addText(std::string const &text, GLfloat scale, glm::vec3 color, anchor::Anchor anchor, glm::vec2 position)
+{
+	_textRenderer.updateLayout(_layout, text, scale, color, anchor);
+
+	if (_layout.Vertices.empty()) { return ; }
+
+	// Glyphs may go below the baseline, take the bounds from the quads
+	Rect bounds{ glm::vec2(std::numeric_limits<float>::max()), glm::vec2(std::numeric_limits<float>::lowest()) };
+
+	for (auto const &v : _layout.Vertices) {
+		bounds.min = glm::min(bounds.min, glm::vec2(v.x, v.y) + position);
+		bounds.max = glm::max(bounds.max, glm::vec2(v.x, v.y) + position);
+	}
+
+	auto &batch = getBatch(_textRenderer.getAtlas(), true, bounds);
+
+	for (auto v : _layout.Vertices) {
+		v.x += position.x;
+		v.y += position.y;
+		batch.vertices.push_back(v);
+	}
+
+	batch.bounds.push_back(bounds);
+}
+
+void UIRenderer::end()
+{
+	size_t count = 0;
+
+	for (auto &batch : _batches) {
+		batch.first = count;
+		count += batch.vertices.size();
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+
+	// Only grows, the list is rebuilt rarely
+	if (count > _capacity) {
+		_capacity = count;
+		glBufferData(GL_ARRAY_BUFFER, _capacity * sizeof(Vertex), nullptr, GL_DYNAMIC_DRAW);
+	}
+
+	for (auto const &batch : _batches) {
+		glBufferSubData(GL_ARRAY_BUFFER, batch.first * sizeof(Vertex), batch.vertices.size() * sizeof(Vertex),
+			batch.vertices.data());
+		GL_STATS(Upload(batch.vertices.size() * sizeof(Vertex)));
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void UIRenderer::render(Shader &shader)
+{
+	if (_batches.empty()) { return ; }
+
+	engine::GLState::Instance().Enable(GL_BLEND);
+	engine::GLState::Instance().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	shader.bind();
+	shader.setUniform4x4f("modelMatrix", glm::mat4(1.0f));
+
+	engine::GLState::Instance().ActiveTexture(GL_TEXTURE0);
+	engine::GLState::Instance().BindVertexArray(_vao);
+
+	for (auto const &batch : _batches) {
+		// ui.fs.glsl reads glyph coverage when the color is set
+		shader.setUniform4f("color", batch.text ? glm::vec4(1.0f) : glm::vec4(0.0f));
+		engine::GLState::Instance().BindTexture(GL_TEXTURE_2D, batch.texture);
+		glDrawArrays(GL_TRIANGLES, batch.first, batch.vertices.size());
+		GL_STATS(Draw(GL_TRIANGLES, batch.vertices.size()));
+	}
+
+	shader.unbind();
+
+	engine::GLState::Instance().Disable(GL_BLEND);
+}
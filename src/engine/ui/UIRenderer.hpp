@@ -0,0 +1,78 @@
+#pragma once
+
+#include <lazy.hpp>
+#include <string>
+#include <vector>
+#include "Anchor.hpp"
+#include "TextLayout.hpp"
+#include "TextRenderer.hpp"
+
+///
+/// Retained draw list of a UI scene.
+///
+/// The components emit their quads once, in screen space, between begin()
+/// and end(). end() merges them into one batch per texture and uploads the
+/// whole list to a single vertex buffer, render() then only issues one
+/// draw per batch until the list is built again.
+///
+/// A quad joins the last batch using its texture unless it overlaps a quad
+/// of a batch drawn after that one, so the painter's order of overlapping
+/// components is kept.
+///
+class UIRenderer
+{
+public:
+	UIRenderer();
+	~UIRenderer();
+
+	UIRenderer(UIRenderer const &) = delete;
+	void operator=(UIRenderer const &) = delete;
+
+	/// Start a new draw list
+	void begin();
+
+	/// Textured quad between the screen space corners `min` and `max`
+	void addQuad(GLuint texture, glm::vec2 min, glm::vec2 max,
+		glm::vec2 uvMin = glm::vec2(0.0f), glm::vec2 uvMax = glm::vec2(1.0f));
+
+	/// Text with the glyph atlas, `position` is where its anchor goes
+	void addText(std::string const &text, GLfloat scale, glm::vec3 color, anchor::Anchor anchor, glm::vec2 position);
+
+	/// Upload the draw list
+	void end();
+
+	/// Draw the list with `shader`, which has the layout of ui.vs.glsl
+	void render(Shader &shader);
+
+	size_t getBatchCount() const { return _batches.size(); }
+
+private:
+	using Vertex = TextLayout::Vertex;
+
+	struct Rect
+	{
+		glm::vec2 min;
+		glm::vec2 max;
+	};
+
+	struct Batch
+	{
+		GLuint texture;
+		/// Glyph coverage in the red channel rather than a color texture
+		bool text;
+		std::vector<Vertex> vertices;
+		std::vector<Rect> bounds;
+		GLint first;
+	};
+
+	std::vector<Batch> _batches;
+
+	GLuint _vao = 0;
+	GLuint _vbo = 0;
+	size_t _capacity = 0;
+
+	TextRenderer _textRenderer;
+	TextLayout _layout;
+
+	Batch &getBatch(GLuint texture, bool text, Rect const &bounds);
+};
@@ -18,7 +18,7 @@ public:
 	virtual ~IUIScene() {};
 	virtual void update() {};
 
-	std::vector<std::shared_ptr<ASceneComponent>> getSceneComponents()
+	std::vector<std::shared_ptr<ASceneComponent>> const &getSceneComponents() const
 	{
 		return _sceneComponents;
 	}
@@ -30,9 +30,14 @@ public:
 		auto component = std::make_shared<T>(this, std::forward<Args>(args)...);
 
 		_sceneComponents.push_back(component);
+		invalidate();
 		return component;
 	}
 
+	/// Changes every time a component of the scene changes its layout or look
+	size_t getVersion() const { return _version; }
+	void invalidate() { _version++; }
+
 	void call(std::string const &name);
 
 	glm::vec2 getSize() { return _size; };
@@ -41,4 +46,5 @@ private:
 	std::vector<std::shared_ptr<ASceneComponent>> _sceneComponents;
 	UI *_uiController;
 	glm::vec2 _size;
+	size_t _version = 0;
 };
@@ -5,6 +5,7 @@
 #include <chrono>
 #include <string>
 #include <map>
+#include <cstdlib>
 
 Settings::Settings()
 {
@@ -18,6 +19,33 @@ Settings::~Settings()
 void Settings::loadDefaults()
 {
 	_values["renderDistance"] = 14;
+	_values["shadowFaceBudget"] = 6;
+	_values["shadowResolution"] = 2048;
+	_values["shadowQuality"] = 1;
+	_values["ssao"] = 1;
+	_values["ssaoResolution"] = 2;
+	_values["ssaoSamples"] = 16;
+	_values["gpuProfiler"] = 1;
+	_values["gpuProfilerHud"] = 0;
+	_values["dynamicResolution"] = 0;
+	_values["targetFrameTime"] = 16.6f;
+	_values["minRenderScale"] = 0.5f;
+	_values["meshLod"] = 1;
+	_values["lodPixelError"] = 1.0f;
+	_values["shadowLodPixelError"] = 4.0f;
+	_values["optimizeOverdraw"] = 1;
+	_values["depthPrepass"] = 1;
+	_values["occlusionCulling"] = 1;
+	_values["materialTextureArrays"] = 1;
+	_values["headless"] = 0;
+	_values["windowWidth"] = 1920;
+	_values["windowHeight"] = 1080;
+	_values["benchFrames"] = 0;
+	_values["fixedDeltaTime"] = 0.0f;
+	_values["replayFile"] = std::string();
+	_values["recordFile"] = std::string();
+	_values["benchReport"] = std::string("bench.json");
+	_values["shaderCache"] = std::string("shadercache");
 	{
 		auto now = std::chrono::system_clock::now();
 		auto now_ms = std::chrono::time_point_cast<std::chrono::milliseconds>(now);
@@ -45,8 +73,11 @@ bool Settings::load(std::string const &filename)
 		case INT:
 			_values[key] = std::atoi(value.c_str());
 			break ;
+		case UINT:
+			_values[key] = static_cast<unsigned int>(std::strtoul(value.c_str(), nullptr, 10));
+			break ;
 		case FLOAT:
-			_values[key] = std::atof(value.c_str());
+			_values[key] = static_cast<float>(std::atof(value.c_str()));
 			break ;
 		case STRING:
 			_values[key] = value;
@@ -73,7 +104,35 @@ void Settings::set(std::string const &name, std::any const &value)
 auto Settings::getType(std::string const &name) -> SettingType
 {
 	std::map<std::string, SettingType> vars = {
-		{ "renderDistance", INT }
+		{ "renderDistance", INT },
+		{ "shadowFaceBudget", INT },
+		{ "shadowResolution", INT },
+		{ "shadowQuality", INT },
+		{ "ssao", INT },
+		{ "ssaoResolution", INT },
+		{ "ssaoSamples", INT },
+		{ "gpuProfiler", INT },
+		{ "gpuProfilerHud", INT },
+		{ "dynamicResolution", INT },
+		{ "targetFrameTime", FLOAT },
+		{ "minRenderScale", FLOAT },
+		{ "meshLod", INT },
+		{ "lodPixelError", FLOAT },
+		{ "shadowLodPixelError", FLOAT },
+		{ "optimizeOverdraw", INT },
+		{ "depthPrepass", INT },
+		{ "occlusionCulling", INT },
+		{ "materialTextureArrays", INT },
+		{ "headless", INT },
+		{ "windowWidth", INT },
+		{ "windowHeight", INT },
+		{ "benchFrames", INT },
+		{ "fixedDeltaTime", FLOAT },
+		{ "seed", UINT },
+		{ "replayFile", STRING },
+		{ "recordFile", STRING },
+		{ "benchReport", STRING },
+		{ "shaderCache", STRING }
 	};
 
 	if (vars.find(name) != vars.end()) {
@@ -10,6 +10,7 @@ class Settings
 private:
 	enum SettingType {
 		INT,
+		UINT,
 		FLOAT,
 		STRING
 	};
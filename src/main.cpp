@@ -1,5 +1,9 @@
 #include <fmt/format.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
 #include "Engine.hpp"
+#include "utils/Settings.hpp"
 #include "stb_image.h"
 
 #include "components/MeshComponent.hpp"
@@ -22,7 +26,7 @@ MeshComponent initSkybox()
 	};
 
 	glGenTextures(1, &textureId);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, textureId);
+	GLState::Instance().BindTexture(GL_TEXTURE_CUBE_MAP, textureId);
 
 	stbi_set_flip_vertically_on_load(false);
 	for (size_t i = 0; i < 6; i++) {
@@ -40,7 +44,7 @@ MeshComponent initSkybox()
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	GLState::Instance().BindTexture(GL_TEXTURE_CUBE_MAP, 0);
 
 	Texture texture(textureId, "skybox-cubemap", 0, 0, 0, GL_TEXTURE_CUBE_MAP);
 	TextureManager::instance().add("skybox-cubemap", std::move(texture));
@@ -89,7 +93,90 @@ MeshComponent initSkybox()
 }
 
 
-int main()
+static void PrintUsage(char const *name)
 {
+	fmt::print(stderr, "usage: {} [--headless] [--size <width>x<height>] [--bench <frames>] [--fixed-dt <seconds>]\n"
+		"          [--seed <n>] [--replay <file>] [--record <file>] [--report <file>]\n", name);
+	fmt::print(stderr, "  --headless  render offscreen, without a window or a display\n");
+	fmt::print(stderr, "  --size      size of the window or of the offscreen framebuffer\n");
+	fmt::print(stderr, "  --bench     run that many frames then write a JSON report of the timings\n");
+	fmt::print(stderr, "  --fixed-dt  advance the game by this delta time every frame\n");
+	fmt::print(stderr, "  --seed      seed of the level generator\n");
+	fmt::print(stderr, "  --replay    play back the keyboard events of a file, ignoring the real input\n");
+	fmt::print(stderr, "  --record    record the keyboard events of the session into a file\n");
+	fmt::print(stderr, "  --report    where --bench writes its report (default: bench.json)\n");
+}
+
+static bool ParseArguments(int argc, char **argv)
+{
+	auto &settings = Settings::instance();
+
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg = argv[i];
+		bool const hasValue = i + 1 < argc;
+
+		if (arg == "--headless") {
+			settings.set("headless", 1);
+		}
+		else if (arg == "--size" && hasValue) {
+			int width = 0;
+			int height = 0;
+
+			if (std::sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+				fmt::print(stderr, "Invalid size {}\n", argv[i]);
+				return false;
+			}
+			settings.set("windowWidth", width);
+			settings.set("windowHeight", height);
+		}
+		else if (arg == "--bench" && hasValue) {
+			int frames = std::atoi(argv[++i]);
+
+			if (frames <= 0) {
+				fmt::print(stderr, "Invalid frame count {}\n", argv[i]);
+				return false;
+			}
+			settings.set("benchFrames", frames);
+		}
+		else if (arg == "--fixed-dt" && hasValue) {
+			float deltaTime = std::atof(argv[++i]);
+
+			if (deltaTime <= 0.0f) {
+				fmt::print(stderr, "Invalid delta time {}\n", argv[i]);
+				return false;
+			}
+			settings.set("fixedDeltaTime", deltaTime);
+		}
+		else if (arg == "--seed" && hasValue) {
+			settings.set("seed", static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10)));
+		}
+		else if (arg == "--replay" && hasValue) {
+			settings.set("replayFile", std::string(argv[++i]));
+		}
+		else if (arg == "--record" && hasValue) {
+			settings.set("recordFile", std::string(argv[++i]));
+		}
+		else if (arg == "--report" && hasValue) {
+			settings.set("benchReport", std::string(argv[++i]));
+		}
+		else {
+			fmt::print(stderr, "Unknown argument {}\n", arg);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	// The command line overrides the config file
+	Settings::instance().load("config.ini");
+
+	if (!ParseArguments(argc, argv)) {
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
 	return engine::Engine::Instance().Run();
 }
@@ -9,6 +9,7 @@
 #include "components/PointLightComponent.hpp"
 #include "components/MeshComponent.hpp"
 #include "components/Run42Player.hpp"
+#include "components/DynamicShadowCasterComponent.hpp"
 #include "components/BoxColliderComponent.hpp"
 #include "components/TextComponent.hpp"
 
@@ -18,6 +19,7 @@
 #include "systems/Run42PlayerSystem.hpp"
 #include "systems/Collision3DSystem.hpp"
 #include "systems/TextRendererSystem.hpp"
+#include "systems/GpuProfilerHudSystem.hpp"
 
 #include <random>
 
@@ -55,7 +57,6 @@ class PlayScene : public Scene
 	unsigned int _totalNumberOfRows = 0;
 
 	// Random value generator for the level generator
-	std::random_device _RandomDevice;
 	std::default_random_engine _RandomEngine;
 
 	engine::Model _DoorModel;
@@ -178,6 +179,8 @@ class PlayScene : public Scene
 		_PlayerCamera = ECS().EntityManager->CreateEntity<PlayerCameraComponent, TransformComponent>();
 		auto &camera = _PlayerCamera->Get<PlayerCameraComponent>();
 			camera = PlayerCameraComponent::New();
+			// Rows of desks, pillars and walls overlap a lot
+			camera.depthPrepass = true;
 		auto &camTrans = _PlayerCamera->Get<TransformComponent>();
 			camTrans = TransformComponent::New();
 			camTrans.position = { -180.0f, 150.0f, 0.0f };
@@ -193,6 +196,7 @@ class PlayScene : public Scene
 			playerTrans.scale = { 0.1f, 0.1f, 0.1f };
 
 		_Player->Set(BoxCollider3DComponent::New({ -10.0f, 0.0f, -10.0f }, { 20.0f, 100.0f, 20.0f }));
+		_Player->AddComponents<DynamicShadowCasterComponent>();
 
 		for (int i = 0; i < 10; i++) {
 			GenerateRow();
@@ -381,7 +385,11 @@ public:
 
 		_MeshShader = shaderId;
 
-		_RandomEngine = std::default_random_engine(_RandomDevice());
+		// Seeded from the settings so that a run can be reproduced (--seed)
+		auto seed = std::any_cast<unsigned int>(Settings::instance().get("seed"));
+
+		Logger::Info("PlayScene: seed {}\n", seed);
+		_RandomEngine = std::default_random_engine(seed);
 	}
 
 	void Setup() override
@@ -391,6 +399,7 @@ public:
 		ECS().SystemManager->InstantiateSystem<CameraMovementSystem>();
 		ECS().SystemManager->InstantiateSystem<Run42PlayerSystem>();
 		ECS().SystemManager->InstantiateSystem<Collision3DSystem>();
+		ECS().SystemManager->InstantiateSystem<GpuProfilerHudSystem>();
 
 		_ScoreText = ECS().EntityManager->CreateEntity<TextComponent>();
 
@@ -398,6 +407,15 @@ public:
 
 		_ScoreText->Set(text);
 
+		auto profilerText = ECS().EntityManager->CreateEntity<TextComponent, GpuProfilerHudComponent>();
+		profilerText->Set(TextComponent::New("", 0.4f, { 1.0f, 1.0f, 1.0f }, anchor::Anchor::TopLeft));
+
+#ifdef ENGINE_GL_STATS
+		auto glStatsText = ECS().EntityManager->CreateEntity<TextComponent, GpuProfilerHudComponent>();
+		glStatsText->Set(TextComponent::New("", 0.4f, { 1.0f, 1.0f, 1.0f }, anchor::Anchor::Left));
+		glStatsText->Get<GpuProfilerHudComponent>().GLCalls = true;
+#endif
+
 		SetupLevel();
 	}
 
@@ -425,9 +443,7 @@ public:
 			_moveSpeed += 1.0f * deltaTime;
 			_distanceTraveled += 300.0f * deltaTime;
 
-			auto text = TextComponent::New(fmt::format(formatStr, static_cast<size_t>(_distanceTraveled / 100), _moveSpeed / 100, _highScore));
-
-			_ScoreText->Set(text);
+			_ScoreText->Get<TextComponent>().Format(formatStr, static_cast<size_t>(_distanceTraveled / 100), _moveSpeed / 100, _highScore);
 
 			if (kbd.getKeyDown(GLFW_KEY_ESCAPE)) {
 				_State = SceneState::Paused;
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Framebuffer.hpp"
+#include "Engine.hpp"
+#include "GLStats.hpp"
 #include "ecs/System.hpp"
 #include <glm/vec3.hpp>
 
@@ -47,11 +49,18 @@ public:
 
 	void OnUpdate(float) override
 	{
+		auto display = engine::Engine::Instance().GetDisplay();
+
+		// Minimized window, nothing to render to
+		if (display->getWidth() <= 0 || display->getHeight() <= 0) { return ; }
+
+		_framebuffer.Resize(display->getWidth(), display->getHeight());
+
 		// first pass
 		_framebuffer.Bind();
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // we're not using the stencil buffer now
-		glEnable(GL_DEPTH_TEST);
+		engine::GLState::Instance().Enable(GL_DEPTH_TEST);
 		// DrawScene();
 
 		// second pass
@@ -60,8 +69,9 @@ public:
 		glClear(GL_COLOR_BUFFER_BIT);
 
 		_shader.bind();
-		glDisable(GL_DEPTH_TEST);
+		engine::GLState::Instance().Disable(GL_DEPTH_TEST);
 //		glBindTexture(GL_TEXTURE_2D, textureColorbuffer);
 		glDrawArrays(GL_TRIANGLES, 0, 6);
+		GL_STATS(Draw(GL_TRIANGLES, 6));
 	}
 };
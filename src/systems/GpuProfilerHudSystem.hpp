@@ -0,0 +1,62 @@
+#pragma once
+
+#include "ecs/System.hpp"
+#include "components/TextComponent.hpp"
+#include "components/GpuProfilerHudComponent.hpp"
+#include "GpuProfiler.hpp"
+#include "GLStats.hpp"
+#include "utils/Settings.hpp"
+
+///
+/// Writes the GpuProfiler summary, or the GLStats one, into the tagged text
+/// entities. The summaries are refreshed a few times per second and only
+/// assigned when they differ, the text is laid out again only then.
+///
+class GpuProfilerHudSystem : public ecs::ComponentSystem
+{
+private:
+	static constexpr float RefreshInterval = 0.25f;
+
+	float _sinceRefresh = RefreshInterval;
+
+	static void SetText(TextComponent &text, std::string const &value)
+	{
+		if (text.Text != value) { text.Text = value; }
+	}
+
+public:
+	void OnUpdate(float deltaTime) override
+	{
+		auto &profiler = engine::GpuProfiler::Instance();
+		bool hud = std::any_cast<int>(Settings::instance().get("gpuProfilerHud"));
+		bool visible = profiler.IsEnabled() && hud;
+
+		_sinceRefresh += deltaTime;
+
+		// Hiding is immediate, the values wait for the next refresh
+		bool refresh = _sinceRefresh >= RefreshInterval;
+
+		if (refresh) { _sinceRefresh = 0.0f; }
+
+		std::string summary;
+		std::string glSummary;
+
+		if (refresh && visible) { summary = profiler.GetSummary(); }
+#ifdef ENGINE_GL_STATS
+		if (refresh && hud) { glSummary = engine::GLStats::Instance().GetSummary(); }
+#endif
+
+		for (auto const &ent : GetEntities<TextComponent, GpuProfilerHudComponent>()) {
+			auto &text = ent->Get<TextComponent>();
+			bool glCalls = ent->Get<GpuProfilerHudComponent>().GLCalls;
+			bool shown = glCalls ? hud : visible;
+
+#ifndef ENGINE_GL_STATS
+			if (glCalls) { continue ; }
+#endif
+
+			if (!shown) { SetText(text, ""); }
+			else if (refresh) { SetText(text, glCalls ? glSummary : summary); }
+		}
+	}
+};
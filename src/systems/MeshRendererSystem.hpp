@@ -10,15 +10,28 @@
 #include "components/PointLightComponent.hpp"
 #include "components/DirectionalLightComponent.hpp"
 #include "components/ModelComponent.hpp"
+#include "components/DynamicShadowCasterComponent.hpp"
 #include "Engine.hpp"
-#include "Framebuffer.hpp"
 #include "ShaderManager.hpp"
 #include <fmt/format.h>
 #include <glm/gtx/projection.hpp>
 #include "Engine.hpp"
 #include <random>
+#include <limits>
+#include <tuple>
+#include <unordered_set>
 #include "GBuffer.hpp"
+#include "SSAO.hpp"
 #include "TextureAutoBind.hpp"
+#include "ShadowCache.hpp"
+#include "LightClusters.hpp"
+#include "GpuProfiler.hpp"
+#include "DynamicResolution.hpp"
+#include "OcclusionCuller.hpp"
+#include "MaterialAtlas.hpp"
+#include "InstanceBuffer.hpp"
+#include "RenderGraph.hpp"
+#include "utils/Settings.hpp"
 
 class MeshRendererSystem : public ecs::ComponentSystem
 {
@@ -26,26 +39,124 @@ private:
 	lazy::graphics::Shader _billboard;
 	lazy::graphics::Shader _light;
 	lazy::graphics::Shader _shadow;
+	lazy::graphics::Shader _shadowFace;
+	lazy::graphics::Shader _depth;
 	engine::Mesh _quad;
 
-	GLuint _ssaoFb;
-	GLuint _ssaoBlurFb;
-	GLuint _ssaoColorBuf;
-	GLuint _ssaoNoiseTex;
-	GLuint _ssaoBlurTex;
-	lazy::graphics::Shader _ssaoShader;
-	lazy::graphics::Shader _ssaoBlurShader;
+	template <typename T>
+	using Uniform = lazy::graphics::UniformHandle<T>;
+
+	/// Uniforms set for every mesh drawn
+	struct ModelUniforms
+	{
+		/// Shadow shaders only, basic.vs and depth.vs read it per instance
+		Uniform<glm::mat4> ModelMatrix;
+		Uniform<glm::vec3> PositionScale;
+		Uniform<glm::vec3> PositionOffset;
+
+		ModelUniforms(lazy::graphics::Shader &shader)
+			: ModelMatrix(shader, "modelMatrix"),
+			PositionScale(shader, "positionScale"),
+			PositionOffset(shader, "positionOffset")
+		{}
+
+		/// Positions of quantized meshes are decoded in the vertex shader
+		void SetPositionDecode(engine::Mesh const *mesh)
+		{
+			PositionScale.set(mesh ? mesh->GetPositionScale() : glm::vec3(1.0f));
+			PositionOffset.set(mesh ? mesh->GetPositionOffset() : glm::vec3(0.0f));
+		}
+	};
+
+	/// Uniforms of the shaders of the models drawn into the G-buffer
+	struct MeshUniforms : ModelUniforms
+	{
+		Uniform<glm::mat4> ViewProjectionMatrix;
+		Uniform<glm::mat4> ViewMatrix;
+		Uniform<glm::mat4> ProjectionMatrix;
+		Uniform<glm::vec3> ViewPos;
+		Uniform<GLint> AlbedoArray;
+		Uniform<GLint> NormalArray;
+		Uniform<GLint> MetallicRoughnessArray;
+		Uniform<GLint> UseMaterialArrays;
+		Uniform<glm::vec4> BaseColor;
+		Uniform<GLfloat> MetallicFactor;
+		Uniform<GLfloat> RoughnessFactor;
+		Uniform<GLint> HasAlbedo;
+		Uniform<GLint> HasMetallicRoughness;
+
+		MeshUniforms(lazy::graphics::Shader &shader)
+			: ModelUniforms(shader),
+			ViewProjectionMatrix(shader, "viewProjectionMatrix"),
+			ViewMatrix(shader, "viewMatrix"),
+			ProjectionMatrix(shader, "projectionMatrix"),
+			ViewPos(shader, "viewPos"),
+			AlbedoArray(shader, "albedoArray"),
+			NormalArray(shader, "normalArray"),
+			MetallicRoughnessArray(shader, "metallicRoughnessArray"),
+			UseMaterialArrays(shader, "useMaterialArrays"),
+			BaseColor(shader, "material.baseColor"),
+			MetallicFactor(shader, "material.metallicFactor"),
+			RoughnessFactor(shader, "material.roughnessFactor"),
+			HasAlbedo(shader, "material.hasAlbedo"),
+			HasMetallicRoughness(shader, "material.hasMetallicRoughness")
+		{}
+	};
+
+	struct DirectionalLightUniforms
+	{
+		Uniform<glm::vec3> Direction;
+		Uniform<glm::vec3> Color;
+		Uniform<GLfloat> Intensity;
+	};
+
+	/// MAX_NUM_DIRECTIONAL_LIGHTS of light.fs.glsl
+	static constexpr size_t MaxDirectionalLights = 1;
+
+	ModelUniforms _depthUniforms{ _depth };
+	ModelUniforms _shadowUniforms{ _shadow };
+	ModelUniforms _shadowFaceUniforms{ _shadowFace };
+	Uniform<glm::mat4> _shadowMatrices{ _shadow, "shadowMatrices" };
+	Uniform<glm::mat4> _shadowMatrix{ _shadowFace, "shadowMatrix" };
+	std::vector<DirectionalLightUniforms> _directionalLights;
+
+	/// Handles of the model shaders, by id as the manager never reuses them
+	std::unordered_map<unsigned int, MeshUniforms> _meshUniforms;
 
 	GBuffer _gBuffer;
+	SSAO _ssao;
+
+	DynamicResolution _dynamicResolution;
+
+	// Passes of the frame, rebuilt every OnUpdate
+	engine::RenderGraph _graph;
+
+	std::unique_ptr<ShadowCache> _shadowCache;
+
+	engine::OcclusionCuller _occlusion;
+	// Entities hidden behind last frame's geometry, skipped by every pass
+	std::unordered_set<unsigned int> _occluded;
+
+	// Model matrices and material indices of the depth and G-buffer passes
+	engine::InstanceBuffer _instances;
+	std::vector<engine::InstanceBuffer::Instance> _instanceData;
+
+	// Material textures packed in arrays, rebuilt when the materials change
+	engine::MaterialAtlas _materialAtlas;
+	size_t _materialAtlasVersion = std::numeric_limits<size_t>::max();
 
-	GLuint _depthmapFb;
-	GLuint _depthCubemap;
-	glm::mat4 _shadowProjection;
+	engine::LightClusters _lightClusters;
+	std::vector<engine::LightClusters::PointLight> _pointLights;
 
 	Callback<> buildShadowMap;
 
-	static constexpr unsigned int ShadowWidth  = 2048;
-	static constexpr unsigned int ShadowHeight = 2048;
+	static constexpr float ShadowNear = 1.0f;
+	static constexpr float ShadowFar = 1000.0f;
+	static constexpr float ShadowFarPlane = 10000.0f;
+
+	// Maximum extent of a caster from its origin (a map tile is 200x200)
+	// Used to decide if a caster is in range of the light
+	static constexpr float ShadowCasterRadius = 200.0f;
 
 	void InitDepthCubemap()
 	{
@@ -55,37 +166,46 @@ private:
 			.link();
 		assert(_shadow.isValid());
 
-		_shadow.bind();
+		_shadowFace.addVertexShader("shaders/shadowface.vs.glsl")
+			.addFragmentShader("shaders/shadow.fs.glsl")
+			.link();
 
-		float aspect = static_cast<float>(ShadowWidth) / static_cast<float>(ShadowHeight);
-		float near = 1.0f;
-		float far = 1000.0f;
-		_shadowProjection = glm::perspective(glm::radians(90.0f), aspect, near, far);
+		CreateShadowCache();
+	}
 
-		glGenFramebuffers(1, &_depthmapFb);
-		glBindFramebuffer(GL_FRAMEBUFFER, _depthmapFb);
+	void CreateShadowCache()
+	{
+		auto resolution = std::any_cast<int>(Settings::instance().get("shadowResolution"));
 
-		glGenTextures(1, &_depthCubemap);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, _depthCubemap);
-		for (size_t face = 0; face < 6; face++) {
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT, ShadowWidth, ShadowHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+		if (resolution <= 0) {
+			Logger::Warn("Invalid shadowResolution {}, using 2048\n", resolution);
+			resolution = 2048;
 		}
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
-		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, _depthCubemap, 0);
-		glDrawBuffer(GL_NONE);
-		glReadBuffer(GL_NONE);
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		_shadowCache = std::make_unique<ShadowCache>(static_cast<unsigned int>(resolution), ShadowNear, ShadowFar);
 	}
 
-	void BindShadowMap()
+	///
+	/// Apply the shadow settings that may have changed since the last frame.
+	/// A new resolution rebuilds the whole shadow cache.
+	///
+	ShadowQuality UpdateShadowSettings()
 	{
-		glViewport(0, 0, ShadowWidth, ShadowHeight);
-		glBindFramebuffer(GL_FRAMEBUFFER, _depthmapFb);
+		auto resolution = std::any_cast<int>(Settings::instance().get("shadowResolution"));
+		auto quality = std::any_cast<int>(Settings::instance().get("shadowQuality"));
+
+		if (resolution > 0 && static_cast<unsigned int>(resolution) != _shadowCache->GetSize()) {
+			CreateShadowCache();
+		}
+
+		quality = std::clamp(quality, static_cast<int>(ShadowQuality::Off), static_cast<int>(ShadowQuality::Pcf));
+
+		auto shadowQuality = static_cast<ShadowQuality>(quality);
+
+		_shadowCache->SetCompareMode(shadowQuality == ShadowQuality::Hardware ||
+			shadowQuality == ShadowQuality::Poisson);
+
+		return shadowQuality;
 	}
 
 	void UnbindShadowMap()
@@ -93,7 +213,7 @@ private:
 		auto display = engine::Engine::Instance().GetDisplay();
 		auto [ width, height ] = std::tuple(display->getWidth(), display->getHeight());
 
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		engine::GLState::Instance().BindFramebuffer(GL_FRAMEBUFFER, 0);
 		glViewport(0, 0, width, height);
 	}
 
@@ -124,11 +244,6 @@ private:
 
 	}
 
-	void InitFramebuffer()
-	{
-		InitQuad();
-	}
-
 	void InitBillboard()
 	{
 		_billboard.addVertexShader("shaders/billboard.vs.glsl")
@@ -136,151 +251,79 @@ private:
 			.link();
 	}
 
-	void InitSSAO()
+	///
+	/// Level of detail of `mesh` seen from `eye`. `pixelsPerUnit` is the size in
+	/// pixels of one unit at a distance of one unit (projection[1][1] * height / 2).
+	///
+	size_t SelectLod(engine::Mesh const &mesh, TransformComponent const &transform, glm::vec3 const &eye,
+		float pixelsPerUnit, float maxPixelError)
 	{
-		auto display = engine::Engine::Instance().GetDisplay();
-		auto [ width, height ] = std::tuple(display->getWidth(), display->getHeight());
+		if (mesh.GetLodCount() < 2 || !std::any_cast<int>(Settings::instance().get("meshLod"))) {
+			return 0;
+		}
 
-		_ssaoShader.addVertexShader("shaders/ssao.vs.glsl")
-			.addFragmentShader("shaders/ssao.fs.glsl")
-			.link();
-		assert(_ssaoShader.isValid());
+		glm::vec3 center = transform.position + transform.scale * mesh.GetBoundsCenter();
+		float radius = mesh.GetBoundsRadius() * std::max({ transform.scale.x, transform.scale.y, transform.scale.z });
+		float distance = glm::distance(center, eye);
 
-		glGenFramebuffers(1, &_ssaoFb);
-		glBindFramebuffer(GL_FRAMEBUFFER, _ssaoFb);
+		if (distance <= radius) { return 0; }
 
-		glGenTextures(1, &_ssaoColorBuf);
-		glBindTexture(GL_TEXTURE_2D, _ssaoColorBuf);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, width, height, 0, GL_RED, GL_FLOAT, nullptr);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		return mesh.SelectLod(radius / distance * pixelsPerUnit, maxPixelError);
+	}
 
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _ssaoColorBuf, 0);
-		assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	///
+	/// Test the static models against the occluders of the previous frames.
+	/// Moving entities are always drawn: their old depth says nothing about
+	/// where they are now.
+	///
+	void UpdateOcclusion()
+	{
+		auto mode = std::clamp(std::any_cast<int>(Settings::instance().get("occlusionCulling")),
+			static_cast<int>(engine::OcclusionMode::Off), static_cast<int>(engine::OcclusionMode::Queries));
 
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		_occlusion.BeginFrame(static_cast<engine::OcclusionMode>(mode));
+		_occluded.clear();
 
-		GenSSAOKernel();
+		if (mode == static_cast<int>(engine::OcclusionMode::Off)) { return ; }
 
-		_ssaoShader.bind();
-		_ssaoShader.setUniform1i("gPosition", 0);
-		_ssaoShader.setUniform1i("gNormal", 1);
-		_ssaoShader.setUniform1i("texNoise", 2);
-		_ssaoShader.unbind();
+		for (auto const entity : GetEntities<ModelComponent, TransformComponent>()) {
+			if (entity->HasComponents<DynamicShadowCasterComponent>()) { continue ; }
 
-		_ssaoBlurShader.addVertexShader("shaders/ssao.vs.glsl")
-			.addFragmentShader("shaders/ssaoblur.fs.glsl")
-			.link();
-		_ssaoBlurShader.bind();
-		_ssaoBlurShader.setUniform1i("ssaoInput", 0);
-
-		glGenFramebuffers(1, &_ssaoBlurFb);
-		glBindFramebuffer(GL_FRAMEBUFFER, _ssaoBlurFb);
-
-		glGenTextures(1, &_ssaoBlurFb);
-		glBindTexture(GL_TEXTURE_2D, _ssaoBlurFb);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, width, height, 0, GL_RED, GL_FLOAT, nullptr);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _ssaoColorBuf, 0);
-	}
+			auto const [ model, transform ] = entity->GetAll();
 
-	void GenSSAOKernel()
-	{
-		std::uniform_real_distribution<float> randomFloats(0.0f, 1.0f);
-		std::default_random_engine generator;
-		std::vector<glm::vec3> ssaoKernel;
+			glm::vec3 min(std::numeric_limits<float>::max());
+			glm::vec3 max(std::numeric_limits<float>::lowest());
+			bool bounded = false;
 
-		auto lerp = [] (float a, float b, float f) -> float {
-			return a + f * (b - a);
-		};
+			for (auto const meshId : model.Meshes) {
+				auto const *mesh = dynamic_cast<engine::Mesh const *>(engine::Engine::Instance().GetMesh(meshId));
 
-		for (size_t i = 0; i < 64; i++) {
-			glm::vec3 sample(randomFloats(generator) * 2.0f - 1.0f,
-							 randomFloats(generator) * 2.0f - 1.0f,
-							 randomFloats(generator));
-			sample = glm::normalize(sample);
-			sample *= randomFloats(generator);
-
-			// Make distribution closer to origin
-			float scale = static_cast<float>(i) / 64.0f;
-			scale = lerp(0.1f, 1.0f, scale * scale);
-			sample *= scale;
-
-			ssaoKernel.push_back(sample);
-		}
-
-		std::array<glm::vec3, 64> ssaoNoise;
-		for (size_t i = 0; i < 64; i++) {
-			glm::vec3 noise(randomFloats(generator) * 2.0f - 1.0f,
-							randomFloats(generator) * 2.0f - 1.0f,
-							0.0f);
-			ssaoNoise[i] = noise;
-		}
-
-		glGenTextures(1, &_ssaoNoiseTex);
-		glBindTexture(GL_TEXTURE_2D, _ssaoNoiseTex);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, 4, 4, 0, GL_RGB, GL_FLOAT, &ssaoNoise[0]);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glBindTexture(GL_TEXTURE_2D, 0);
-
-		_ssaoShader.bind();
-//		GLuint sampleLoc = _ssaoShader.getUniformLocation("samples");
-		for (size_t i = 0; i < 64; i++) {
-			_ssaoShader.setUniform3f("samples[" + std::to_string(i) + "]", ssaoKernel[i]);
-		}
-//		glUniform3fv(sampleLoc, 64, &ssaoKernel[0][0]);
-		_ssaoShader.unbind();
-	}
+				if (mesh == nullptr) { continue ; }
 
-	void RenderSSAO(PlayerCameraComponent const &camera)
-	{
-		glBindFramebuffer(GL_FRAMEBUFFER, _ssaoFb);
-		_ssaoShader.bind();
-		_ssaoShader.setUniform1i("gPosition", 0);
-		_ssaoShader.setUniform1i("gNormal", 1);
-		_ssaoShader.setUniform1i("texNoise", 2);
-
-		glClear(GL_COLOR_BUFFER_BIT);
-		glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, _gBuffer.GetPositionTex());
-		glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, _gBuffer.GetNormalTex());
-		glActiveTexture(GL_TEXTURE2);
-			glBindTexture(GL_TEXTURE_2D, _ssaoNoiseTex);
-
-		_ssaoShader.setUniform4x4f("projectionMatrix", camera.projection);
-		_ssaoShader.setUniform4x4f("viewMatrix", camera.view);
-		_quad.Draw();
-
-		glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, 0);
-		glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, 0);
-		glActiveTexture(GL_TEXTURE2);
-			glBindTexture(GL_TEXTURE_2D, 0);
-		_ssaoShader.unbind();
-
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-//		glBindFramebuffer(GL_FRAMEBUFFER, _ssaoBlurFb);
-//
-//		_ssaoBlurShader.bind();
-//		_ssaoBlurShader.setUniform1i("ssaoInput", 0);
-//		glActiveTexture(GL_TEXTURE0);
-//		glBindTexture(GL_TEXTURE_2D, _ssaoColorBuf);
-//		_quad.Draw();
-//		glBindTexture(GL_TEXTURE_2D, 0);
-//		_ssaoShader.unbind();
-
-//		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+				glm::vec3 center = transform.position + transform.scale * mesh->GetBoundsCenter();
+				glm::vec3 extent = glm::abs(transform.scale) * mesh->GetBoundsExtent();
+
+				min = glm::min(min, center - extent);
+				max = glm::max(max, center + extent);
+				bounded = true;
+			}
+
+			if (bounded && !_occlusion.IsVisible(entity->GetId(), { min, max })) {
+				_occluded.insert(entity->GetId());
+			}
+		}
 	}
 
-	void RenderShadowMeshes()
+	///
+	/// Draw the casters in range of the light, shadow maps are lower resolution
+	/// than the screen so they accept a coarser level of detail
+	///
+	void RenderShadowMeshes(ModelUniforms &uniforms, std::vector<ecs::IEntity<ModelComponent, TransformComponent>*> const &entities,
+		glm::vec3 const &lightPos)
 	{
-		auto entities = GetEntities<ModelComponent, TransformComponent>();
+		// Faces of the cube map have a 90 degrees field of view
+		float pixelsPerUnit = _shadowCache->GetSize() * 0.5f;
+		auto maxPixelError = std::any_cast<float>(Settings::instance().get("shadowLodPixelError"));
 
 		for (auto const entity: entities) {
 
@@ -293,21 +336,268 @@ private:
 				glm::mat4 model(1.0f);
 				model = glm::translate(model, transform.position);
 				model = glm::scale(model, transform.scale);
-				_shadow.setUniform4x4f("modelMatrix", model);
+				uniforms.ModelMatrix.set(model);
+
+				auto const *meshCast = dynamic_cast<engine::Mesh const *>(mesh);
+				uniforms.SetPositionDecode(meshCast);
 
-				mesh->Draw();
+				if (meshCast != nullptr) {
+					meshCast->DrawLod(SelectLod(*meshCast, transform, lightPos, pixelsPerUnit, maxPixelError));
+				}
+				else {
+					mesh->Draw();
+				}
 			}
 
 		}
 	}
 
-	void RenderMeshes(PlayerCameraComponent const &camera, TransformComponent const &playerTransform)
+	static glm::mat4 GetModelMatrix(TransformComponent const &transform)
+	{
+		glm::mat4 modelMatrix(1.0f);
+		modelMatrix = glm::translate(modelMatrix, transform.position);
+		modelMatrix = glm::scale(modelMatrix, transform.scale);
+
+		return modelMatrix;
+	}
+
+	///
+	/// Draw `mesh` once per instance of _instanceData[first, first + count), in
+	/// as few calls as the instance buffer allows. Drawables that are not an
+	/// engine::Mesh, and every mesh without instanced arrays, are drawn one
+	/// instance at a time.
+	///
+	void DrawInstances(IDrawable const *drawable, engine::Mesh const *mesh, size_t lod, size_t first, size_t count)
+	{
+		using engine::InstanceBuffer;
+
+		if (mesh == nullptr || !_instances.IsSupported()) {
+			for (size_t i = first; i < first + count; i++) {
+				InstanceBuffer::SetCurrent(_instanceData[i]);
+				if (mesh != nullptr) { mesh->DrawLod(lod); }
+				else { drawable->Draw(); }
+			}
+			return ;
+		}
+
+		for (size_t i = first; i < first + count; i += InstanceBuffer::MaxInstances) {
+			size_t const instances = std::min(InstanceBuffer::MaxInstances, first + count - i);
+			auto offset = _instances.Upload(&_instanceData[i], instances);
+
+			if (!offset.has_value()) {
+				Logger::Error("MeshRendererSystem: could not write {} instances\n", instances);
+				return ;
+			}
+
+			mesh->Bind();
+			_instances.Attach(offset.value());
+			mesh->DrawLodInstanced(lod, instances);
+		}
+	}
+
+	///
+	/// Write the depth of every mesh with the same levels of detail as RenderMeshes.
+	/// The instances of a mesh are drawn together, also through InstanceBuffer
+	/// so that depth.vs gets its model matrix from the same place as basic.vs.
+	///
+	void RenderDepthPrepass(PlayerCameraComponent const &camera, TransformComponent const &playerTransform, int height)
+	{
+		float pixelsPerUnit = camera.projection[1][1] * height * 0.5f;
+		auto maxPixelError = std::any_cast<float>(Settings::instance().get("lodPixelError"));
+
+		struct Draw
+		{
+			IDrawable const *Mesh;
+			engine::Mesh const *MeshCast;
+			size_t Lod;
+			engine::InstanceBuffer::Instance Instance;
+		};
+
+		std::vector<Draw> draws;
+
+		for (auto const &entity : GetEntities<ModelComponent, TransformComponent>()) {
+
+			if (_occluded.count(entity->GetId())) { continue ; }
+
+			auto const [ model, transform ] = entity->GetAll();
+			auto const modelMatrix = GetModelMatrix(transform);
+
+			for (auto const meshId : model.Meshes) {
+
+				auto const *mesh = engine::Engine::Instance().GetMesh(meshId);
+				auto const *meshCast = dynamic_cast<engine::Mesh const *>(mesh);
+				size_t lod = meshCast != nullptr
+					? SelectLod(*meshCast, transform, playerTransform.position, pixelsPerUnit, maxPixelError)
+					: 0;
+
+				draws.push_back({ mesh, meshCast, lod, { modelMatrix, 0.0f } });
+			}
+		}
+
+		std::stable_sort(draws.begin(), draws.end(), [] (Draw const &a, Draw const &b) {
+			return std::tie(a.Mesh, a.Lod) < std::tie(b.Mesh, b.Lod);
+		});
+
+		// The instances of each run of the same mesh and level are contiguous
+		_instanceData.clear();
+		for (auto const &draw : draws) {
+			_instanceData.push_back(draw.Instance);
+		}
+
+		_depth.bind();
+		_depth.setUniform4x4f("viewProjectionMatrix", camera.viewProjection);
+
+		for (size_t first = 0; first < draws.size(); ) {
+			auto const &draw = draws[first];
+			size_t last = first + 1;
+
+			while (last < draws.size() && draws[last].Mesh == draw.Mesh && draws[last].Lod == draw.Lod) {
+				last++;
+			}
+
+			_depthUniforms.SetPositionDecode(draw.MeshCast);
+			DrawInstances(draw.Mesh, draw.MeshCast, draw.Lod, first, last - first);
+
+			first = last;
+		}
+
+		_depth.unbind();
+	}
+
+	void UpdateMaterialAtlas()
+	{
+		auto const version = engine::Engine::Instance().GetPbrMaterialsVersion();
+
+		if (version == _materialAtlasVersion) { return ; }
+
+		_materialAtlas.Build(engine::Engine::Instance().GetPbrMaterials());
+		_materialAtlasVersion = version;
+	}
+
+	void BindMaterialTextures(MeshUniforms &uniforms, PbrMaterial const &m,
+		std::vector<TextureAutoBind> &textureBindings)
+	{
+		uniforms.BaseColor.set(m.BaseColor);
+		uniforms.MetallicFactor.set(m.MetallicFactor);
+		uniforms.RoughnessFactor.set(m.RoughnessFactor);
+
+		if (m.Albedo.has_value()) {
+			auto albedo = m.Albedo.value();
+			auto texture = TextureManager::instance().get(albedo);
+
+			uniforms.HasAlbedo.set(1);
+			textureBindings.push_back(TextureAutoBind(GL_TEXTURE0, GL_TEXTURE_2D, texture));
+		}
+		else {
+			uniforms.HasAlbedo.set(0);
+			engine::GLState::Instance().BindTexture(GL_TEXTURE0, GL_TEXTURE_2D, 0);
+		}
+
+		if (m.MetallicRoughness.has_value()) {
+			auto metallicRoughness = m.MetallicRoughness.value();
+			auto texture = TextureManager::instance().get(metallicRoughness);
+
+			uniforms.HasMetallicRoughness.set(1);
+			textureBindings.push_back(TextureAutoBind(GL_TEXTURE1, GL_TEXTURE_2D, texture));
+		}
+		else {
+			uniforms.HasMetallicRoughness.set(0);
+			engine::GLState::Instance().BindTexture(GL_TEXTURE1, GL_TEXTURE_2D, 0);
+		}
+
+		if (m.Normal.has_value()) {
+			auto normal = m.Normal.value();
+			auto texture = TextureManager::instance().get(normal);
+
+			textureBindings.push_back(TextureAutoBind(GL_TEXTURE2, GL_TEXTURE_2D, texture));
+		}
+		else {
+			auto const defaultNormal = TextureManager::instance().get("default_normal");
+			textureBindings.push_back(TextureAutoBind(GL_TEXTURE2, GL_TEXTURE_2D, defaultNormal));
+		}
+	}
+
+	///
+	/// Textures of a draw without a material: nothing on the albedo and
+	/// metallic-roughness units, a flat normal map. basic.fs samples them
+	/// anyway, and must not read the G-buffer targets the lighting pass of
+	/// the last frame left there.
+	///
+	void BindDefaultMaterialTextures()
+	{
+		auto &state = engine::GLState::Instance();
+
+		state.BindTexture(GL_TEXTURE0, GL_TEXTURE_2D, 0);
+		state.BindTexture(GL_TEXTURE1, GL_TEXTURE_2D, 0);
+		state.BindTexture(GL_TEXTURE2, GL_TEXTURE_2D, TextureManager::instance().get("default_normal"));
+	}
+
+	/// The program of the shader must be bound
+	MeshUniforms &GetMeshUniforms(unsigned int shaderId, lazy::graphics::Shader &shader)
+	{
+		auto uniforms = _meshUniforms.find(shaderId);
+
+		if (uniforms == _meshUniforms.end()) {
+			uniforms = _meshUniforms.emplace(shaderId, MeshUniforms(shader)).first;
+
+			// Whether the arrays are used or not: left on unit 0 they would share
+			// it with the sampler2D of the albedo, which fails every draw
+			uniforms->second.AlbedoArray.set(engine::MaterialAtlas::AlbedoUnit);
+			uniforms->second.NormalArray.set(engine::MaterialAtlas::NormalUnit);
+			uniforms->second.MetallicRoughnessArray.set(engine::MaterialAtlas::MetallicRoughnessUnit);
+		}
+
+		return uniforms->second;
+	}
+
+	///
+	/// Draw the models into the G-buffer.
+	/// Draws are sorted by shader, material bucket, material, mesh and level
+	/// of detail. The instances of a mesh that share the rest are drawn in one
+	/// call: with the material textures packed in arrays the material index is
+	/// per instance, so meshes of different materials of a bucket are merged.
+	///
+	void RenderMeshes(PlayerCameraComponent const &camera, TransformComponent const &playerTransform, int height)
 	{
 		auto models = GetEntities<ModelComponent, TransformComponent>();
 
+		float pixelsPerUnit = camera.projection[1][1] * height * 0.5f;
+		auto maxPixelError = std::any_cast<float>(Settings::instance().get("lodPixelError"));
+		bool const useArrays = std::any_cast<int>(Settings::instance().get("materialTextureArrays"));
+
+		struct Draw
+		{
+			lazy::graphics::Shader *Shader;
+			unsigned int ShaderId;
+			IDrawable const *Mesh;
+			engine::Mesh const *MeshCast;
+			size_t Lod;
+			std::optional<engine::MaterialAtlas::Entry> Packed;
+			/// Textures bound one by one, when not packed
+			PbrMaterial const *Material;
+			engine::InstanceBuffer::Instance Instance;
+
+			size_t GetBucket() const
+			{
+				return Packed.has_value() ? Packed->Bucket : std::numeric_limits<size_t>::max();
+			}
+
+			/// Draws that differ only by their instance
+			bool SameBatch(Draw const &other) const
+			{
+				return Shader == other.Shader && GetBucket() == other.GetBucket()
+					&& Material == other.Material && Mesh == other.Mesh && Lod == other.Lod;
+			}
+		};
+
+		std::vector<Draw> draws;
+
 		for (auto const &entity : models) {
 
-			auto const [ model, transform ] = entity->GetAll();
+			if (_occluded.count(entity->GetId())) { continue ; }
+
+			auto const &[ model, transform ] = entity->GetAll();
+			auto const modelMatrix = GetModelMatrix(transform);
 
 			for (auto const meshId : model.Meshes) {
 
@@ -321,78 +611,107 @@ private:
 					continue ;
 				}
 
-				auto &shader = shaderOpt.value();
+				auto const *meshCast = dynamic_cast<engine::Mesh const *>(mesh);
+				size_t lod = meshCast != nullptr
+					? SelectLod(*meshCast, transform, playerTransform.position, pixelsPerUnit, maxPixelError)
+					: 0;
 
-				shader->bind();
-				shader->setUniform4x4f("viewProjectionMatrix", camera.viewProjection);
-				shader->setUniform4x4f("viewMatrix", camera.view);
-				shader->setUniform4x4f("projectionMatrix", camera.projection);
-				shader->setUniform3f("viewPos", playerTransform.position);
+				Draw draw = { shaderOpt.value(), shaderId, mesh, meshCast, lod, std::nullopt, nullptr, { modelMatrix, 0.0f } };
 
-				UpdateLight(*shader);
+				if (meshCast != nullptr && meshCast->GetPbrMaterial().has_value()) {
+					auto const &name = meshCast->GetPbrMaterial().value();
 
-				glm::mat4 modelMatrix(1.0f);
-				modelMatrix = glm::translate(modelMatrix, transform.position);
-				modelMatrix = glm::scale(modelMatrix, transform.scale);
-				shader->setUniform4x4f("modelMatrix", modelMatrix);
+					if (useArrays) {
+						draw.Packed = _materialAtlas.Find(name);
+					}
+					if (draw.Packed.has_value()) {
+						draw.Instance.Material = static_cast<GLfloat>(draw.Packed->Index);
+					}
+					else {
+						draw.Material = engine::Engine::Instance().GetPbrMaterial(name).value_or(nullptr);
+					}
+				}
 
-				std::vector<TextureAutoBind> textureBindings;
+				draws.push_back(draw);
+			}
+		}
 
-				// Bind each texture
-				auto meshCast = dynamic_cast<engine::Mesh*>(mesh);
-				if (meshCast != nullptr) {
-					if (meshCast->GetPbrMaterial().has_value()) {
-
-						auto material = engine::Engine::Instance().GetPbrMaterial(
-							meshCast->GetPbrMaterial().value());
-
-						if (material.has_value()) {
-							auto m = material.value();
-
-							shader->setUniform4f("material.baseColor", m->BaseColor);
-							shader->setUniform1f("material.metallicFactor", m->MetallicFactor);
-							shader->setUniform1f("material.roughnessFactor", m->RoughnessFactor);
-
-							if (m->Albedo.has_value()) {
-								auto albedo = m->Albedo.value();
-								auto texture = TextureManager::instance().get(albedo);
-
-								shader->setUniform1i("material.hasAlbedo", 1);
-								textureBindings.push_back(TextureAutoBind(GL_TEXTURE0, GL_TEXTURE_2D, texture));
-							}
-							else {
-								shader->setUniform1i("material.hasAlbedo", 0);
-							}
-
-							if (m->MetallicRoughness.has_value()) {
-								auto metallicRoughness = m->MetallicRoughness.value();
-								auto texture = TextureManager::instance().get(metallicRoughness);
-
-								shader->setUniform1i("material.hasMetallicRoughness", 1);
-								textureBindings.push_back(TextureAutoBind(GL_TEXTURE1, GL_TEXTURE_2D, texture));
-							}
-							else {
-								shader->setUniform1i("material.hasMetallicRoughness", 0);
-							}
-
-							if (m->Normal.has_value()) {
-								auto normal = m->Normal.value();
-								auto texture = TextureManager::instance().get(normal);
-
-								textureBindings.push_back(TextureAutoBind(GL_TEXTURE2, GL_TEXTURE_2D, texture));
-							}
-							else {
-								auto const defaultNormal = TextureManager::instance().get("default_normal");
-								textureBindings.push_back(TextureAutoBind(GL_TEXTURE2, GL_TEXTURE_2D, defaultNormal));
-							}
-						}
-					}
+		// Individual textures last within a shader, they rebind every material anyway
+		std::stable_sort(draws.begin(), draws.end(), [] (Draw const &a, Draw const &b) {
+			return std::tuple(a.Shader, a.GetBucket(), a.Material, a.Mesh, a.Lod)
+				< std::tuple(b.Shader, b.GetBucket(), b.Material, b.Mesh, b.Lod);
+		});
+
+		// The instances of each batch are contiguous
+		_instanceData.clear();
+		for (auto const &draw : draws) {
+			_instanceData.push_back(draw.Instance);
+		}
+
+		lazy::graphics::Shader *boundShader = nullptr;
+		MeshUniforms *uniforms = nullptr;
+		std::optional<size_t> boundBucket;
+
+		BindDefaultMaterialTextures();
+
+		for (size_t first = 0; first < draws.size(); ) {
+			auto const &draw = draws[first];
+			size_t last = first + 1;
+
+			while (last < draws.size() && draws[last].SameBatch(draw)) {
+				last++;
+			}
+
+			auto &shader = *draw.Shader;
+
+			if (draw.Shader != boundShader) {
+				shader.bind();
+				uniforms = &GetMeshUniforms(draw.ShaderId, shader);
+
+				uniforms->ViewProjectionMatrix.set(camera.viewProjection);
+				uniforms->ViewMatrix.set(camera.view);
+				uniforms->ProjectionMatrix.set(camera.projection);
+				uniforms->ViewPos.set(playerTransform.position);
+
+				if (useArrays) {
+					_materialAtlas.BindUniformBlock(shader);
+				}
+
+				boundShader = draw.Shader;
+			}
+
+			std::vector<TextureAutoBind> textureBindings;
+
+			if (draw.Packed.has_value()) {
+				if (boundBucket != draw.Packed->Bucket) {
+					_materialAtlas.BindBucket(draw.Packed->Bucket);
+					boundBucket = draw.Packed->Bucket;
 				}
 
-				mesh->Draw();
-				shader->unbind();
+				uniforms->UseMaterialArrays.set(1);
+			}
+			else {
+				uniforms->UseMaterialArrays.set(0);
+
+				if (draw.Material != nullptr) {
+					BindMaterialTextures(*uniforms, *draw.Material, textureBindings);
+				}
+				else {
+					BindDefaultMaterialTextures();
+				}
 			}
 
+			uniforms->SetPositionDecode(draw.MeshCast);
+			DrawInstances(draw.Mesh, draw.MeshCast, draw.Lod, first, last - first);
+
+			first = last;
+		}
+
+		if (boundShader != nullptr) {
+			boundShader->unbind();
+		}
+		if (boundBucket.has_value()) {
+			_materialAtlas.Unbind();
 		}
 	}
 
@@ -411,44 +730,54 @@ private:
 		shader->setUniform4x4f("viewMatrix", glm::mat4(glm::mat3(camera.view)));
 		shader->setUniform4x4f("projectionMatrix", camera.projection);
 
-		glDepthMask(GL_FALSE);
+		engine::GLState::Instance().DepthMask(GL_FALSE);
 		TextureManager::instance().bind("skybox-cubemap", 0);
 		mesh->Draw();
-		glDepthMask(GL_TRUE);
+		engine::GLState::Instance().DepthMask(GL_TRUE);
 
 		shader->unbind();
 	}
 
-	void UpdateLight(lazy::graphics::Shader &shader)
+	///
+	/// Bin the point lights into the view frustum clusters
+	///
+	void UpdateLightClusters(PlayerCameraComponent const &camera, unsigned int width, unsigned int height)
 	{
 		auto lights = GetEntities<PointLightComponent, TransformComponent>();
 
-		if (lights.size() == 0) { return ; }
+		_pointLights.clear();
+
+		for (auto const entity : lights) {
+			auto [ light, transform ] = entity->GetAll();
 
-		shader.setUniform1i("pointLightCount", lights.size());
+			_pointLights.push_back({ transform.position, light.Color, light.Intensity, light.Radius });
+		}
 
-		for (size_t i = 0; i < lights.size(); i++) {
-			auto [ light, transform ] = lights[i]->GetAll();
+		_lightClusters.Update(camera.projection, camera.view, width, height, _pointLights);
+	}
 
-			std::string pointLight = "pointLight[" + std::to_string(i) + "]";
+	void UpdateLight(lazy::graphics::Shader &shader)
+	{
+		auto lights = GetEntities<PointLightComponent, TransformComponent>();
 
-			shader.setUniform3f(pointLight + ".position", transform.position);
-			shader.setUniform3f(pointLight + ".color", light.Color);
-			shader.setUniform1f(pointLight + ".intensity", light.Intensity);
+		// Only the first point light casts shadows
+		shader.setUniform1i("hasShadowLight", lights.size() > 0);
+		if (lights.size() > 0) {
+			shader.setUniform3f("shadowLightPos", lights[0]->Get<TransformComponent>().position);
 		}
 
 		auto dirLights = GetEntities<DirectionalLightComponent>();
 
-		shader.setUniform1i("directionalLightCount", dirLights.size());
+		auto const count = std::min(dirLights.size(), _directionalLights.size());
 
-		for (size_t i = 0; i < dirLights.size(); i++) {
-			auto [ light ] = dirLights[i]->GetAll();
+		shader.setUniform1i("directionalLightCount", count);
 
-			std::string directionalLight = "directionalLights[" + std::to_string(i) + "]";
+		for (size_t i = 0; i < count; i++) {
+			auto [ light ] = dirLights[i]->GetAll();
 
-			shader.setUniform3f(directionalLight + ".direction", light.Direction);
-			shader.setUniform3f(directionalLight + ".color", light.Color);
-			shader.setUniform1f(directionalLight + ".intensity", light.Intensity);
+			_directionalLights[i].Direction.set(light.Direction);
+			_directionalLights[i].Color.set(light.Color);
+			_directionalLights[i].Intensity.set(light.Intensity);
 		}
 	}
 
@@ -458,124 +787,162 @@ private:
 
 		if (lights.size() == 0 ) { return ; }
 
+		_billboard.bind();
+		_billboard.setUniform4x4f("viewMatrix", camera.view);
+		_billboard.setUniform4x4f("viewProjectionMatrix", camera.viewProjection);
+		_billboard.setUniform4x4f("projectionMatrix", camera.projection);
+
+		TextureManager::instance().bind("light_bulb_icon", 0);
+
 		for (auto const &lightEnt : lights) {
 			auto [ light, transform ] = lightEnt->GetAll();
 
-			_billboard.bind();
-			_billboard.setUniform4x4f("viewMatrix", camera.view);
-			_billboard.setUniform4x4f("viewProjectionMatrix", camera.viewProjection);
-			_billboard.setUniform4x4f("projectionMatrix", camera.projection);
 			_billboard.setUniform3f("particlePosition", transform.position);
-
-			TextureManager::instance().bind("light_bulb_icon", 0);
 			_quad.Draw();
-
-			_billboard.unbind();
 		}
+
+		_billboard.unbind();
 	}
 
-	void RenderLight(glm::vec3 const &viewPos, float const exposure)
+	void RenderLight(PlayerCameraComponent const &camera, glm::vec3 const &viewPos, ShadowQuality const shadowQuality, GLuint ssao, float scale)
 	{
+		// Hardware comparison needs a shadow sampler, manual PCF a regular one
+		bool compare = shadowQuality == ShadowQuality::Hardware || shadowQuality == ShadowQuality::Poisson;
+		GLuint cubemap = _shadowCache->GetCubemap();
+
 		// Lighting pass
 		_light.bind();
 			UpdateLight(_light);
-			_light.setUniform1i("gPosition", 0);
+			_lightClusters.Bind(_light);
+			_light.setUniform4x4f("viewMatrix", camera.view);
+			_light.setUniform4x4f("invViewProjectionMatrix", glm::inverse(camera.viewProjection));
+			_light.setUniform1i("gDepth", 0);
 			_light.setUniform1i("gNormal", 1);
-			_light.setUniform1i("gAlbedoSpec", 2);
+			_light.setUniform1i("gAlbedo", 2);
 			_light.setUniform1i("gSSAO", 3);
-			_light.setUniform1i("gMetallicRoughness", 5);
+			_light.setUniform1i("ssaoEnabled", ssao != 0);
+			_light.setUniform1f("renderScale", scale);
+			_light.setUniform1i("gMaterial", 5);
 			_light.setUniform1i("depthMap", 4);
+			_light.setUniform1i("depthMapShadow", 6);
+			_light.setUniform1i("shadowQuality", static_cast<int>(shadowQuality));
+			_light.setUniform1f("shadowFarPlane", ShadowFarPlane);
 			_light.setUniform3f("viewPos", viewPos);
-			_light.setUniform1f("exposure", exposure);
+			_light.setUniform1f("exposure", camera.exposure);
 
-			// Bind GBuffer Textures
-			glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, _gBuffer.GetPositionTex());
-			glActiveTexture(GL_TEXTURE1);
-				glBindTexture(GL_TEXTURE_2D, _gBuffer.GetNormalTex());
-			glActiveTexture(GL_TEXTURE2);
-				glBindTexture(GL_TEXTURE_2D, _gBuffer.GetAlbedoSpecTex());
-			glActiveTexture(GL_TEXTURE3);
-				//glBindTexture(GL_TEXTURE_2D, _ssaoBlurTex);
-				glBindTexture(GL_TEXTURE_2D, _ssaoColorBuf);
-			glActiveTexture(GL_TEXTURE4);
-				glBindTexture(GL_TEXTURE_CUBE_MAP, _depthCubemap);
-			glActiveTexture(GL_TEXTURE5);
-				glBindTexture(GL_TEXTURE_2D, _gBuffer.GetMetallicRoughnessTex());
+			auto &state = engine::GLState::Instance();
 
+			// Bind GBuffer Textures
+			state.BindTexture(GL_TEXTURE0, GL_TEXTURE_2D, _gBuffer.GetDepthTex());
+			state.BindTexture(GL_TEXTURE1, GL_TEXTURE_2D, _gBuffer.GetNormalTex());
+			state.BindTexture(GL_TEXTURE2, GL_TEXTURE_2D, _gBuffer.GetAlbedoTex());
+			state.BindTexture(GL_TEXTURE3, GL_TEXTURE_2D, ssao);
+			state.BindTexture(GL_TEXTURE4, GL_TEXTURE_CUBE_MAP, compare ? 0 : cubemap);
+			state.BindTexture(GL_TEXTURE5, GL_TEXTURE_2D, _gBuffer.GetMaterialTex());
+			state.BindTexture(GL_TEXTURE6, GL_TEXTURE_CUBE_MAP, compare ? cubemap : 0);
+
+			// The textures stay bound, the next passes bind over them
 			_quad.Draw();
-
-			// Unbind Textures
-			glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, 0);
-			glActiveTexture(GL_TEXTURE1);
-				glBindTexture(GL_TEXTURE_2D, 0);
-			glActiveTexture(GL_TEXTURE2);
-				glBindTexture(GL_TEXTURE_2D, 0);
-			glActiveTexture(GL_TEXTURE3);
-				glBindTexture(GL_TEXTURE_2D, 0);
-			glActiveTexture(GL_TEXTURE4);
-				glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-			glActiveTexture(GL_TEXTURE5);
-				glBindTexture(GL_TEXTURE_2D, 0);
 		_light.unbind();
 	}
 
+	///
+	/// Update the shadow cube map of the first point light.
+	/// Static casters are only rendered into the faces of the cache that are
+	/// out of date (at most `shadowFaceBudget` faces per frame), dynamic casters
+	/// are drawn on top of the cached faces every frame.
+	///
 	void BakeShadowMap()
 	{
-		//Logger::Info("Building shadow map\n");
-
 		auto lights = GetEntities<PointLightComponent, TransformComponent>();
 		auto players = GetEntities<PlayerCameraComponent, TransformComponent>();
 
 		if (lights.size() == 0) return ;
 		if (players.size() == 0) return ;
 
-		auto playerTransform = players[0]->Get<TransformComponent>();
 		auto lightPos = lights[0]->Get<TransformComponent>().position;
 
-		std::array<glm::mat4, 6> shadowTransforms = {
-			_shadowProjection * glm::lookAt(lightPos, lightPos + glm::vec3( 1.0, 0.0, 0.0), glm::vec3(0.0,-1.0, 0.0)),
-			_shadowProjection * glm::lookAt(lightPos, lightPos + glm::vec3(-1.0, 0.0, 0.0), glm::vec3(0.0,-1.0, 0.0)),
-			_shadowProjection * glm::lookAt(lightPos, lightPos + glm::vec3( 0.0, 1.0, 0.0), glm::vec3(0.0, 0.0, 1.0)),
-			_shadowProjection * glm::lookAt(lightPos, lightPos + glm::vec3( 0.0,-1.0, 0.0), glm::vec3(0.0, 0.0,-1.0)),
-			_shadowProjection * glm::lookAt(lightPos, lightPos + glm::vec3( 0.0, 0.0, 1.0), glm::vec3(0.0,-1.0, 0.0)),
-			_shadowProjection * glm::lookAt(lightPos, lightPos + glm::vec3( 0.0, 0.0,-1.0), glm::vec3(0.0,-1.0, 0.0)),
-		};
+		std::vector<ecs::IEntity<ModelComponent, TransformComponent>*> staticCasters;
+		std::vector<ecs::IEntity<ModelComponent, TransformComponent>*> dynamicCasters;
+		std::vector<ShadowCache::Caster> cachedCasters;
+
+		for (auto const entity : GetEntities<ModelComponent, TransformComponent>()) {
+			auto const &transform = entity->Get<TransformComponent>();
+
+			if (glm::distance(transform.position, lightPos) > ShadowFar + ShadowCasterRadius) {
+				continue ;
+			}
+
+			// Not culled by _occluded: hidden from the camera says nothing about
+			// the light, and the static casters must not change with the view or
+			// the cached faces are rendered again
 
-		BindShadowMap();
+			if (entity->HasComponents<DynamicShadowCasterComponent>()) {
+				dynamicCasters.push_back(entity);
+			}
+			else {
+				staticCasters.push_back(entity);
+				cachedCasters.push_back({ entity->GetId(), transform.position, transform.scale });
+			}
+		}
 
-		glDisable(GL_BLEND);
-		glEnable(GL_DEPTH_TEST);
-		glClear(GL_DEPTH_BUFFER_BIT);
+		_shadowCache->Update(lightPos, cachedCasters);
 
-		_shadow.bind();
-		_shadow.setUniform4x4f("model", glm::mat4(1.0f));
-		glUniformMatrix4fv(_shadow.getUniformLocation("shadowMatrices"), 6, GL_FALSE,
-			(float *)shadowTransforms.data());
-		_shadow.setUniform1f("far_plane", 10000.0f);
-		_shadow.setUniform3f("lightPos", lightPos);
+		auto budget = std::any_cast<int>(Settings::instance().get("shadowFaceBudget"));
+		auto faces = _shadowCache->TakeDirtyFaces(std::max(budget, 1));
+		auto shadowTransforms = _shadowCache->GetFaceTransforms();
 
-			RenderShadowMeshes();
+		engine::GLState::Instance().Disable(GL_BLEND);
+		engine::GLState::Instance().Enable(GL_DEPTH_TEST);
 
-		_shadow.unbind();
+		if (!faces.empty()) {
+			_shadowFace.bind();
+			_shadowFace.setUniform1f("far_plane", ShadowFarPlane);
+			_shadowFace.setUniform3f("lightPos", lightPos);
 
-		UnbindShadowMap();
+			for (auto face : faces) {
+				_shadowCache->BindStaticFace(face);
+				glClear(GL_DEPTH_BUFFER_BIT);
+
+				_shadowMatrix.set(shadowTransforms[face]);
+				RenderShadowMeshes(_shadowFaceUniforms, staticCasters, lightPos);
+			}
+
+			_shadowFace.unbind();
+		}
+
+		_shadowCache->Composite(faces, !dynamicCasters.empty());
+
+		if (!dynamicCasters.empty()) {
+			_shadowCache->BindFinal();
+
+			_shadow.bind();
+			_shadowMatrices.set(shadowTransforms.data(), shadowTransforms.size());
+			_shadow.setUniform1f("far_plane", ShadowFarPlane);
+			_shadow.setUniform3f("lightPos", lightPos);
+
+			RenderShadowMeshes(_shadowUniforms, dynamicCasters, lightPos);
+
+			_shadow.unbind();
+		}
 
-		//Logger::Info("Done building shadow map\n");
+		UnbindShadowMap();
 	}
 
 public:
 	MeshRendererSystem()
 	{
-		buildShadowMap = [this] { BakeShadowMap(); };
+		buildShadowMap = [this] { _shadowCache->Invalidate(); };
 		engine::Engine::Instance().OnBuildLighting += buildShadowMap;
 
-		InitFramebuffer();
+		InitQuad();
 		InitBillboard();
-		InitSSAO();
 		InitDepthCubemap();
 
+		_depth.addVertexShader("shaders/depth.vs.glsl")
+			.addFragmentShader("shaders/depth.fs.glsl")
+			.link();
+
 		TextureManager::instance().createTexture("light_bulb_icon", "./img/light_bulb_icon.png", {
 			{ GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE },
 			{ GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE },
@@ -586,6 +953,16 @@ public:
 		_light.addVertexShader("shaders/light.vs.glsl")
 			.addFragmentShader("shaders/light.fs.glsl")
 			.link();
+
+		for (size_t i = 0; i < MaxDirectionalLights; i++) {
+			auto const name = fmt::format("directionalLights[{}]", i);
+
+			_directionalLights.push_back({
+				{ _light, name + ".direction" },
+				{ _light, name + ".color" },
+				{ _light, name + ".intensity" },
+			});
+		}
 //		assert(_light.isValid());
 	}
 
@@ -594,43 +971,200 @@ public:
 		engine::Engine::Instance().OnBuildLighting -= buildShadowMap;
 	}
 
-	void OnUpdate(float __unused deltaTime) override
+	void OnUpdate(float deltaTime) override
 	{
 		auto player = GetEntities<PlayerCameraComponent, TransformComponent>();
 		auto display = engine::Engine::Instance().GetDisplay();
-		auto [ width, height ] = std::tuple(display->getWidth(), display->getHeight());
+		// Not structured bindings, the pass lambdas capture them
+		int width = display->getWidth();
+		int height = display->getHeight();
 
 		if (player.size() == 0) { return ; }
+		// Minimized window, nothing to render to
+		if (width <= 0 || height <= 0) { return ; }
+
+		auto const &playerCamera = player[0]->Get<PlayerCameraComponent>();
+		auto const &playerTransform = player[0]->Get<TransformComponent>();
+
+		auto shadowQuality = UpdateShadowSettings();
+
+		// Follow window resizes, the old targets go back to the pool
+		_gBuffer.Resize(width, height);
+
+		UpdateOcclusion();
+
+		// Outside of the passes, the atlas blits through its own framebuffers
+		if (std::any_cast<int>(Settings::instance().get("materialTextureArrays"))) {
+			UpdateMaterialAtlas();
+		}
 
-		auto [ playerCamera, playerTransform ] = player[0]->GetAll();
+		// Dynamic resolution: the scene is rendered in the bottom-left part of the
+		// G-buffer then upscaled, the targets are never reallocated
+		float scale = _dynamicResolution.Update(deltaTime);
+		int renderWidth = std::max(static_cast<int>(width * scale), 1);
+		int renderHeight = std::max(static_cast<int>(height * scale), 1);
+		bool upscale = renderWidth != width || renderHeight != height;
+
+		bool depthPrepass = playerCamera.depthPrepass && std::any_cast<int>(Settings::instance().get("depthPrepass"));
+		bool ssaoEnabled = std::any_cast<int>(Settings::instance().get("ssao"));
+		auto ssaoSize = SSAO::GetTargetSize(width, height, std::any_cast<int>(Settings::instance().get("ssaoResolution")));
+
+		using LoadOp = engine::RenderGraph::LoadOp;
+		using Builder = engine::RenderGraph::Builder;
+		using Graph = engine::RenderGraph;
+
+		auto backbuffer = _graph.ImportBackbuffer(width, height);
+		auto gNormal = _graph.Import("GNormal", _gBuffer.GetNormalTex(), { width, height, GBuffer::NormalFormat });
+		auto gAlbedo = _graph.Import("GAlbedo", _gBuffer.GetAlbedoTex(), { width, height, GBuffer::AlbedoFormat });
+		auto gMaterial = _graph.Import("GMaterial", _gBuffer.GetMaterialTex(), { width, height, GBuffer::MaterialFormat });
+		auto gDepth = _graph.Import("GDepth", _gBuffer.GetDepthTex(), { width, height, GBuffer::DepthFormat });
+		auto ssaoRaw = _graph.Create("SSAORaw", { ssaoSize.x, ssaoSize.y, GL_RG16F });
+		auto ssao = _graph.Create("SSAO", { ssaoSize.x, ssaoSize.y, GL_RG16F });
+		// Lit scene when rendering below the display resolution, upscaled to the backbuffer
+		auto sceneColor = upscale ? _graph.Create("SceneColor", { width, height, GL_RGB8 }) : backbuffer;
+		auto shadowSize = static_cast<int>(_shadowCache->GetSize());
+		auto shadowMap = _graph.Import("ShadowMap", _shadowCache->GetCubemap(), { shadowSize, shadowSize, GL_DEPTH_COMPONENT });
+
+		if (shadowQuality != ShadowQuality::Off) {
+			_graph.AddPass("Shadow",
+				[&] (Builder &pass) { pass.Write(shadowMap); },
+				[this] (Graph const &) { BakeShadowMap(); });
+		}
 
-		BakeShadowMap();
+		if (depthPrepass) {
+			_graph.AddPass("DepthPrepass",
+				[&] (Builder &pass) {
+					pass.Depth(gDepth);
+					pass.Viewport(renderWidth, renderHeight);
+				},
+				[&] (Graph const &) {
+					engine::GLState::Instance().Enable(GL_DEPTH_TEST);
+					RenderDepthPrepass(playerCamera, playerTransform, renderHeight);
+				});
+		}
 
-		_gBuffer.Bind();
-			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-			glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
-			glEnable(GL_DEPTH_TEST);
-			RenderMeshes(playerCamera, playerTransform);
-			glDisable(GL_DEPTH_TEST);
-		_gBuffer.Unbind();
+		_graph.AddPass("GBuffer",
+			[&] (Builder &pass) {
+				pass.Color(gNormal);
+				pass.Color(gAlbedo);
+				pass.Color(gMaterial);
+				pass.Depth(gDepth, depthPrepass ? LoadOp::Load : LoadOp::Clear);
+				pass.Viewport(renderWidth, renderHeight);
+			},
+			[&] (Graph const &) {
+				// Encode the albedo written by the shaders to sRGB
+				engine::GLState::Instance().Enable(GL_FRAMEBUFFER_SRGB);
+				engine::GLState::Instance().Enable(GL_DEPTH_TEST);
+
+				if (depthPrepass) {
+					// Only the closest fragment of each pixel writes to the G-buffer
+					engine::GLState::Instance().DepthFunc(GL_EQUAL);
+					engine::GLState::Instance().DepthMask(GL_FALSE);
+				}
 
-		glClearColor(0.0f, 0.0, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		RenderLight(playerTransform.position, playerCamera.exposure);
+				RenderMeshes(playerCamera, playerTransform, renderHeight);
+
+				engine::GLState::Instance().DepthFunc(GL_LEQUAL);
+				engine::GLState::Instance().DepthMask(GL_TRUE);
+				engine::GLState::Instance().Disable(GL_DEPTH_TEST);
+				engine::GLState::Instance().Disable(GL_FRAMEBUFFER_SRGB);
+			});
+
+		// Reads the depth back for the next frames
+		_graph.AddPass("Occlusion",
+			[&] (Builder &pass) {
+				pass.Read(gDepth);
+				pass.SideEffect();
+			},
+			[&] (Graph const &) {
+				_occlusion.Render(_gBuffer, _quad, playerCamera.viewProjection, playerTransform.position,
+					renderWidth, renderHeight, width, height);
+			});
+
+		// Culled when the lighting does not read the occlusion
+		_graph.AddPass("SSAO",
+			[&] (Builder &pass) {
+				pass.Read(gDepth);
+				pass.Read(gNormal);
+				pass.Color(ssaoRaw, LoadOp::DontCare);
+			},
+			[&] (Graph const &graph) {
+				_ssao.Configure(std::any_cast<int>(Settings::instance().get("ssaoSamples")));
+				_ssao.RenderOcclusion(graph.GetTexture(gDepth), graph.GetTexture(gNormal), ssaoSize, _quad,
+					playerCamera.projection, playerCamera.view, scale);
+			});
+
+		_graph.AddPass("SSAOBlur",
+			[&] (Builder &pass) {
+				pass.Read(ssaoRaw);
+				pass.Color(ssao, LoadOp::DontCare);
+			},
+			[&] (Graph const &graph) {
+				_ssao.RenderBlur(graph.GetTexture(ssaoRaw), ssaoSize, _quad, scale);
+			});
+
+		UpdateLightClusters(playerCamera, renderWidth, renderHeight);
+
+		_graph.AddPass("Lighting",
+			[&] (Builder &pass) {
+				pass.Read(gDepth);
+				pass.Read(gNormal);
+				pass.Read(gAlbedo);
+				pass.Read(gMaterial);
+				if (ssaoEnabled) { pass.Read(ssao); }
+				if (shadowQuality != ShadowQuality::Off) { pass.Read(shadowMap); }
+				pass.Color(sceneColor);
+				pass.Viewport(renderWidth, renderHeight);
+			},
+			[&] (Graph const &graph) {
+				RenderLight(playerCamera, playerTransform.position, shadowQuality,
+					ssaoEnabled ? graph.GetTexture(ssao) : 0, scale);
+			});
+
+		if (upscale) {
+			_graph.AddPass("Upscale",
+				[&] (Builder &pass) {
+					pass.BlitFrom(sceneColor);
+					pass.Color(backbuffer, LoadOp::DontCare);
+				},
+				[&] (Graph const &) {
+					glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+				});
+		}
 
 		// Copy depth buffer to default framebuffer to enable depth testing with billboard
 		// and other shaders
-		glBindFramebuffer(GL_READ_FRAMEBUFFER, _gBuffer.GetFramebufferId());
-		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-		glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		_graph.AddPass("DepthBlit",
+			[&] (Builder &pass) {
+				pass.BlitFrom(gDepth);
+				pass.Depth(backbuffer, LoadOp::DontCare);
+			},
+			[&] (Graph const &) {
+				glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+			});
+
+		auto forward = [&] (Builder &pass) {
+			pass.Color(backbuffer, LoadOp::Load);
+			pass.Depth(backbuffer, LoadOp::Load);
+		};
 
-		glEnable(GL_BLEND);
-		glEnable(GL_DEPTH_TEST);
+		_graph.AddPass("Skybox", forward, [&] (Graph const &) {
+			engine::GLState::Instance().Enable(GL_BLEND);
+			engine::GLState::Instance().Enable(GL_DEPTH_TEST);
 			RenderSkybox(playerCamera);
-//			RenderSSAO(playerCamera);
+			engine::GLState::Instance().Disable(GL_DEPTH_TEST);
+			engine::GLState::Instance().Disable(GL_BLEND);
+		});
+
+		_graph.AddPass("Billboards", forward, [&] (Graph const &) {
+			engine::GLState::Instance().Enable(GL_BLEND);
+			engine::GLState::Instance().Enable(GL_DEPTH_TEST);
 			RenderLightBillboard(playerCamera);
-		glDisable(GL_DEPTH_TEST);
-		glDisable(GL_BLEND);
+			engine::GLState::Instance().Disable(GL_DEPTH_TEST);
+			engine::GLState::Instance().Disable(GL_BLEND);
+		});
+
+		_graph.Execute();
+		_instances.EndFrame();
 	}
 };
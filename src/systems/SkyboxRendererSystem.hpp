@@ -41,10 +41,10 @@ public:
 		_shader.setUniform4x4f("viewMatrix", glm::mat4(glm::mat3(cameraData.view)));
 		_shader.setUniform4x4f("projectionMatrix", cameraData.projection);
 
-		glDepthMask(GL_FALSE);
+		engine::GLState::Instance().DepthMask(GL_FALSE);
 		TextureManager::instance().bind("skybox-cubemap", 0);
 		mesh->Draw();
-		glDepthMask(GL_TRUE);
+		engine::GLState::Instance().DepthMask(GL_TRUE);
 
 		_shader.unbind();
 	}
@@ -4,6 +4,7 @@
 #include "ui/TextRenderer.hpp"
 #include "Engine.hpp"
 #include "components/TextComponent.hpp"
+#include "GpuProfiler.hpp"
 
 class TextRendererSystem : public ecs::ComponentSystem
 {
@@ -30,19 +31,27 @@ public:
 	{
 		auto textEntities = GetEntities<TextComponent>();
 
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		engine::GpuProfiler::Scope profile("Text");
+
+		engine::GLState::Instance().Enable(GL_BLEND);
+		engine::GLState::Instance().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 		_Shader.bind();
+		_Shader.setUniform4f("color", glm::vec4(1.0f));
 
+		// Every text shares the glyph atlas, they are all drawn at once.
+		// Layouts are cached in the components and only rebuilt when they changed
 		for (auto const &ent : textEntities) {
-			auto const &text = ent->Get<TextComponent>();
-			_Shader.setUniform4f("color", glm::vec4(text.Color.x, text.Color.y, text.Color.z, 1.0f));
-			_TextRenderer.drawText(text.Text, text.Scale, text.Color, text.Anchor);
+			auto &text = ent->Get<TextComponent>();
+			_TextRenderer.updateLayout(text.Layout, text.Text, text.Scale, text.Color, text.Anchor);
+			_TextRenderer.addLayout(text.Layout);
 		}
+		_TextRenderer.flush();
 
 		_Shader.unbind();
 
-		glDisable(GL_BLEND);
+		_TextRenderer.endFrame();
+
+		engine::GLState::Instance().Disable(GL_BLEND);
 	}
 };
@@ -18,6 +18,8 @@
 
 #include "graphics/Display.hpp"
 #include "graphics/Shader.hpp"
+#include "graphics/UniformHandle.hpp"
+#include "graphics/StateBinder.hpp"
 #include "graphics/Mesh.hpp"
 #include "graphics/Camera.hpp"
 #include "graphics/textures/Framebuffer.hpp"
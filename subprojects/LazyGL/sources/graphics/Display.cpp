@@ -60,20 +60,22 @@ namespace lazy
 {
 	namespace graphics
 	{
-		Display::Display(const std::string &title, int width, int height)
-			: title(title), width(width), height(height), resized(false)
+		Display::Display(const std::string &title, int width, int height, bool headless)
+			: window(nullptr), title(title), width(width), height(height), resized(false),
+			  screenSize(width, height), isFullscreen(false), headless(headless)
 		{
-			if (!glfwInit())
-				throw std::runtime_error("GLFW error: Unable to init glfw !");
+			if (headless)
+			{
+				createHeadlessWindow();
+			}
+			else
+			{
+				if (!glfwInit())
+					throw std::runtime_error("GLFW error: Unable to init glfw !");
 
-			glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-			glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
-			glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-			glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-			glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, true);
-//			glfwWindowHint(GLFW_SAMPLES, 4);
+				window = createWindow(GLFW_NATIVE_CONTEXT_API, true);
+			}
 
-			window = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
 			if (!window)
 				throw std::runtime_error("GLFW error: Unable to create window !");
 
@@ -81,7 +83,13 @@ namespace lazy
 			glViewport(0, 0, width, height);
 
 			glewExperimental = GL_TRUE;
-			if (glewInit() != GLEW_OK)
+			GLenum glewStatus = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+			// GLEW built for GLX still loads the core functions of an EGL or OSMesa context
+			if (headless && glewStatus == GLEW_ERROR_NO_GLX_DISPLAY)
+				glewStatus = GLEW_OK;
+#endif
+			if (glewStatus != GLEW_OK)
 				throw std::runtime_error("GLEW error: Unable to init glew !");
 
 			std::cout << "OpenGL version: " << glGetString(GL_VERSION) << "\n";
@@ -93,7 +101,53 @@ namespace lazy
 
 			inputs::input::init(*this);
 
-			updateScreenSize();
+			// The offscreen framebuffer keeps its size whatever the monitors are
+			if (!headless)
+				updateScreenSize();
+		}
+
+		GLFWwindow *Display::createWindow(int contextApi, bool visible)
+		{
+			glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+			glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+			glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+			glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+			glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, true);
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, contextApi);
+			glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
+//			glfwWindowHint(GLFW_SAMPLES, 4);
+
+			return glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
+		}
+
+		void Display::createHeadlessWindow()
+		{
+#ifdef GLFW_PLATFORM_NULL
+			// No window system at all (GLFW 3.4): the OSMesa or EGL context
+			// renders to a framebuffer of the window size, e.g. with llvmpipe
+			glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+			if (glfwInit())
+			{
+				for (int api : { GLFW_OSMESA_CONTEXT_API, GLFW_EGL_CONTEXT_API })
+				{
+					window = createWindow(api, false);
+					if (window)
+						break ;
+				}
+				if (!window)
+					glfwTerminate();
+			}
+			glfwInitHint(GLFW_PLATFORM, GLFW_ANY_PLATFORM);
+#endif
+
+			// Otherwise a hidden window of the native platform (e.g. under Xvfb)
+			if (!window)
+			{
+				if (!glfwInit())
+					throw std::runtime_error("GLFW error: Unable to init glfw !");
+
+				window = createWindow(GLFW_NATIVE_CONTEXT_API, false);
+			}
 		}
 
 		Display::~Display()
@@ -140,6 +194,9 @@ namespace lazy
 
 		void Display::setFullscreen(bool fullscreen)
 		{
+			if (headless)
+				return ;
+
 			if (fullscreen)
 			{
 				int nmonitors = 0;
@@ -161,6 +218,9 @@ namespace lazy
 
 		void Display::showCursor(bool show)
 		{
+			if (headless)
+				return ;
+
 			if (show)
 			{
 				glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
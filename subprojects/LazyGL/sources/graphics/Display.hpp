@@ -20,11 +20,15 @@ namespace lazy
 			glm::vec2	screenSize;
 			int			refreshRate;
 			bool		isFullscreen;
+			bool		headless;
 
+			GLFWwindow *createWindow(int contextApi, bool visible);
+			void createHeadlessWindow();
 			void updateScreenSize();
 
 		public:
-			Display(const std::string &title, int width, int height);
+			/// `headless` creates an offscreen context of a fixed size, no window is shown
+			Display(const std::string &title, int width, int height, bool headless = false);
 			~Display();
 
 			void update();
@@ -39,6 +43,7 @@ namespace lazy
 
 			bool isClosed() const { return glfwWindowShouldClose(window); }
 			bool hasResized() const { return resized; }
+			bool isHeadless() const { return headless; }
 			void setVSync(int mode) { glfwSwapInterval(mode); }
 
 			void setTitle(const std::string &title) { this->title = title; }
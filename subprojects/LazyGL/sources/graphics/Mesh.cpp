@@ -3,6 +3,7 @@
 //
 
 #include "Mesh.hpp"
+#include "StateBinder.hpp"
 
 
 namespace lazy
@@ -26,7 +27,7 @@ namespace lazy
 			glDeleteBuffers(1, &ubo);
 			glDeleteBuffers(1, &nbo);
 			glDeleteBuffers(1, &vbo);
-			glDeleteVertexArrays(1, &vao);
+			deleteVertexArray(vao);
 		}
 
 		Mesh::Mesh(Mesh &&m)
@@ -61,7 +62,7 @@ namespace lazy
 				glDeleteBuffers(1, &ubo);
 				glDeleteBuffers(1, &nbo);
 				glDeleteBuffers(1, &vbo);
-				glDeleteVertexArrays(1, &vao);
+				deleteVertexArray(vao);
 
 				vPositions = std::move(rhs.vPositions);
 				vNormals = std::move(rhs.vNormals);
@@ -146,7 +147,7 @@ namespace lazy
 			glGenBuffers(1, &tbo);
 			glGenBuffers(1, &ibo);
 
-			glBindVertexArray(vao);
+			bindVertexArray(vao);
 
 			glEnableVertexAttribArray(0);
 			glEnableVertexAttribArray(1);
@@ -172,16 +173,15 @@ namespace lazy
 			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
 			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indices.size(), &indices[0], GL_STATIC_DRAW);
 
-			glBindVertexArray(0);
+			bindVertexArray(0);
 
 			return *this;
 		}
 
 		void Mesh::draw() const
 		{
-			glBindVertexArray(vao);
+			bindVertexArray(vao);
 			glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, nullptr);
-			glBindVertexArray(0);
 		}
 	}
 }
@@ -3,6 +3,7 @@
 //
 
 #include "Shader.hpp"
+#include "StateBinder.hpp"
 #include "utils/fileutils.hpp"
 #include <vector>
 
@@ -10,6 +11,13 @@ namespace lazy
 {
 	namespace graphics
 	{
+		Shader::ProgramProvider *Shader::provider = nullptr;
+
+		void Shader::setProgramProvider(ProgramProvider *programProvider)
+		{
+			provider = programProvider;
+		}
+
 		Shader::Shader()
 		{}
 
@@ -38,69 +46,81 @@ namespace lazy
 					std::vector<GLchar> msg(length);
 					glGetShaderInfoLog(shader, length, &length, msg.data());
 					std::cout << " Shader error:\n" << msg.data() << std::endl;
-					glDeleteShader(shader);
 				}
+				glDeleteShader(shader);
 				return 0;
 			}
 			return shader;
 		}
 
-		Shader &Shader::addVertexShader(const std::string &path)
+		Shader &Shader::addStage(GLenum type, const std::string &path)
 		{
-			if (shaders.find("vertex") != shaders.end())
-				return *this;
-			shaders["vertex"] = createShader(utils::LoadShader(path).c_str(), GL_VERTEX_SHADER);
+			for (auto const &stage : stages)
+			{
+				if (stage.type == type)
+					return *this;
+			}
+			stages.push_back({ type, path, utils::LoadShader(path) });
 			return *this;
 		}
 
-		Shader &Shader::addGeometryShader(const std::string &path)
+		Shader &Shader::addVertexShader(const std::string &path)
 		{
-			if (shaders.find("geometry") != shaders.end())
-				return *this;
-			shaders["geometry"] = createShader(utils::LoadShader(path).c_str(), GL_GEOMETRY_SHADER);
+			return addStage(GL_VERTEX_SHADER, path);
+		}
 
-			return *this;
+		Shader &Shader::addGeometryShader(const std::string &path)
+		{
+			return addStage(GL_GEOMETRY_SHADER, path);
 		}
 
 		Shader &Shader::addTesselationShader(const std::string &path)
 		{
-			if (shaders.find("tesselation") != shaders.end())
-				return *this;
-			shaders["tesselation"] = createShader(utils::LoadShader(path).c_str(), GL_TESS_CONTROL_SHADER);
-
-			return *this;
+			return addStage(GL_TESS_CONTROL_SHADER, path);
 		}
 
 		Shader &Shader::addComputeShader(const std::string &path)
 		{
-			if (shaders.find("compute") != shaders.end())
-				return *this;
-			shaders["compute"] = createShader(utils::LoadShader(path).c_str(), GL_COMPUTE_SHADER);
-
-			return *this;
+			return addStage(GL_COMPUTE_SHADER, path);
 		}
 
 		Shader &Shader::addFragmentShader(const std::string &path)
 		{
-			if (shaders.find("fragment") != shaders.end())
-				return *this;
-			shaders["fragment"] = createShader(utils::LoadShader(path).c_str(), GL_FRAGMENT_SHADER);
-			return *this;
+			return addStage(GL_FRAGMENT_SHADER, path);
 		}
 
 		void Shader::link()
 		{
+			if (provider)
+			{
+				program = provider->createProgram(stages);
+				pendingProvider = provider;
+				return ;
+			}
+
 			if ((program = glCreateProgram()) == GL_FALSE)
 				throw std::runtime_error("Shader program error: Unable to create shader program !");
 
-			glAttachShader(program, shaders["vertex"]);
-			glAttachShader(program, shaders["fragment"]);
-			if (shaders.find("geometry") != shaders.end()) {
-				glAttachShader(program, shaders["geometry"]);
+			std::vector<GLuint> shaders;
+
+			for (auto const &stage : stages)
+			{
+				GLuint shader = createShader(stage.source.c_str(), stage.type);
+				if (shader)
+				{
+					glAttachShader(program, shader);
+					shaders.push_back(shader);
+				}
 			}
 
 			glLinkProgram(program);
 
+			for (auto shader : shaders)
+			{
+				glDetachShader(program, shader);
+				glDeleteShader(shader);
+			}
+
 			GLint result;
 			glGetProgramiv(program, GL_LINK_STATUS, &result);
 
@@ -113,14 +133,66 @@ namespace lazy
 					GLchar *msg = new GLchar[length];
 					glGetProgramInfoLog(program, length, &length, msg);
 					std::cout << "Shader error:\n" << msg << std::endl;
-					glDeleteShader(program);
 					delete[] msg;
 				}
 			}
 		}
 
+		void Shader::finish()
+		{
+			if (!pendingProvider)
+				return ;
+			pendingProvider->finishProgram(program);
+			pendingProvider = nullptr;
+		}
+
+		void Shader::introspect()
+		{
+			finish();
+			introspected = true;
+
+			GLint count = 0;
+			GLint maxLength = 0;
+			glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+			glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+			std::vector<GLchar> name(maxLength + 1);
+
+			for (GLint i = 0; i < count; i++)
+			{
+				GLsizei length = 0;
+				GLint size = 0;
+				GLenum type = GL_NONE;
+
+				glGetActiveUniform(program, i, name.size(), &length, &size, &type, name.data());
+
+				std::string uniformName(name.data(), length);
+				GLint location = glGetUniformLocation(program, uniformName.c_str());
+
+				// Members of uniform blocks have no location
+				if (location < 0)
+					continue ;
+
+				activeUniforms[uniformName] = { location, type, size };
+
+				if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+					activeUniforms[uniformName.substr(0, uniformName.size() - 3)] = { location, type, size };
+			}
+		}
+
+		const Shader::UniformInfo *Shader::getUniformInfo(const std::string &name)
+		{
+			if (!introspected)
+				introspect();
+
+			auto uniform = activeUniforms.find(name);
+
+			return uniform != activeUniforms.end() ? &uniform->second : nullptr;
+		}
+
 		bool Shader::isValid()
 		{
+			finish();
 			glValidateProgram(program);
 			GLint result;
 			glGetProgramiv(program, GL_VALIDATE_STATUS, &result);
@@ -143,6 +215,7 @@ namespace lazy
 
 		GLint Shader::getUniformLocation(const std::string &name)
 		{
+			finish();
 			if (uniformLocations.find(name) != uniformLocations.end())
 				return uniformLocations[name];
 
@@ -184,12 +257,13 @@ namespace lazy
 
 		void Shader::bind()
 		{
-			glUseProgram(program);
+			finish();
+			useProgram(program);
 		}
 
 		void Shader::unbind()
 		{
-			glUseProgram(0);
+			useProgram(0);
 		}
 	}
 }
@@ -6,6 +6,8 @@
 
 #include <iostream>
 #include <map>
+#include <string>
+#include <vector>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
@@ -27,12 +29,57 @@ namespace lazy
 	{
 		class Shader
 		{
+		public:
+			struct Stage
+			{
+				GLenum		type;
+				std::string	path;
+				std::string	source;
+			};
+
+			//
+			// Builds the programs in place of Shader, e.g. to share or cache them.
+			// createProgram() may return before the link is done, finishProgram()
+			// is called once before the program is first used.
+			//
+			class ProgramProvider
+			{
+			public:
+				virtual ~ProgramProvider() {}
+
+				virtual GLuint createProgram(const std::vector<Stage> &stages) = 0;
+				// Wait for the link, report the errors and return whether it linked
+				virtual bool finishProgram(GLuint program) = 0;
+			};
+
+			// Used by every Shader linked afterwards, nullptr to compile and link in place
+			static void setProgramProvider(ProgramProvider *provider);
+
+			// Active uniform of the linked program
+			struct UniformInfo
+			{
+				GLint	location;
+				GLenum	type;
+				// Number of elements of an array, 1 otherwise
+				GLint	size;
+			};
+
 		private:
-			GLuint							program;
+			GLuint							program = 0;
 			std::map<std::string, GLint>	uniformLocations;
-			std::map<std::string, GLuint>	shaders;
+			std::vector<Stage>				stages;
+			std::map<std::string, UniformInfo>	activeUniforms;
+			bool							introspected = false;
+
+			// Provider of the program while its link has not been checked yet
+			ProgramProvider					*pendingProvider = nullptr;
+
+			static ProgramProvider			*provider;
 
 			GLuint createShader(const char *sources, GLenum type);
+			Shader &addStage(GLenum type, const std::string &path);
+			void finish();
+			void introspect();
 
 		public:
 			Shader();
@@ -47,6 +94,9 @@ namespace lazy
 			void link();
 
 			GLint getUniformLocation(const std::string &name);
+			// nullptr if the program has no such active uniform, arrays are
+			// found both by their name and with [0]
+			const UniformInfo *getUniformInfo(const std::string &name);
 			
 			void setUniform1i(const std::string &name, const GLint &v);
 			void setUniform1f(const std::string &name, const GLfloat &v);
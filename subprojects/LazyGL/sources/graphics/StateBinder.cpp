@@ -0,0 +1,38 @@
+#include "StateBinder.hpp"
+
+namespace lazy
+{
+	namespace graphics
+	{
+		static StateBinder *stateBinder = nullptr;
+
+		void setStateBinder(StateBinder *binder)
+		{
+			stateBinder = binder;
+		}
+
+		void useProgram(GLuint program)
+		{
+			if (stateBinder)
+				stateBinder->useProgram(program);
+			else
+				glUseProgram(program);
+		}
+
+		void bindVertexArray(GLuint vao)
+		{
+			if (stateBinder)
+				stateBinder->bindVertexArray(vao);
+			else
+				glBindVertexArray(vao);
+		}
+
+		void deleteVertexArray(GLuint vao)
+		{
+			if (stateBinder)
+				stateBinder->deleteVertexArray(vao);
+			else
+				glDeleteVertexArrays(1, &vao);
+		}
+	}
+}
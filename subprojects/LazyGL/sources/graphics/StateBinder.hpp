@@ -0,0 +1,31 @@
+#pragma once
+
+#include <GL/glew.h>
+
+namespace lazy
+{
+	namespace graphics
+	{
+		//
+		// Binds of the LazyGL objects go through the binder set here, e.g. one
+		// that tracks the GL state to skip redundant calls. Without a binder
+		// they call GL directly.
+		//
+		class StateBinder
+		{
+		public:
+			virtual ~StateBinder() {}
+
+			virtual void useProgram(GLuint program) = 0;
+			virtual void bindVertexArray(GLuint vao) = 0;
+			// Deleting a bound vertex array binds 0, and its name may be given to another one
+			virtual void deleteVertexArray(GLuint vao) = 0;
+		};
+
+		void setStateBinder(StateBinder *binder);
+
+		void useProgram(GLuint program);
+		void bindVertexArray(GLuint vao);
+		void deleteVertexArray(GLuint vao);
+	}
+}
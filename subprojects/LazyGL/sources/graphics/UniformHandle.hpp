@@ -0,0 +1,202 @@
+#pragma once
+
+#include "Shader.hpp"
+#include <algorithm>
+#include <vector>
+
+namespace lazy
+{
+	namespace graphics
+	{
+		//
+		// GLSL types a uniform of type T can be uploaded to, and the upload itself
+		//
+		template <typename T>
+		struct UniformType;
+
+		template <>
+		struct UniformType<GLint>
+		{
+			static bool accepts(GLenum type)
+			{
+				switch (type)
+				{
+				case GL_INT:
+				case GL_BOOL:
+				case GL_SAMPLER_2D:
+				case GL_SAMPLER_3D:
+				case GL_SAMPLER_CUBE:
+				case GL_SAMPLER_2D_SHADOW:
+				case GL_SAMPLER_CUBE_SHADOW:
+				case GL_SAMPLER_2D_ARRAY:
+				case GL_SAMPLER_2D_ARRAY_SHADOW:
+				case GL_SAMPLER_2D_MULTISAMPLE:
+				case GL_SAMPLER_BUFFER:
+				case GL_INT_SAMPLER_2D:
+				case GL_INT_SAMPLER_BUFFER:
+				case GL_UNSIGNED_INT_SAMPLER_2D:
+				case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+					return true;
+				default:
+					return false;
+				}
+			}
+			static void upload(GLint location, GLsizei count, const GLint *values)
+			{
+				glUniform1iv(location, count, values);
+			}
+		};
+
+		template <>
+		struct UniformType<GLfloat>
+		{
+			static bool accepts(GLenum type) { return type == GL_FLOAT; }
+			static void upload(GLint location, GLsizei count, const GLfloat *values)
+			{
+				glUniform1fv(location, count, values);
+			}
+		};
+
+		template <>
+		struct UniformType<glm::vec2>
+		{
+			static bool accepts(GLenum type) { return type == GL_FLOAT_VEC2; }
+			static void upload(GLint location, GLsizei count, const glm::vec2 *values)
+			{
+				glUniform2fv(location, count, glm::value_ptr(*values));
+			}
+		};
+
+		template <>
+		struct UniformType<glm::vec3>
+		{
+			static bool accepts(GLenum type) { return type == GL_FLOAT_VEC3; }
+			static void upload(GLint location, GLsizei count, const glm::vec3 *values)
+			{
+				glUniform3fv(location, count, glm::value_ptr(*values));
+			}
+		};
+
+		template <>
+		struct UniformType<glm::vec4>
+		{
+			static bool accepts(GLenum type) { return type == GL_FLOAT_VEC4; }
+			static void upload(GLint location, GLsizei count, const glm::vec4 *values)
+			{
+				glUniform4fv(location, count, glm::value_ptr(*values));
+			}
+		};
+
+		template <>
+		struct UniformType<glm::ivec2>
+		{
+			static bool accepts(GLenum type) { return type == GL_INT_VEC2; }
+			static void upload(GLint location, GLsizei count, const glm::ivec2 *values)
+			{
+				glUniform2iv(location, count, &values->x);
+			}
+		};
+
+		template <>
+		struct UniformType<glm::mat3>
+		{
+			static bool accepts(GLenum type) { return type == GL_FLOAT_MAT3; }
+			static void upload(GLint location, GLsizei count, const glm::mat3 *values)
+			{
+				glUniformMatrix3fv(location, count, GL_FALSE, glm::value_ptr(*values));
+			}
+		};
+
+		template <>
+		struct UniformType<glm::mat4>
+		{
+			static bool accepts(GLenum type) { return type == GL_FLOAT_MAT4; }
+			static void upload(GLint location, GLsizei count, const glm::mat4 *values)
+			{
+				glUniformMatrix4fv(location, count, GL_FALSE, glm::value_ptr(*values));
+			}
+		};
+
+		//
+		// Uniform of a Shader looked up once instead of by name on every upload.
+		//
+		// The location is resolved on the first upload, after the link is done,
+		// and checked against the program: a uniform of another type is
+		// reported and never written, arrays are uploaded in one call and
+		// clamped to their declared size. Like glUniform with a location of -1,
+		// uploads to a uniform the program does not use do nothing.
+		//
+		// The program of the shader must be bound for the uploads.
+		//
+		template <typename T>
+		class UniformHandle
+		{
+		private:
+			Shader		*shader = nullptr;
+			std::string	name;
+			GLint		location = -1;
+			GLint		size = 0;
+			bool		resolved = false;
+
+			void resolve()
+			{
+				resolved = true;
+
+				const Shader::UniformInfo *info = shader ? shader->getUniformInfo(name) : nullptr;
+
+				if (!info)
+					return ;
+
+				if (!UniformType<T>::accepts(info->type))
+				{
+					std::cout << "Shader error: uniform " << name << " is of type 0x"
+						<< std::hex << info->type << std::dec << ", not the type of its handle" << std::endl;
+					return ;
+				}
+
+				location = info->location;
+				size = info->size;
+			}
+
+		public:
+			UniformHandle() = default;
+			UniformHandle(Shader &shader, std::string name)
+				: shader(&shader), name(std::move(name))
+			{}
+
+			void set(const T &value)
+			{
+				set(&value, 1);
+			}
+
+			void set(const T *values, GLsizei count)
+			{
+				if (!resolved)
+					resolve();
+				if (location < 0 || count <= 0)
+					return ;
+				UniformType<T>::upload(location, std::min<GLsizei>(count, size), values);
+			}
+
+			void set(const std::vector<T> &values)
+			{
+				set(values.data(), values.size());
+			}
+
+			bool isValid()
+			{
+				if (!resolved)
+					resolve();
+				return location >= 0;
+			}
+
+			// Number of elements of the array, 1 for a single value
+			GLint getSize()
+			{
+				if (!resolved)
+					resolve();
+				return size;
+			}
+		};
+	}
+}